@@ -55,22 +55,103 @@
 #define USB_INTERFACE_DESCRIPTOR_TYPE           0x04
 #define USB_ENDPOINT_DESCRIPTOR_TYPE            0x05
    
-#define HID_EPIN_ADDR                 0x81
-#define HID_EPIN_SIZE                 16
-   
-#define HID_EPOUT_ADDR                 0x01
-#define HID_EPOUT_SIZE                 16   
+/* Composite configuration: three HID interfaces, each with its own
+   endpoints so button and config traffic never wait behind the tracker */
+#define HID_ITF_TRACKER               0
+#define HID_ITF_BUTTONS               1
+#define HID_ITF_CONFIG                2
+#define HID_ITF_NUM                   3
+
+#define HID_TRACKER_EPIN_ADDR         0x81
+#define HID_TRACKER_EPIN_SIZE         0x40
+
+#define HID_BUTTONS_EPIN_ADDR         0x82
+#define HID_BUTTONS_EPIN_SIZE         0x20
+
+#define HID_CONFIG_EPIN_ADDR          0x83
+#define HID_CONFIG_EPIN_SIZE          0x40
+#define HID_CONFIG_EPOUT_ADDR         0x03
+#define HID_CONFIG_EPOUT_SIZE         0x40
+
+/* Lab builds: 1 to replace the buttons interface with a vendor specific
+   interface streaming raw sensor records on a bulk IN endpoint, see
+   User/raw_log.h. The F401 has no IN endpoint left for a fourth
+   interface, so the buttons report is not available in such a build */
+#ifndef USBD_RAW_LOG
+#define USBD_RAW_LOG                  0
+#endif
+#define HID_ITF_LOG                   HID_ITF_BUTTONS
+#define HID_LOG_EPIN_ADDR             HID_BUTTONS_EPIN_ADDR
+#define HID_LOG_EPIN_SIZE             0x40
 
-#define USB_HID_CONFIG_DESC_SIZ       98
+/* Size of the tracker input report: packed rotation vector samples, see
+   User/tracker_report.h */
+#define HID_TRACKER_REPORT_SIZE       HID_TRACKER_EPIN_SIZE
+/* Size of the button input report: [1] counter, [2] stick, [3] key code */
+#define HID_REPORT_SIZE               20
+/* Config channel report IDs. Report 1 carries commands and responses on
+   the interrupt endpoints; the others are feature reports on the control
+   pipe, laid out in User/tracker_config.h */
+#define HID_CONFIG_REPORT_ID          0x01
+#define HID_FEATURE_SENSORS_ID        0x02
+#define HID_FEATURE_SENSORS_SIZE      5
+#define HID_FEATURE_ARVR_ID           0x03
+#define HID_FEATURE_ARVR_SIZE         16
+#define HID_FEATURE_PREDICTION_ID     0x04
+#define HID_FEATURE_PREDICTION_SIZE   2
+#define HID_FEATURE_STATS_ID          0x05
+#define HID_FEATURE_STATS_SIZE        60
+#define HID_FEATURE_TIMING_ID         0x06
+#define HID_FEATURE_TIMING_SIZE       20
+#define HID_FEATURE_CPU_ID            0x07
+#define HID_FEATURE_CPU_SIZE          112
+#define HID_FEATURE_MEMORY_ID         0x08
+#define HID_FEATURE_MEMORY_SIZE       136
+#define HID_FEATURE_POOLS_ID          0x09
+#define HID_FEATURE_POOLS_SIZE        48
+#define HID_FEATURE_MAX_SIZE          136
+
+/* Size of the config channel input and output reports, without the
+   report ID byte */
+#define HID_CONFIG_REPORT_SIZE        (HID_CONFIG_EPIN_SIZE - 1)
+
+/* Event reports (button edges) waiting for the IN endpoint, in order */
+#define HID_EVENT_QUEUE_LEN           8
+
+#if USBD_RAW_LOG
+#define USB_HID_CONFIG_DESC_SIZ       82
+#else
+#define USB_HID_CONFIG_DESC_SIZ       91
+#endif
 #define USB_HID_DESC_SIZ              9
-#define HID_MOUSE_REPORT_DESC_SIZE    27
+#define HID_TRACKER_REPORT_DESC_SIZE  21
+#define HID_BUTTONS_REPORT_DESC_SIZE  21
+#define HID_CONFIG_REPORT_DESC_SIZE   93
 
 #define HID_DESCRIPTOR_TYPE           0x21
 #define HID_REPORT_DESC               0x22
 
 #define HID_HS_BINTERVAL               0x07
-#define HID_FS_BINTERVAL               0x0A
-#define HID_POLLING_INTERVAL           0x0A
+/* Full-speed tracker and button endpoint polling interval in ms (1..255).
+   The default polls every frame; override at build time, or at run time
+   with USBD_HID_SetPollingInterval before the host enumerates the device */
+#ifndef HID_FS_BINTERVAL
+#define HID_FS_BINTERVAL               0x01
+#endif
+#define HID_POLLING_INTERVAL           HID_FS_BINTERVAL
+/* 1 to load the tracker report into the IN FIFO at the SOF of the frame
+   the host polls in, so it carries the newest samples when the IN token
+   arrives; 0 to send it as soon as the endpoint is free. Also settable at
+   run time with USBD_HID_SetSofSync */
+#ifndef HID_SOF_SYNC
+#define HID_SOF_SYNC                   1
+#endif
+/* The config channel is not latency critical */
+#define HID_CONFIG_BINTERVAL           0x0A
+
+/* Offsets of the tracker and button bInterval bytes in USBD_HID_CfgDesc */
+#define HID_CFG_TRACKER_BINTERVAL      33
+#define HID_CFG_BUTTONS_BINTERVAL      58
 
 #define HID_REQ_SET_PROTOCOL          0x0B
 #define HID_REQ_GET_PROTOCOL          0x03
@@ -80,6 +161,11 @@
 
 #define HID_REQ_SET_REPORT            0x09
 #define HID_REQ_GET_REPORT            0x01
+
+/* GET_REPORT/SET_REPORT wValue high byte */
+#define HID_REPORT_TYPE_INPUT         0x01
+#define HID_REPORT_TYPE_OUTPUT        0x02
+#define HID_REPORT_TYPE_FEATURE       0x03
 /**
   * @}
   */ 
@@ -96,14 +182,96 @@ typedef enum
 HID_StateTypeDef; 
 
 
+typedef struct
+{
+  uint8_t              data[HID_TRACKER_EPIN_SIZE];
+  uint16_t             len;
+  uint32_t             timestamp;  /* producer's time of the newest data */
+}
+USBD_HID_ReportTypeDef;
+
 typedef struct
 {
   uint32_t             Protocol;   
   uint32_t             IdleState;  
   uint32_t             AltSetting;
-  HID_StateTypeDef     state;  
+  
+  /* Tracker IN. Ping-pong state report buffers: one may be on the wire
+     while the producer fills the other; a submitted buffer that has not
+     gone out yet is handed back to the producer, so only the newest is
+     sent */
+  HID_StateTypeDef     trackerState;
+  USBD_HID_ReportTypeDef state[2];
+  uint8_t              stateWrite;     /* buffer handed to the producer */
+  int8_t               statePending;   /* submitted, not sent; -1 if none */
+  int8_t               stateInFlight;  /* on the wire; -1 if none */
+  uint32_t             pollFrame;      /* frame number of the last tracker poll */
+  
+  /* Buttons IN. Event reports, sent in order; the tail is on the wire
+     while buttonsState is busy */
+  HID_StateTypeDef     buttonsState;
+  uint8_t              events[HID_EVENT_QUEUE_LEN][HID_BUTTONS_EPIN_SIZE];
+  uint8_t              eventLen[HID_EVENT_QUEUE_LEN];
+  uint8_t              eventHead;
+  uint8_t              eventTail;
+  
+#if USBD_RAW_LOG
+  /* Log bulk IN, in place of the buttons. The application owns the data
+     on the wire until LogSent */
+  HID_StateTypeDef     logState;
+  uint16_t             logLen;
+#endif
+  
+  /* Config IN/OUT */
+  HID_StateTypeDef     configState;
+  uint8_t              configIn[HID_CONFIG_EPIN_SIZE];
+  uint8_t              configOut[HID_CONFIG_EPOUT_SIZE];
+  
+  /* Feature report data stage on EP0, report ID first */
+  uint8_t              feature[HID_FEATURE_MAX_SIZE + 1];
+  uint8_t              featureId;
+  uint16_t             featureLen;     /* SET_REPORT in progress if > 0 */
 }
 USBD_HID_HandleTypeDef; 
+
+/* Application callbacks, registered with USBD_HID_RegisterInterface */
+typedef struct
+{
+  /* Called from the USB interrupt with each config channel OUT report.
+     The buffer is re-armed on return, so copy what is needed */
+  void (*OutEvent) (uint8_t *report, uint16_t len);
+  
+  /* Called from the USB interrupt for config channel feature reports,
+     without the report ID byte. FeatureSize gives the length of a report
+     and whether SET_REPORT may write it, without building it. GetFeature
+     fills at most HID_FEATURE_MAX_SIZE bytes and sets len. All return 0
+     if the report exists and a negative value to stall the request;
+     SetFeature also for values it refuses */
+  int8_t (*FeatureSize) (uint8_t id, uint16_t *len, uint8_t *writable);
+  int8_t (*GetFeature) (uint8_t id, uint8_t *report, uint16_t *len);
+  int8_t (*SetFeature) (uint8_t id, uint8_t *report, uint16_t len);
+  
+  /* USBD_RAW_LOG builds only. Called from the USB interrupt when a
+     USBD_HID_SendLog transfer completes, with its length, or with 0 if
+     the device was reset or unconfigured first; the data was then not
+     (fully) delivered */
+  void (*LogSent) (uint16_t len);
+}
+USBD_HID_ItfTypeDef;
+
+/* Per interface counters, indexed by HID_ITF_xxx */
+typedef struct
+{
+  uint32_t             queued;     /* reports accepted for transmission */
+  uint32_t             reclaimed;  /* pending reports handed back to the
+                                      producer before sending, to append
+                                      to or overwrite */
+  uint32_t             dropped;    /* not configured, oversize or queue full */
+  uint32_t             sent;       /* IN transfers completed */
+  uint32_t             received;   /* OUT reports received */
+  uint32_t             maxDepth;   /* high-water mark of the event queue */
+}
+USBD_HID_StatsTypeDef;
 /**
   * @}
   */ 
@@ -124,6 +292,7 @@ USBD_HID_HandleTypeDef;
 
 extern USBD_ClassTypeDef  USBD_HID;
 #define USBD_HID_CLASS    &USBD_HID
+extern USBD_HID_StatsTypeDef USBD_HID_Stats[HID_ITF_NUM];
 /**
   * @}
   */ 
@@ -135,7 +304,38 @@ uint8_t USBD_HID_SendReport (USBD_HandleTypeDef *pdev,
                                  uint8_t *report,
                                  uint16_t len);
 
+uint8_t *USBD_HID_GetReportBuffer (USBD_HandleTypeDef *pdev,
+                                   uint16_t *len);
+
+uint8_t USBD_HID_SubmitReport (USBD_HandleTypeDef *pdev, 
+                               uint16_t len,
+                               uint32_t timestamp);
+
+uint8_t USBD_HID_GetInFlightTimestamp (USBD_HandleTypeDef *pdev, 
+                                       uint32_t *timestamp);
+
+uint8_t USBD_HID_SendEventReport (USBD_HandleTypeDef *pdev, 
+                                  uint8_t *report,
+                                  uint16_t len);
+
+uint8_t USBD_HID_SendConfigReport (USBD_HandleTypeDef *pdev, 
+                                   uint8_t *report,
+                                   uint16_t len);
+
+#if USBD_RAW_LOG
+uint8_t USBD_HID_SendLog (USBD_HandleTypeDef *pdev, 
+                          uint8_t *data,
+                          uint16_t len);
+#endif
+
+uint8_t USBD_HID_RegisterInterface (USBD_HandleTypeDef *pdev, 
+                                    USBD_HID_ItfTypeDef *fops);
+
 uint32_t USBD_HID_GetPollingInterval (USBD_HandleTypeDef *pdev);
+void USBD_HID_SetPollingInterval (uint8_t interval);
+uint8_t USBD_HID_GetSofSync (void);
+void USBD_HID_SetSofSync (uint8_t enable);
+uint8_t USBD_HID_GetEventQueueDepth (USBD_HandleTypeDef *pdev);
 
 /**
   * @}
@@ -109,6 +109,11 @@ static uint8_t  *USBD_HID_GetDeviceQualifierDesc (uint16_t *length);
 
 static uint8_t  USBD_HID_DataIn (USBD_HandleTypeDef *pdev, uint8_t epnum);
 static uint8_t  USBD_HID_DataOut (USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t  USBD_HID_EP0_RxReady (USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_HID_SOF (USBD_HandleTypeDef *pdev);
+
+static void     USBD_HID_KickTracker (USBD_HandleTypeDef *pdev);
+static void     USBD_HID_KickButtons (USBD_HandleTypeDef *pdev);
 /**
   * @}
   */ 
@@ -123,10 +128,10 @@ USBD_ClassTypeDef  USBD_HID =
   USBD_HID_DeInit,
   USBD_HID_Setup,
   NULL, /*EP0_TxSent*/  
-  NULL, /*EP0_RxReady*/
+  USBD_HID_EP0_RxReady, /*EP0_RxReady*/
   USBD_HID_DataIn, /*DataIn*/
   USBD_HID_DataOut, /*DataOut*/
-  NULL, /*SOF */
+  USBD_HID_SOF, /*SOF */
   NULL,
   NULL,      
   USBD_HID_GetCfgDesc,
@@ -135,76 +140,128 @@ USBD_ClassTypeDef  USBD_HID =
   USBD_HID_GetDeviceQualifierDesc,
 };
 
+USBD_HID_StatsTypeDef USBD_HID_Stats[HID_ITF_NUM];
+
+static uint8_t USBD_HID_SofSync = HID_SOF_SYNC;
+
+/* HID class descriptor of one interface */
+#define USBD_HID_CLASS_DESC(reportDescSize)                                    \
+    0x09,         /*bLength: HID Descriptor size*/                             \
+    HID_DESCRIPTOR_TYPE, /*bDescriptorType: HID 0x21*/                         \
+    0x10,         /*bcdHID: HID Class Spec release number 0x0110*/             \
+    0x01,                                                                      \
+    0x21,         /*bCountryCode: Hardware target country*/                    \
+    0x01,         /*bNumDescriptors: Number of HID class descriptors*/         \
+    0x22,         /*bDescriptorType: Report*/                                  \
+    (reportDescSize), /*wItemLength: Total length of Report descriptor*/      \
+    0x00
+
+/* Interrupt endpoint descriptor */
+#define USBD_HID_EP_DESC(addr, size, interval)                                 \
+    0x07,          /*bLength: Endpoint Descriptor size*/                       \
+    USB_ENDPOINT_DESCRIPTOR_TYPE, /*bDescriptorType:0x05*/                     \
+    (addr),        /*bEndpointAddress: bit 7 set for IN*/                      \
+    0x03,          /*bmAttributes: Interrupt endpoint*/                        \
+    (size),        /*wMaxPacketSize*/                                          \
+    0x00,                                                                      \
+    (interval)     /*bInterval: Polling Interval (ms)*/
+
 /* USB HID device Configuration Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_HID_CfgDesc[USB_HID_CONFIG_DESC_SIZ]  __ALIGN_END =
 {
- 0x09, /* bLength: Configuation Descriptor size */
+    0x09, /* bLength: Configuation Descriptor size */
     USB_CONFIGURATION_DESCRIPTOR_TYPE, /* bDescriptorType: Configuration */
     USB_HID_CONFIG_DESC_SIZ,
     /* wTotalLength: Bytes returned */
     0x00,
-    0x01,         /*bNumInterfaces: 1 interfaceǷ񸴺豸*/
+    HID_ITF_NUM,  /*bNumInterfaces: tracker, buttons, config*/
     0x01,         /*bConfigurationValue: Configuration value*/
     0x00,         /*iConfiguration: Index of string descriptor describing
                                      the configuration*/
     0x80,         /*bmAttributes: bus powered */
     0x32,         /*MaxPower 100 mA: this current is used for detecting Vbus*/
 
-    /************** Descriptor of Joystick Mouse interfaceýӿڹ ****************/
+    /************** Head tracker interface ****************/
     /* 09 */
     0x09,         /*bLength: Interface Descriptor size*/
     USB_INTERFACE_DESCRIPTOR_TYPE,/*bDescriptorType: Interface descriptor type*/
-    0x00,         /*bInterfaceNumber: Number of Interface*/
+    HID_ITF_TRACKER, /*bInterfaceNumber: Number of Interface*/
     0x00,         /*bAlternateSetting: Alternate setting*/
-    0x02,         /*bNumEndpointsӿڵĶ˵LEDƣҪһ˵*/
+    0x01,         /*bNumEndpoints*/
     0x03,         /*bInterfaceClass: HID*/
     0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
-    0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse it does not matters*/
-    0x00,            /*iInterface: Index of string descriptor*/
-    /******************** Descriptor of Joystick Mouse HID ֻHIDУлû ********************/
+    0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+    0x00,         /*iInterface: Index of string descriptor*/
     /* 18 */
-    0x09,         /*bLength: HID Descriptor size*/
-    HID_DESCRIPTOR_TYPE, /*bDescriptorType: HID 0x21*/
-    0x10,         /*bcdHID: HID Class Spec release number 0x0100*/
-    0x01,
-    0x21,         /*bCountryCode: Hardware target country*/
-    0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
-    0x22,         /*bDescriptorType*/
-    HID_MOUSE_REPORT_DESC_SIZE,   /*wItemLength: Total length of Report descriptor*/
-    0x00,
-    /******************** Descriptor of Joystick Mouse endpoint ********************/
+    USBD_HID_CLASS_DESC(HID_TRACKER_REPORT_DESC_SIZE),
     /* 27 */
-    0x07,          /*bLength: Endpoint Descriptor size*/
-    USB_ENDPOINT_DESCRIPTOR_TYPE, /*bDescriptorType:0x05*/
+    USBD_HID_EP_DESC(HID_TRACKER_EPIN_ADDR, HID_TRACKER_EPIN_SIZE, HID_FS_BINTERVAL),
 
-    0x81,          /*bEndpointAddress: Endpoint Address (IN) һLED˵㣬bEndpointAddressλʾ1Ϊ룬0Ϊ4λʾַ*/
-    0x03,          /*bmAttributes: Interrupt endpoint*/
-    0x40,          /*wMaxPacketSize: 4 Byte max ˵4ֽڣԴ㣬С*/
-    0x00,
-    0x05,          /*bInterval: Polling Interval (32 ms)*/
-    /* Ϊ˵ */
-     0x07,          /*bLength: Endpoint Descriptor size*/
+#if USBD_RAW_LOG
+    /************** Raw sensor log interface ****************/
+    /* 34 */
+    0x09,         /*bLength: Interface Descriptor size*/
+    USB_INTERFACE_DESCRIPTOR_TYPE,/*bDescriptorType: Interface descriptor type*/
+    HID_ITF_LOG,  /*bInterfaceNumber: Number of Interface*/
+    0x00,         /*bAlternateSetting: Alternate setting*/
+    0x01,         /*bNumEndpoints*/
+    0xFF,         /*bInterfaceClass: vendor specific*/
+    0x00,         /*bInterfaceSubClass*/
+    0x00,         /*nInterfaceProtocol*/
+    0x00,         /*iInterface: Index of string descriptor*/
+    /* 43 */
+    0x07,          /*bLength: Endpoint Descriptor size*/
     USB_ENDPOINT_DESCRIPTOR_TYPE, /*bDescriptorType:0x05*/
-    0x01,          /*bEndpointAddress: Endpoint Address (IN) һLED˵㣬bEndpointAddressλʾ1Ϊ룬0Ϊ4λʾַ*/
-    0x03,          /*bmAttributes: Interrupt endpoint*/
-    0x40,          /*wMaxPacketSize: 4 Byte max ˵4ֽڣԴ㣬С*/
+    HID_LOG_EPIN_ADDR, /*bEndpointAddress*/
+    0x02,          /*bmAttributes: Bulk endpoint*/
+    HID_LOG_EPIN_SIZE, /*wMaxPacketSize*/
     0x00,
-    0x05,          /*bInterval: Polling Interval (32 ms)*/
+    0x00,          /*bInterval: ignored for bulk*/
+    /* 50; the offsets below are 9 less in this build */
+#else
+    /************** Buttons interface ****************/
+    /* 34 */
+    0x09,         /*bLength: Interface Descriptor size*/
+    USB_INTERFACE_DESCRIPTOR_TYPE,/*bDescriptorType: Interface descriptor type*/
+    HID_ITF_BUTTONS, /*bInterfaceNumber: Number of Interface*/
+    0x00,         /*bAlternateSetting: Alternate setting*/
+    0x01,         /*bNumEndpoints*/
+    0x03,         /*bInterfaceClass: HID*/
+    0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
+    0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+    0x00,         /*iInterface: Index of string descriptor*/
+    /* 43 */
+    USBD_HID_CLASS_DESC(HID_BUTTONS_REPORT_DESC_SIZE),
+    /* 52 */
+    USBD_HID_EP_DESC(HID_BUTTONS_EPIN_ADDR, HID_BUTTONS_EPIN_SIZE, HID_FS_BINTERVAL),
+#endif
+
+    /************** Config channel interface ****************/
+    /* 59 */
+    0x09,         /*bLength: Interface Descriptor size*/
+    USB_INTERFACE_DESCRIPTOR_TYPE,/*bDescriptorType: Interface descriptor type*/
+    HID_ITF_CONFIG, /*bInterfaceNumber: Number of Interface*/
+    0x00,         /*bAlternateSetting: Alternate setting*/
+    0x02,         /*bNumEndpoints: IN and OUT*/
+    0x03,         /*bInterfaceClass: HID*/
+    0x00,         /*bInterfaceSubClass : 1=BOOT, 0=no boot*/
+    0x00,         /*nInterfaceProtocol : 0=none, 1=keyboard, 2=mouse*/
+    0x00,         /*iInterface: Index of string descriptor*/
+    /* 68 */
+    USBD_HID_CLASS_DESC(HID_CONFIG_REPORT_DESC_SIZE),
+    /* 77 */
+    USBD_HID_EP_DESC(HID_CONFIG_EPIN_ADDR, HID_CONFIG_EPIN_SIZE, HID_CONFIG_BINTERVAL),
+    /* 84 */
+    USBD_HID_EP_DESC(HID_CONFIG_EPOUT_ADDR, HID_CONFIG_EPOUT_SIZE, HID_CONFIG_BINTERVAL),
+    /* 91 */
 } ;
 
-/* USB HID device Configuration Descriptor */
-__ALIGN_BEGIN static uint8_t USBD_HID_Desc[USB_HID_DESC_SIZ]  __ALIGN_END  =
+/* HID class descriptors returned for GET_DESCRIPTOR(HID), per interface */
+__ALIGN_BEGIN static uint8_t USBD_HID_Desc[HID_ITF_NUM][USB_HID_DESC_SIZ]  __ALIGN_END  =
 {
-  /* 18 */
-  0x09,         /*bLength: HID Descriptor size*/
-  HID_DESCRIPTOR_TYPE, /*bDescriptorType: HID*/
-  0x10,         /*bcdHID: HID Class Spec release number*/
-  0x01,
-  0x21,         /*bCountryCode: Hardware target country*/
-  0x01,         /*bNumDescriptors: Number of HID class descriptors to follow*/
-  0x22,         /*bDescriptorType*/
-  HID_MOUSE_REPORT_DESC_SIZE,/*wItemLength: Total length of Report descriptor*/
-  0x00,
+  { USBD_HID_CLASS_DESC(HID_TRACKER_REPORT_DESC_SIZE) },
+  { USBD_HID_CLASS_DESC(HID_BUTTONS_REPORT_DESC_SIZE) },
+  { USBD_HID_CLASS_DESC(HID_CONFIG_REPORT_DESC_SIZE) },
 };
 
 /* USB Standard Device Descriptor */
@@ -222,25 +279,111 @@ __ALIGN_BEGIN static uint8_t USBD_HID_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_
   0x00,
 };
 
-__ALIGN_BEGIN static uint8_t HID_MOUSE_ReportDesc[HID_MOUSE_REPORT_DESC_SIZE]  __ALIGN_END =
+__ALIGN_BEGIN static uint8_t HID_TRACKER_ReportDesc[HID_TRACKER_REPORT_DESC_SIZE]  __ALIGN_END =
 {
 0x05, 0x01, //usage_page(generic desktop)
 0x09 ,0x00, //user-defined hid 
 0xa1 ,0x01, //collection(application)
 0x15 ,0x00, //logical_min(00) 
 0x25 ,0xff ,//logical_max(255)
-0x95 ,0x10  ,//report_count(14 bytes)
+0x95 ,HID_TRACKER_REPORT_SIZE ,//report_count(64 bytes)
 0x75 ,0x08 , //report_size(8)
 0x19 ,0x00,  //usage_min(0) 
 0x29 ,0xff , //usage_max(255)
 0x81 ,0x02  , //input(var)
+0xc0		
+}; 
+
+__ALIGN_BEGIN static uint8_t HID_BUTTONS_ReportDesc[HID_BUTTONS_REPORT_DESC_SIZE]  __ALIGN_END =
+{
+0x05, 0x01, //usage_page(generic desktop)
+0x09 ,0x00, //user-defined hid 
+0xa1 ,0x01, //collection(application)
+0x15 ,0x00, //logical_min(00) 
+0x25 ,0xff ,//logical_max(255)
+0x95 ,HID_REPORT_SIZE  ,//report_count(20 bytes)
+0x75 ,0x08 , //report_size(8)
+0x19 ,0x00,  //usage_min(0) 
+0x29 ,0xff , //usage_max(255)
+0x81 ,0x02  , //input(var)
+0xc0		
+}; 
+
+__ALIGN_BEGIN static uint8_t HID_CONFIG_ReportDesc[HID_CONFIG_REPORT_DESC_SIZE]  __ALIGN_END =
+{
+0x05, 0x01, //usage_page(generic desktop)
+0x09 ,0x00, //user-defined hid 
+0xa1 ,0x01, //collection(application)
+0x15 ,0x00, //logical_min(00) 
+0x25 ,0xff ,//logical_max(255)
+0x75 ,0x08 , //report_size(8)
+0x85 ,HID_CONFIG_REPORT_ID ,//report_id(1), commands and responses
+0x95 ,HID_CONFIG_REPORT_SIZE ,//report_count(63 bytes)
+0x19 ,0x00,  //usage_min(0) 
+0x29 ,0xff , //usage_max(255)
+0x81 ,0x02  , //input(var)
 		
 0x19 ,0x00 ,  //usage_min(0) 
 0x29 ,0xff  , //usage_max(255) 
-0x91 ,0x02 ,  //Output(Data, Variable, Absolute), LED report 
+0x91 ,0x02 ,  //Output(Data, Variable, Absolute), commands
+
+0x85 ,HID_FEATURE_SENSORS_ID ,//report_id(2)
+0x95 ,HID_FEATURE_SENSORS_SIZE ,//report_count
+0x09 ,0x01 , //usage(1)
+0xb1 ,0x02 , //feature(var), sensor selection and rate
+
+0x85 ,HID_FEATURE_ARVR_ID ,//report_id(3)
+0x95 ,HID_FEATURE_ARVR_SIZE ,//report_count
+0x09 ,0x02 , //usage(2)
+0xb1 ,0x02 , //feature(var), ARVR FRS tuning
+
+0x85 ,HID_FEATURE_PREDICTION_ID ,//report_id(4)
+0x95 ,HID_FEATURE_PREDICTION_SIZE ,//report_count
+0x09 ,0x03 , //usage(3)
+0xb1 ,0x02 , //feature(var), prediction horizon
+
+0x85 ,HID_FEATURE_STATS_ID ,//report_id(5)
+0x95 ,HID_FEATURE_STATS_SIZE ,//report_count
+0x09 ,0x04 , //usage(4)
+0xb1 ,0x02 , //feature(var), counters
+
+0x85 ,HID_FEATURE_TIMING_ID ,//report_id(6)
+0x95 ,HID_FEATURE_TIMING_SIZE ,//report_count
+0x09 ,0x05 , //usage(5)
+0xb1 ,0x02 , //feature(var), SOF sync and sample age
+
+0x85 ,HID_FEATURE_CPU_ID ,//report_id(7)
+0x95 ,HID_FEATURE_CPU_SIZE ,//report_count
+0x09 ,0x06 , //usage(6)
+0xb1 ,0x02 , //feature(var), CPU load
+
+0x85 ,HID_FEATURE_MEMORY_ID ,//report_id(8)
+0x95 ,HID_FEATURE_MEMORY_SIZE ,//report_count
+0x09 ,0x07 , //usage(7)
+0xb1 ,0x02 , //feature(var), stack, heap and crash record
+
+0x85 ,HID_FEATURE_POOLS_ID ,//report_id(9)
+0x95 ,HID_FEATURE_POOLS_SIZE ,//report_count
+0x09 ,0x08 , //usage(8)
+0xb1 ,0x02 , //feature(var), block pool usage
 0xc0		
 }; 
 
+/* Report descriptors, per interface */
+static uint8_t * const USBD_HID_ReportDesc[HID_ITF_NUM] =
+{
+  HID_TRACKER_ReportDesc,
+  HID_BUTTONS_ReportDesc,
+  HID_CONFIG_ReportDesc,
+};
+
+static const uint16_t USBD_HID_ReportDescSize[HID_ITF_NUM] =
+{
+  HID_TRACKER_REPORT_DESC_SIZE,
+  HID_BUTTONS_REPORT_DESC_SIZE,
+  HID_CONFIG_REPORT_DESC_SIZE,
+};
+
 /**
   * @}
   */ 
@@ -261,16 +404,33 @@ static uint8_t  USBD_HID_Init (USBD_HandleTypeDef *pdev,
 {
   uint8_t ret = 0;
   
-  /* Open EP IN */
+  /* Open EPs */
   USBD_LL_OpenEP(pdev,
-                 HID_EPIN_ADDR,
+                 HID_TRACKER_EPIN_ADDR,
                  USBD_EP_TYPE_INTR,
-                 HID_EPIN_SIZE);  
+                 HID_TRACKER_EPIN_SIZE);  
   
-    USBD_LL_OpenEP(pdev,
-                 HID_EPOUT_ADDR,
+#if USBD_RAW_LOG
+  USBD_LL_OpenEP(pdev,
+                 HID_LOG_EPIN_ADDR,
+                 USBD_EP_TYPE_BULK,
+                 HID_LOG_EPIN_SIZE);  
+#else
+  USBD_LL_OpenEP(pdev,
+                 HID_BUTTONS_EPIN_ADDR,
                  USBD_EP_TYPE_INTR,
-                 HID_EPOUT_SIZE);  
+                 HID_BUTTONS_EPIN_SIZE);  
+#endif
+  
+  USBD_LL_OpenEP(pdev,
+                 HID_CONFIG_EPIN_ADDR,
+                 USBD_EP_TYPE_INTR,
+                 HID_CONFIG_EPIN_SIZE);  
+  
+  USBD_LL_OpenEP(pdev,
+                 HID_CONFIG_EPOUT_ADDR,
+                 USBD_EP_TYPE_INTR,
+                 HID_CONFIG_EPOUT_SIZE);  
   
   pdev->pClassData = USBD_malloc(sizeof (USBD_HID_HandleTypeDef));
   
@@ -280,7 +440,21 @@ static uint8_t  USBD_HID_Init (USBD_HandleTypeDef *pdev,
   }
   else
   {
-    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->state = HID_IDLE;
+    USBD_memset(pdev->pClassData, 0, sizeof (USBD_HID_HandleTypeDef));
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->trackerState = HID_IDLE;
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->buttonsState = HID_IDLE;
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->configState = HID_IDLE;
+#if USBD_RAW_LOG
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->logState = HID_IDLE;
+#endif
+    
+    /* Arm the config OUT endpoint; DataOut re-arms it after each report */
+    USBD_LL_PrepareReceive(pdev,
+                           HID_CONFIG_EPOUT_ADDR,
+                           ((USBD_HID_HandleTypeDef *)pdev->pClassData)->configOut,
+                           HID_CONFIG_EPOUT_SIZE);
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->statePending = -1;
+    ((USBD_HID_HandleTypeDef *)pdev->pClassData)->stateInFlight = -1;
   }
   return ret;
 }
@@ -297,12 +471,33 @@ static uint8_t  USBD_HID_DeInit (USBD_HandleTypeDef *pdev,
 {
   /* Close HID EPs */
   USBD_LL_CloseEP(pdev,
-                  HID_EPIN_ADDR);
+                  HID_TRACKER_EPIN_ADDR);
+  
+  USBD_LL_CloseEP(pdev,
+                  HID_BUTTONS_EPIN_ADDR);
+  
+  USBD_LL_CloseEP(pdev,
+                  HID_CONFIG_EPIN_ADDR);
   
   USBD_LL_CloseEP(pdev,
-                  HID_EPOUT_ADDR);
+                  HID_CONFIG_EPOUT_ADDR);
   
-  /* FRee allocated memory */
+#if USBD_RAW_LOG
+  /* A log transfer cut short by the reset is never completed; hand the
+     data back so the application can send it again */
+  if((pdev->pClassData != NULL) &&
+     (((USBD_HID_HandleTypeDef *)pdev->pClassData)->logState != HID_IDLE) &&
+     (pdev->pUserData != NULL) &&
+     (((USBD_HID_ItfTypeDef *)pdev->pUserData)->LogSent != NULL))
+  {
+    ((USBD_HID_ItfTypeDef *)pdev->pUserData)->LogSent(0);
+  }
+#endif
+  
+  /* No report is waiting for a frame any more */
+  USBD_SofInterrupt(USBD_SOF_SYNC, 0);
+  
+  /* Give the class data back to the static arena (USBD_free) */
   if(pdev->pClassData != NULL)
   {
     USBD_free(pdev->pClassData);
@@ -323,8 +518,11 @@ static uint8_t  USBD_HID_Setup (USBD_HandleTypeDef *pdev,
                                 USBD_SetupReqTypedef *req)
 {
   uint16_t len = 0;
+  uint8_t  writable = 0;
   uint8_t  *pbuf = NULL;
+  uint8_t  itf = LOBYTE(req->wIndex);
   USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*) pdev->pClassData;
+  USBD_HID_ItfTypeDef        *fops = (USBD_HID_ItfTypeDef*) pdev->pUserData;
   
   switch (req->bmRequest & USB_REQ_TYPE_MASK)
   {
@@ -353,6 +551,43 @@ static uint8_t  USBD_HID_Setup (USBD_HandleTypeDef *pdev,
                         1);        
       break;      
       
+    case HID_REQ_GET_REPORT:
+      /* Feature reports are answered from the interrupt, so the
+         application keeps them ready to copy */
+      if ((itf != HID_ITF_CONFIG) ||
+          (HIBYTE(req->wValue) != HID_REPORT_TYPE_FEATURE) ||
+          (fops == NULL) || (fops->GetFeature == NULL) ||
+          (fops->GetFeature(LOBYTE(req->wValue), &hhid->feature[1], &len) < 0) ||
+          (len > HID_FEATURE_MAX_SIZE))
+      {
+        USBD_CtlError (pdev, req);
+        return USBD_FAIL; 
+      }
+      hhid->feature[0] = LOBYTE(req->wValue);
+      USBD_CtlSendData (pdev, 
+                        hhid->feature,
+                        MIN(len + 1, req->wLength));
+      break;
+      
+    case HID_REQ_SET_REPORT:
+      /* Only writable feature reports of their exact size are accepted;
+         the data stage ends in USBD_HID_EP0_RxReady */
+      if ((itf != HID_ITF_CONFIG) ||
+          (HIBYTE(req->wValue) != HID_REPORT_TYPE_FEATURE) ||
+          (fops == NULL) || (fops->FeatureSize == NULL) || (fops->SetFeature == NULL) ||
+          (fops->FeatureSize(LOBYTE(req->wValue), &len, &writable) < 0) || !writable ||
+          (len > HID_FEATURE_MAX_SIZE) || (req->wLength != len + 1))
+      {
+        USBD_CtlError (pdev, req);
+        return USBD_FAIL; 
+      }
+      hhid->featureId = LOBYTE(req->wValue);
+      hhid->featureLen = req->wLength;
+      USBD_CtlPrepareRx (pdev, 
+                         hhid->feature,
+                         req->wLength);
+      break;
+      
     default:
       USBD_CtlError (pdev, req);
       return USBD_FAIL; 
@@ -363,14 +598,19 @@ static uint8_t  USBD_HID_Setup (USBD_HandleTypeDef *pdev,
     switch (req->bRequest)
     {
     case USB_REQ_GET_DESCRIPTOR: 
+      if((itf >= HID_ITF_NUM) || (USBD_RAW_LOG && (itf == HID_ITF_LOG)))
+      {
+        USBD_CtlError (pdev, req);
+        return USBD_FAIL;
+      }
       if( req->wValue >> 8 == HID_REPORT_DESC)
       {
-        len = MIN(HID_MOUSE_REPORT_DESC_SIZE , req->wLength);
-        pbuf = HID_MOUSE_ReportDesc;
+        len = MIN(USBD_HID_ReportDescSize[itf] , req->wLength);
+        pbuf = USBD_HID_ReportDesc[itf];
       }
       else if( req->wValue >> 8 == HID_DESCRIPTOR_TYPE)
       {
-        pbuf = USBD_HID_Desc;   
+        pbuf = USBD_HID_Desc[itf];   
         len = MIN(USB_HID_DESC_SIZ , req->wLength);
       }
       
@@ -394,9 +634,170 @@ static uint8_t  USBD_HID_Setup (USBD_HandleTypeDef *pdev,
   return USBD_OK;
 }
 
+/**
+  * @brief  USBD_HID_KickTracker 
+  *         Start sending the newest state report if the tracker
+  *         endpoint is idle.
+  *         Called from the USB interrupt or with interrupts disabled
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_HID_KickTracker (USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  USBD_HID_ReportTypeDef     *report;
+  
+  if((hhid->trackerState != HID_IDLE) || (hhid->statePending < 0))
+  {
+    return;
+  }
+  
+  hhid->stateInFlight = hhid->statePending;
+  hhid->statePending = -1;
+  report = &hhid->state[hhid->stateInFlight];
+  
+  hhid->trackerState = HID_BUSY;
+  USBD_LL_Transmit (pdev, 
+                    HID_TRACKER_EPIN_ADDR,                                      
+                    report->data,
+                    report->len);
+}
+
+/**
+  * @brief  USBD_HID_KickButtons 
+  *         Start sending the oldest queued event report if the buttons
+  *         endpoint is idle. The slot is freed in DataIn.
+  *         Called from the USB interrupt or with interrupts disabled
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_HID_KickButtons (USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  
+  if((hhid->buttonsState != HID_IDLE) || (hhid->eventTail == hhid->eventHead))
+  {
+    return;
+  }
+  
+  hhid->buttonsState = HID_BUSY;
+  USBD_LL_Transmit (pdev, 
+                    HID_BUTTONS_EPIN_ADDR,                                      
+                    hhid->events[hhid->eventTail],
+                    hhid->eventLen[hhid->eventTail]);
+}
+
+/**
+  * @brief  USBD_HID_GetReportBuffer 
+  *         Hand a free tracker report buffer to the producer. If a
+  *         submitted report has not gone out yet its buffer is handed
+  *         back with its contents, so the producer can append to it or
+  *         overwrite it. There must be a single producer
+  * @param  pdev: device instance
+  * @param  len: set to the length of the reclaimed report, 0 if the
+  *         buffer is free
+  * @retval buffer of HID_TRACKER_EPIN_SIZE bytes, NULL if not configured
+  */
+uint8_t *USBD_HID_GetReportBuffer (USBD_HandleTypeDef  *pdev,
+                                   uint16_t *len)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  uint32_t primask;
+  
+  if (pdev->dev_state != USBD_STATE_CONFIGURED)
+  {
+    USBD_HID_Stats[HID_ITF_TRACKER].dropped++;
+    return NULL;
+  }
+  
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(hhid->statePending >= 0)
+  {
+    hhid->stateWrite = hhid->statePending;
+    hhid->statePending = -1;
+    USBD_HID_Stats[HID_ITF_TRACKER].reclaimed++;
+    *len = hhid->state[hhid->stateWrite].len;
+  }
+  else
+  {
+    hhid->stateWrite = (hhid->stateInFlight == 0) ? 1 : 0;
+    *len = 0;
+  }
+  __set_PRIMASK(primask);
+  
+  return hhid->state[hhid->stateWrite].data;
+}
+
+/**
+  * @brief  USBD_HID_SubmitReport 
+  *         Queue the buffer from USBD_HID_GetReportBuffer on the tracker
+  *         endpoint. The class owns it until the next
+  *         USBD_HID_GetReportBuffer
+  * @param  pdev: device instance
+  * @param  len: report length
+  * @param  timestamp: producer's time of the newest data in the report,
+  *         returned by USBD_HID_GetInFlightTimestamp
+  * @retval status
+  */
+uint8_t USBD_HID_SubmitReport (USBD_HandleTypeDef  *pdev, 
+                               uint16_t len,
+                               uint32_t timestamp)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  uint32_t primask;
+  
+  if ((pdev->dev_state != USBD_STATE_CONFIGURED) || (len > HID_TRACKER_EPIN_SIZE))
+  {
+    USBD_HID_Stats[HID_ITF_TRACKER].dropped++;
+    return USBD_FAIL;
+  }
+  
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hhid->state[hhid->stateWrite].len = len;
+  hhid->state[hhid->stateWrite].timestamp = timestamp;
+  hhid->statePending = hhid->stateWrite;
+  USBD_HID_Stats[HID_ITF_TRACKER].queued++;
+  if (!USBD_HID_SofSync)
+  {
+    USBD_HID_KickTracker(pdev);
+  }
+  else
+  {
+    /* Until the report is loaded in USBD_HID_SOF */
+    USBD_SofInterrupt(USBD_SOF_SYNC, 1);
+  }
+  __set_PRIMASK(primask);
+  
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_GetInFlightTimestamp 
+  *         return the timestamp of the tracker report on the wire; valid
+  *         until its IN transfer completes
+  * @param  pdev: device instance
+  * @param  timestamp: set to the timestamp given to USBD_HID_SubmitReport
+  * @retval USBD_FAIL if no report is in flight
+  */
+uint8_t USBD_HID_GetInFlightTimestamp (USBD_HandleTypeDef  *pdev, 
+                                       uint32_t *timestamp)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  
+  if ((hhid == NULL) || (hhid->stateInFlight < 0))
+  {
+    return USBD_FAIL;
+  }
+  *timestamp = hhid->state[hhid->stateInFlight].timestamp;
+  return USBD_OK;
+}
+
 /**
   * @brief  USBD_HID_SendReport 
-  *         Send HID Report
+  *         Send a tracker HID Report from a caller buffer.
+  *         Copies it; use USBD_HID_GetReportBuffer to build in place
   * @param  pdev: device instance
   * @param  buff: pointer to report
   * @retval status
@@ -404,20 +805,178 @@ static uint8_t  USBD_HID_Setup (USBD_HandleTypeDef *pdev,
 uint8_t USBD_HID_SendReport     (USBD_HandleTypeDef  *pdev, 
                                  uint8_t *report,
                                  uint16_t len)
+{
+  uint8_t *buf;
+  uint16_t pending;
+  
+  if (len > HID_TRACKER_EPIN_SIZE)
+  {
+    USBD_HID_Stats[HID_ITF_TRACKER].dropped++;
+    return USBD_FAIL;
+  }
+  
+  buf = USBD_HID_GetReportBuffer(pdev, &pending);
+  if (buf == NULL)
+  {
+    return USBD_FAIL;
+  }
+  USBD_memcpy(buf, report, len);
+  return USBD_HID_SubmitReport(pdev, len, 0);
+}
+
+/**
+  * @brief  USBD_HID_SendEventReport 
+  *         Send a buttons HID Report (key edge). Event reports are
+  *         never coalesced and go out in order
+  * @param  pdev: device instance
+  * @param  buff: pointer to report
+  * @retval USBD_BUSY if the queue is full; retry later
+  */
+uint8_t USBD_HID_SendEventReport (USBD_HandleTypeDef  *pdev, 
+                                  uint8_t *report,
+                                  uint16_t len)
 {
   USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  uint32_t primask;
+  uint8_t next;
+  uint8_t ret = USBD_OK;
+  
+  if (USBD_RAW_LOG ||
+      (pdev->dev_state != USBD_STATE_CONFIGURED) || (len > HID_BUTTONS_EPIN_SIZE))
+  {
+    USBD_HID_Stats[HID_ITF_BUTTONS].dropped++;
+    return USBD_FAIL;
+  }
   
-  if (pdev->dev_state == USBD_STATE_CONFIGURED )
+  primask = __get_PRIMASK();
+  __disable_irq();
+  next = (hhid->eventHead + 1) % HID_EVENT_QUEUE_LEN;
+  if(next == hhid->eventTail)
   {
-    if(hhid->state == HID_IDLE)
+    USBD_HID_Stats[HID_ITF_BUTTONS].dropped++;
+    ret = USBD_BUSY;
+  }
+  else
+  {
+    USBD_memcpy(hhid->events[hhid->eventHead], report, len);
+    hhid->eventLen[hhid->eventHead] = len;
+    hhid->eventHead = next;
+    USBD_HID_Stats[HID_ITF_BUTTONS].queued++;
+    if (USBD_HID_GetEventQueueDepth(pdev) > USBD_HID_Stats[HID_ITF_BUTTONS].maxDepth)
     {
-      hhid->state = HID_BUSY;
-      USBD_LL_Transmit (pdev, 
-                        HID_EPIN_ADDR,                                      
-                        report,
-                        len);
+      USBD_HID_Stats[HID_ITF_BUTTONS].maxDepth = USBD_HID_GetEventQueueDepth(pdev);
     }
+    USBD_HID_KickButtons(pdev);
+  }
+  __set_PRIMASK(primask);
+  
+  return ret;
+}
+
+/**
+  * @brief  USBD_HID_SendConfigReport 
+  *         Send a config channel HID Report (command response)
+  * @param  pdev: device instance
+  * @param  buff: pointer to report
+  * @retval USBD_BUSY if the previous response is still in flight
+  */
+uint8_t USBD_HID_SendConfigReport (USBD_HandleTypeDef  *pdev, 
+                                   uint8_t *report,
+                                   uint16_t len)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  uint32_t primask;
+  uint8_t ret = USBD_OK;
+  
+  if ((pdev->dev_state != USBD_STATE_CONFIGURED) || (len > HID_CONFIG_REPORT_SIZE))
+  {
+    USBD_HID_Stats[HID_ITF_CONFIG].dropped++;
+    return USBD_FAIL;
+  }
+  
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(hhid->configState != HID_IDLE)
+  {
+    ret = USBD_BUSY;
+  }
+  else
+  {
+    hhid->configIn[0] = HID_CONFIG_REPORT_ID;
+    USBD_memcpy(&hhid->configIn[1], report, len);
+    hhid->configState = HID_BUSY;
+    USBD_HID_Stats[HID_ITF_CONFIG].queued++;
+    USBD_LL_Transmit (pdev, 
+                      HID_CONFIG_EPIN_ADDR,                                      
+                      hhid->configIn,
+                      len + 1);
+  }
+  __set_PRIMASK(primask);
+  
+  return ret;
+}
+
+#if USBD_RAW_LOG
+/**
+  * @brief  USBD_HID_SendLog 
+  *         Start a bulk IN transfer on the log interface, in as many
+  *         packets as it takes. The data is not copied: the caller keeps
+  *         it unchanged until the LogSent callback
+  * @param  pdev: device instance
+  * @param  data: pointer to the records
+  * @param  len: number of bytes
+  * @retval USBD_BUSY if the previous transfer is still in flight
+  */
+uint8_t USBD_HID_SendLog (USBD_HandleTypeDef  *pdev, 
+                          uint8_t *data,
+                          uint16_t len)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  uint32_t primask;
+  uint8_t ret = USBD_OK;
+  
+  if ((pdev->dev_state != USBD_STATE_CONFIGURED) || (hhid == NULL) || (len == 0))
+  {
+    return USBD_FAIL;
+  }
+  
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if(hhid->logState != HID_IDLE)
+  {
+    ret = USBD_BUSY;
+  }
+  else
+  {
+    hhid->logState = HID_BUSY;
+    hhid->logLen = len;
+    USBD_HID_Stats[HID_ITF_LOG].queued++;
+    USBD_LL_Transmit (pdev, 
+                      HID_LOG_EPIN_ADDR,                                      
+                      data,
+                      len);
+  }
+  __set_PRIMASK(primask);
+  
+  return ret;
+}
+#endif
+
+/**
+  * @brief  USBD_HID_RegisterInterface 
+  *         register the application callbacks
+  * @param  pdev: device instance
+  * @param  fops: callbacks
+  * @retval status
+  */
+uint8_t USBD_HID_RegisterInterface (USBD_HandleTypeDef *pdev, 
+                                    USBD_HID_ItfTypeDef *fops)
+{
+  if(fops == NULL)
+  {
+    return USBD_FAIL;
   }
+  pdev->pUserData = fops;
   return USBD_OK;
 }
 
@@ -431,8 +990,9 @@ uint32_t USBD_HID_GetPollingInterval (USBD_HandleTypeDef *pdev)
 {
   uint32_t polling_interval = 0;
 
-  /* HIGH-speed endpoints */
-  if(pdev->dev_speed == USBD_SPEED_HIGH)
+  /* HIGH-speed endpoints. Check the core rather than dev_speed, which
+     reads as high speed until the first bus reset */
+  if(pdev->id == DEVICE_HS)
   {
    /* Sets the data transfer polling interval for high speed transfers. 
     Values between 1..16 are allowed. Values correspond to interval 
@@ -443,12 +1003,78 @@ uint32_t USBD_HID_GetPollingInterval (USBD_HandleTypeDef *pdev)
   {
     /* Sets the data transfer polling interval for low and full 
     speed transfers */
-    polling_interval =  HID_FS_BINTERVAL;
+    polling_interval =  USBD_HID_CfgDesc[HID_CFG_TRACKER_BINTERVAL];
   }
   
   return ((uint32_t)(polling_interval));
 }
 
+/**
+  * @brief  USBD_HID_SetPollingInterval 
+  *         set the full-speed polling interval of the tracker and
+  *         buttons endpoints.
+  *         The host reads it at enumeration, so call this before
+  *         USBD_Start or follow it with a disconnect/reconnect
+  * @param  interval: polling interval in ms (1..255)
+  * @retval None
+  */
+void USBD_HID_SetPollingInterval (uint8_t interval)
+{
+  if(interval == 0)
+  {
+    interval = 1;
+  }
+  USBD_HID_CfgDesc[HID_CFG_TRACKER_BINTERVAL] = interval;
+#if !USBD_RAW_LOG
+  USBD_HID_CfgDesc[HID_CFG_BUTTONS_BINTERVAL] = interval;
+#endif
+}
+
+/**
+  * @brief  USBD_HID_GetEventQueueDepth 
+  *         return the number of event reports queued or on the wire
+  * @param  pdev: device instance
+  * @retval queue depth, at most HID_EVENT_QUEUE_LEN - 1
+  */
+uint8_t USBD_HID_GetEventQueueDepth (USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  
+  if (hhid == NULL)
+  {
+    return 0;
+  }
+  return (hhid->eventHead + HID_EVENT_QUEUE_LEN - hhid->eventTail) % HID_EVENT_QUEUE_LEN;
+}
+
+/**
+  * @brief  USBD_HID_GetSofSync 
+  *         return 1 if tracker reports are loaded at SOF, see HID_SOF_SYNC
+  * @param  None
+  * @retval SOF synchronisation state
+  */
+uint8_t USBD_HID_GetSofSync (void)
+{
+  return USBD_HID_SofSync;
+}
+
+/**
+  * @brief  USBD_HID_SetSofSync 
+  *         load tracker reports at the SOF of the poll frame (1) or as
+  *         soon as the endpoint is free (0). Takes effect with the next
+  *         report
+  * @param  enable: SOF synchronisation state
+  * @retval None
+  */
+void USBD_HID_SetSofSync (uint8_t enable)
+{
+  USBD_HID_SofSync = (enable != 0);
+  if (!USBD_HID_SofSync)
+  {
+    USBD_SofInterrupt(USBD_SOF_SYNC, 0);
+  }
+}
+
 /**
   * @brief  USBD_HID_GetCfgDesc 
   *         return configuration descriptor
@@ -474,33 +1100,156 @@ static uint8_t  USBD_HID_DataIn (USBD_HandleTypeDef *pdev,
                               uint8_t epnum)
 {
   
-  /* Ensure that the FIFO is empty before a new transfer, this condition could 
-  be caused by  a new transfer before the end of the previous transfer */
-  ((USBD_HID_HandleTypeDef *)pdev->pClassData)->state = HID_IDLE;
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+#if USBD_RAW_LOG
+  USBD_HID_ItfTypeDef        *fops = (USBD_HID_ItfTypeDef*)pdev->pUserData;
+#endif
+  
+  /* Each IN endpoint runs its own state machine; queue the next report
+     straight away so it goes out in the next frame */
+  switch (epnum | 0x80)
+  {
+  case HID_TRACKER_EPIN_ADDR:
+    hhid->trackerState = HID_IDLE;
+    /* The state buffer is free for the producer again */
+    hhid->stateInFlight = -1;
+    hhid->pollFrame = USBD_GetFrameNumber();
+    USBD_HID_Stats[HID_ITF_TRACKER].sent++;
+    if (!USBD_HID_SofSync)
+    {
+      USBD_HID_KickTracker(pdev);
+    }
+    break;
+    
+#if USBD_RAW_LOG
+  case HID_LOG_EPIN_ADDR:
+    /* The callback usually starts the next transfer */
+    hhid->logState = HID_IDLE;
+    USBD_HID_Stats[HID_ITF_LOG].sent++;
+    if ((fops != NULL) && (fops->LogSent != NULL))
+    {
+      fops->LogSent(hhid->logLen);
+    }
+    break;
+#else
+  case HID_BUTTONS_EPIN_ADDR:
+    hhid->buttonsState = HID_IDLE;
+    hhid->eventTail = (hhid->eventTail + 1) % HID_EVENT_QUEUE_LEN;
+    USBD_HID_Stats[HID_ITF_BUTTONS].sent++;
+    USBD_HID_KickButtons(pdev);
+    break;
+#endif
+    
+  case HID_CONFIG_EPIN_ADDR:
+    hhid->configState = HID_IDLE;
+    USBD_HID_Stats[HID_ITF_CONFIG].sent++;
+    break;
+  }
   return USBD_OK;
 }
-//*****************outputص
-#if 1
- static uint8_t USBD_HID_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
-{
-return USBD_OK;
-} 
-#endif
-#if 0
+
+/**
+  * @brief  USBD_HID_DataOut
+  *         handle data OUT Stage: hand the config channel report to the
+  *         application and re-arm the endpoint straight away
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
 static uint8_t  USBD_HID_DataOut (USBD_HandleTypeDef *pdev, 
-                              uint8_t epnum)
+                                  uint8_t epnum)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  USBD_HID_ItfTypeDef        *fops = (USBD_HID_ItfTypeDef*)pdev->pUserData;
+  uint16_t len;
+  
+  if (epnum != (HID_CONFIG_EPOUT_ADDR & 0x7F))
+  {
+    return USBD_FAIL;
+  }
+  
+  len = USBD_LL_GetRxDataSize(pdev, epnum);
+  if ((len == 0) || (hhid->configOut[0] != HID_CONFIG_REPORT_ID))
+  {
+    USBD_HID_Stats[HID_ITF_CONFIG].dropped++;
+  }
+  else
+  {
+    USBD_HID_Stats[HID_ITF_CONFIG].received++;
+    if ((fops != NULL) && (fops->OutEvent != NULL))
+    {
+      fops->OutEvent(&hhid->configOut[1], len - 1);
+    }
+  }
+  
+  USBD_LL_PrepareReceive(pdev, HID_CONFIG_EPOUT_ADDR, hhid->configOut, 
+                         HID_CONFIG_EPOUT_SIZE);
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_HID_EP0_RxReady
+  *         handle the SET_REPORT data stage: pass the feature report to
+  *         the application
+  * @param  pdev: device instance
+  * @retval USBD_FAIL to stall the status stage, when the report ID does
+  *         not match the request or the application refuses the values
+  */
+static uint8_t  USBD_HID_EP0_RxReady (USBD_HandleTypeDef *pdev)
 {
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  USBD_HID_ItfTypeDef        *fops = (USBD_HID_ItfTypeDef*)pdev->pUserData;
+  uint8_t ret = USBD_FAIL;
   
-  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;  
+  if (hhid->featureLen == 0)
+  {
+    return USBD_OK;
+  }
   
-  //((USBD_HID_HandleTypeDef *)pdev->pUserData)->OutEvent(hhid->Report_buf[0],hhid->Report_buf[1]);
-    
-  USBD_LL_PrepareReceive(pdev,HID_EPOUT_ADDR, hhid->Report_buf, 
-                         USBD_CUSTOMHID_OUTREPORT_BUF_SIZE);
+  if ((hhid->feature[0] == hhid->featureId) &&
+      (fops != NULL) && (fops->SetFeature != NULL) &&
+      (fops->SetFeature(hhid->featureId, &hhid->feature[1], hhid->featureLen - 1) >= 0))
+  {
+    ret = USBD_OK;
+  }
+  hhid->featureLen = 0;
+  return ret;
+}
 
+/**
+  * @brief  USBD_HID_SOF
+  *         handle SOF event: in SOF sync mode, load the pending tracker
+  *         report in the frame the host polls next. The IN token follows
+  *         SOF in that frame, so the report holds every sample the
+  *         producer managed to add before it
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_HID_SOF (USBD_HandleTypeDef *pdev)
+{
+  USBD_HID_HandleTypeDef     *hhid = (USBD_HID_HandleTypeDef*)pdev->pClassData;
+  
+  if (hhid == NULL)
+  {
+    return USBD_OK;
+  }
+  
+  /* Polls are bInterval frames apart, counted from the last one we
+     answered. The frame number comes from the core, so frames whose
+     SOF interrupt was masked still count */
+  if (USBD_HID_SofSync &&
+      (((USBD_GetFrameNumber() - hhid->pollFrame) & 0x7FF) >= USBD_HID_GetPollingInterval(pdev)))
+  {
+    USBD_HID_KickTracker(pdev);
+  }
+  /* Nothing left to load: let the CPU sleep through the next frames */
+  if (!USBD_HID_SofSync || (hhid->statePending < 0))
+  {
+    USBD_SofInterrupt(USBD_SOF_SYNC, 0);
+  }
   return USBD_OK;
 }
-#endif
+
 /**
 * @brief  DeviceQualifierDescriptor 
 *         return Device Qualifier descriptor
@@ -317,11 +317,16 @@ USBD_StatusTypeDef USBD_LL_DataOutStage(USBD_HandleTypeDef *pdev , uint8_t epnum
       else
       {
         if((pdev->pClass->EP0_RxReady != NULL)&&
-           (pdev->dev_state == USBD_STATE_CONFIGURED))
+           (pdev->dev_state == USBD_STATE_CONFIGURED)&&
+           (pdev->pClass->EP0_RxReady(pdev) != USBD_OK))
         {
-          pdev->pClass->EP0_RxReady(pdev); 
+          /* The class refused the data: stall the status stage */
+          USBD_CtlError(pdev, NULL);
+        }
+        else
+        {
+          USBD_CtlSendStatus(pdev);
         }
-        USBD_CtlSendStatus(pdev);
       }
     }
   }
@@ -135,6 +135,10 @@ static xBlockLink xStart, *pxEnd = NULL;
 fragmentation. */
 static size_t xFreeBytesRemaining = ( ( size_t ) heapADJUSTED_HEAP_SIZE ) & ( ( size_t ) ~portBYTE_ALIGNMENT_MASK );
 
+/* The lowest value xFreeBytesRemaining has reached since the heap was
+initialised. */
+static size_t xMinimumEverFreeBytesRemaining = ( ( size_t ) heapADJUSTED_HEAP_SIZE ) & ( ( size_t ) ~portBYTE_ALIGNMENT_MASK );
+
 /* Gets set to the top bit of an size_t type.  When this bit in the xBlockSize 
 member of an xBlockLink structure is set then the block belongs to the 
 application.  When the bit is free the block is still part of the free heap
@@ -223,6 +227,11 @@ void *pvReturn = NULL;
 
 					xFreeBytesRemaining -= pxBlock->xBlockSize;
 
+					if( xFreeBytesRemaining < xMinimumEverFreeBytesRemaining )
+					{
+						xMinimumEverFreeBytesRemaining = xFreeBytesRemaining;
+					}
+
 					/* The block is being returned - it is allocated and owned
 					by the application and has no "next" block. */
 					pxBlock->xBlockSize |= xBlockAllocatedBit;
@@ -295,6 +304,44 @@ size_t xPortGetFreeHeapSize( void )
 }
 /*-----------------------------------------------------------*/
 
+size_t xPortGetMinimumEverFreeHeapSize( void )
+{
+	return xMinimumEverFreeBytesRemaining;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetFreeBlockStats( size_t *pxLargestFreeBlock, size_t *pxNumberOfFreeBlocks )
+{
+xBlockLink *pxBlock;
+size_t xLargest = 0, xBlocks = 0;
+
+	vTaskSuspendAll();
+	{
+		/* Before the first allocation there is no list to walk yet. */
+		if( pxEnd != NULL )
+		{
+			for( pxBlock = xStart.pxNextFreeBlock; pxBlock != pxEnd; pxBlock = pxBlock->pxNextFreeBlock )
+			{
+				if( pxBlock->xBlockSize > xLargest )
+				{
+					xLargest = pxBlock->xBlockSize;
+				}
+				xBlocks++;
+			}
+		}
+		else
+		{
+			xLargest = xFreeBytesRemaining;
+			xBlocks = 1;
+		}
+	}
+	xTaskResumeAll();
+
+	*pxLargestFreeBlock = xLargest;
+	*pxNumberOfFreeBlocks = xBlocks;
+}
+/*-----------------------------------------------------------*/
+
 void vPortInitialiseBlocks( void )
 {
 	/* This just exists to keep the linker quiet. */
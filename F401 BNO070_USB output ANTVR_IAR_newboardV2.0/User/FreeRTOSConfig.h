@@ -85,10 +85,13 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
     #include <stdint.h>
     extern uint32_t SystemCoreClock;
+    void vApplicationPreSleep(void);
+    void vApplicationPostSleep(void);
+    void dwt_Init(void);
 #endif
 
 #define configUSE_PREEMPTION              1
-#define configUSE_IDLE_HOOK               0
+#define configUSE_IDLE_HOOK               1
 #define configUSE_TICK_HOOK               0
 #define configCPU_CLOCK_HZ                (SystemCoreClock)
 #define configTICK_RATE_HZ                ((portTickType)1000)
@@ -101,12 +104,26 @@
 #define configIDLE_SHOULD_YIELD           1
 #define configUSE_MUTEXES                 1
 #define configQUEUE_REGISTRY_SIZE         8
-#define configCHECK_FOR_STACK_OVERFLOW    0
+#define configCHECK_FOR_STACK_OVERFLOW    2
 #define configUSE_RECURSIVE_MUTEXES       1
-#define configUSE_MALLOC_FAILED_HOOK      0
+#define configUSE_MALLOC_FAILED_HOOK      1
 #define configUSE_APPLICATION_TASK_TAG    0
 #define configUSE_COUNTING_SEMAPHORES     1
-#define configGENERATE_RUN_TIME_STATS     0
+#define configGENERATE_RUN_TIME_STATS     1
+
+/* Tickless idle: when every task is blocked for two ticks or more, the
+idle task stops the periodic SysTick and sleeps in WFI until the next
+timeout or any interrupt (INTn, USB, keys), which is serviced at once.
+See vApplicationPreSleep() in freertos.c. */
+#define configUSE_TICKLESS_IDLE           1
+#define configPRE_SLEEP_PROCESSING( x )   vApplicationPreSleep()
+#define configPOST_SLEEP_PROCESSING( x )  vApplicationPostSleep()
+
+/* Run time stats count core clock cycles on DWT CYCCNT (see dwt.h). The
+counter wraps every 51 s, so only differences over shorter windows are
+meaningful; cpu_load.c samples them once a second. */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()  dwt_Init()
+#define portGET_RUN_TIME_COUNTER_VALUE()          ( *( volatile uint32_t * ) 0xE0001004UL )
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES           0
@@ -128,6 +145,8 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil        0
 #define INCLUDE_vTaskDelay             1
 #define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetIdleTaskHandle 1
+#define INCLUDE_pcTaskGetTaskName      1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -0,0 +1,54 @@
+/*
+ * Fixed-size block pools. See block_pool.h.
+ */
+
+#include "stm32f4xx_hal.h"
+#include "block_pool.h"
+
+void *block_pool_alloc(block_pool_t *pool)
+{
+    uint32_t primask;
+    void *block;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    block = pool->free;
+    if (block != NULL)
+        pool->free = *(void **)block;
+    else if (pool->fresh < pool->usage.blocks)
+        block = pool->storage + pool->blockSize * pool->fresh++;
+
+    if (block == NULL) {
+        pool->usage.exhausted++;
+    }
+    else {
+        pool->usage.allocs++;
+        if (++pool->usage.inUse > pool->usage.maxInUse)
+            pool->usage.maxInUse = pool->usage.inUse;
+    }
+    __set_PRIMASK(primask);
+
+    return block;
+}
+
+void block_pool_free(block_pool_t *pool, void *block)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *(void **)block = pool->free;
+    pool->free = block;
+    pool->usage.inUse--;
+    __set_PRIMASK(primask);
+}
+
+void block_pool_getUsage(const block_pool_t *pool, block_pool_usage_t *usage)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *usage = pool->usage;
+    __set_PRIMASK(primask);
+}
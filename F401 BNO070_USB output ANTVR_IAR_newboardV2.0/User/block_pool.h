@@ -0,0 +1,55 @@
+/*
+ * Fixed-size block pools in static storage, sized at build time.
+ *
+ * Allocation and release are O(1) in any context, interrupts included:
+ * a free block is popped from or pushed onto a list threaded through
+ * the blocks themselves, under a few instructions with interrupts
+ * masked. Blocks that have never been handed out are taken in order,
+ * so a pool needs no initialisation.
+ *
+ * Unlike osPoolAlloc in cmsis_os.c, there is no scan over the blocks
+ * and no heap_4 allocation when the pool is created.
+ */
+
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Usage and exhaustion figures; also the form other fixed-size queues
+   report theirs in */
+typedef struct {
+    uint16_t blocks;        /* capacity */
+    uint16_t inUse;
+    uint16_t maxInUse;      /* high-water mark */
+    uint32_t allocs;        /* blocks handed out */
+    uint32_t exhausted;     /* allocations refused, every block in use */
+} block_pool_usage_t;
+
+typedef struct {
+    void *free;             /* released blocks, linked through their first word */
+    uint8_t *storage;
+    uint16_t blockSize;     /* bytes, a multiple of 4 */
+    uint16_t fresh;         /* blocks from storage never handed out yet */
+    block_pool_usage_t usage;
+} block_pool_t;
+
+/* Defines pool name, holding count blocks large enough for type */
+#define BLOCK_POOL_DEF(name, type, count) \
+    static uint32_t name##Storage[(count) * ((sizeof(type) + 3) / 4)]; \
+    block_pool_t name = { \
+        NULL, (uint8_t *)name##Storage, ((sizeof(type) + 3) / 4) * 4, 0, \
+        { (count), 0, 0, 0, 0 } \
+    }
+
+/* Any context. Returns a block, or NULL if all of them are in use. */
+void *block_pool_alloc(block_pool_t *pool);
+
+/* Any context. block must have come from this pool. */
+void block_pool_free(block_pool_t *pool, void *block);
+
+/* Any context */
+void block_pool_getUsage(const block_pool_t *pool, block_pool_usage_t *usage);
+
+#endif /* BLOCK_POOL_H */
@@ -0,0 +1,163 @@
+/*
+ * CPU load from the idle task. See cpu_load.h.
+ */
+
+#include <string.h>
+#include "cpu_load.h"
+#include "dwt.h"
+#include "cmsis_os.h"
+
+/* Written by the idle task only */
+static uint32_t idleLastCycles;
+static volatile uint32_t idleCycles;
+
+/* Window of cpu_load_idlePermille */
+static uint32_t windowStart;
+static uint32_t windowIdle;
+
+/* Interrupt handler cycles, free running */
+static uint32_t isrCycles[CPU_LOAD_ISR_NUM];
+
+/* Run time counters at the start of the current sample window, by task
+   number; only the housekeeping thread uses these */
+static xTaskStatusType taskStatus[CPU_LOAD_MAX_TASKS];
+static struct {
+    unsigned portBASE_TYPE number;
+    uint32_t runTime;
+} taskLast[CPU_LOAD_MAX_TASKS];
+static int taskLastCount;
+static int sampled;
+static uint32_t sampleTotal;
+static uint32_t sampleIsr[CPU_LOAD_ISR_NUM];
+
+/* Last complete window, under a critical section */
+static cpu_load_stats_t cpuLoadStats;
+
+void cpu_load_idleHook(void)
+{
+    uint32_t now = dwt_GetCycles();
+    uint32_t gap = now - idleLastCycles;
+
+    if (gap < CPU_LOAD_IDLE_GAP)
+        idleCycles += gap;
+    idleLastCycles = now;
+}
+
+void cpu_load_sleep(uint32_t cycles)
+{
+    idleCycles += cycles;
+    /* The gap up to the next idle hook call is judged on its own */
+    idleLastCycles = dwt_GetCycles();
+}
+
+uint32_t cpu_load_idlePermille(void)
+{
+    uint32_t now = dwt_GetCycles();
+    uint32_t idle = idleCycles;
+    uint32_t total = now - windowStart;
+    uint32_t idleDelta = idle - windowIdle;
+
+    windowStart = now;
+    windowIdle = idle;
+    if (total == 0)
+        return 0;
+    /* idleDelta * 1000 overflows 32 bits within 60 ms */
+    return (uint32_t)(((uint64_t)idleDelta * 1000) / total);
+}
+
+void cpu_load_isr(int isr, uint32_t start)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    isrCycles[isr] += dwt_GetCycles() - start;
+    __set_PRIMASK(primask);
+}
+
+static uint16_t cpu_load_permille(uint32_t part, uint32_t total)
+{
+    if (total == 0)
+        return 0;
+    return (uint16_t)(((uint64_t)part * 1000) / total);
+}
+
+/* The task's counter at the start of the window, or 0 if it is new */
+static uint32_t cpu_load_lastRunTime(unsigned portBASE_TYPE number)
+{
+    int i;
+
+    for (i = 0; i < taskLastCount; i++) {
+        if (taskLast[i].number == number)
+            return taskLast[i].runTime;
+    }
+    return 0;
+}
+
+void cpu_load_sample(void)
+{
+    cpu_load_stats_t stats;
+    xTaskHandle idleTask = xTaskGetIdleTaskHandle();
+    uint32_t isr[CPU_LOAD_ISR_NUM];
+    uint32_t primask;
+    uint32_t total;
+    uint32_t window;
+    unsigned portBASE_TYPE n;
+    int i;
+
+    /* Zero if the array is too small for the task set */
+    n = uxTaskGetSystemState(taskStatus, CPU_LOAD_MAX_TASKS, &total);
+    if (n == 0)
+        return;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(isr, isrCycles, sizeof(isr));
+    __set_PRIMASK(primask);
+
+    memset(&stats, 0, sizeof(stats));
+    window = total - sampleTotal;
+    stats.windowUs = dwt_CyclesToUs(window);
+    for (i = 0; i < CPU_LOAD_ISR_NUM; i++) {
+        stats.isr[i] = cpu_load_permille(isr[i] - sampleIsr[i], window);
+        sampleIsr[i] = isr[i];
+    }
+
+    stats.tasks = (uint8_t)n;
+    for (i = 0; i < n; i++) {
+        uint32_t runTime = taskStatus[i].ulRunTimeCounter;
+        uint16_t share = cpu_load_permille(
+            runTime - cpu_load_lastRunTime(taskStatus[i].xTaskNumber), window);
+
+        strncpy(stats.task[i].name, (const char *)taskStatus[i].pcTaskName,
+                CPU_LOAD_NAME_LEN);
+        stats.task[i].permille = share;
+        stats.task[i].priority = (uint8_t)taskStatus[i].uxCurrentPriority;
+        if (taskStatus[i].xHandle == idleTask)
+            stats.idle = share;
+    }
+
+    for (i = 0; i < n; i++) {
+        taskLast[i].number = taskStatus[i].xTaskNumber;
+        taskLast[i].runTime = taskStatus[i].ulRunTimeCounter;
+    }
+    taskLastCount = n;
+
+    /* The first call only opens a window */
+    if (sampled) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        cpuLoadStats = stats;
+        __set_PRIMASK(primask);
+    }
+    sampleTotal = total;
+    sampled = 1;
+}
+
+void cpu_load_getStats(cpu_load_stats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = cpuLoadStats;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,81 @@
+/*
+ * CPU load from the idle task. The idle hook runs back to back while
+ * nothing else wants the CPU; each gap between two calls that is short
+ * enough to be one pass of the idle loop is counted as idle time, in DWT
+ * cycles. Anything longer means a task or a long interrupt ran.
+ *
+ * Interrupts shorter than CPU_LOAD_IDLE_GAP cycles that hit the idle
+ * task count as idle, so the figure slightly flatters a system with
+ * heavy interrupt traffic.
+ *
+ * Tickless idle sleeps are reported separately and count as idle in
+ * full, however long they are.
+ *
+ * cpu_load_sample() adds the kernel's view: each task's share of the
+ * last window from the run time stats (DWT cycles, see FreeRTOSConfig.h),
+ * and the time spent in the main interrupt handlers, which the kernel
+ * charges to whichever task they interrupted. A nested handler is also
+ * counted in the one it preempted.
+ */
+
+#ifndef CPU_LOAD_H
+#define CPU_LOAD_H
+
+#include <stdint.h>
+
+/* Longest gap between idle hook calls still counted as idle, in cycles */
+#ifndef CPU_LOAD_IDLE_GAP
+#define CPU_LOAD_IDLE_GAP   1000
+#endif
+
+/* Idle task context, from vApplicationIdleHook */
+void cpu_load_idleHook(void);
+
+/* Idle task context, interrupts masked, after a tickless idle sleep of
+   the given number of cycles */
+void cpu_load_sleep(uint32_t cycles);
+
+/* Idle time in 0.1 % units since the previous call; the window must be
+   shorter than a DWT wrap (51 s at 84 MHz). One caller only. */
+uint32_t cpu_load_idlePermille(void);
+
+/* Interrupt handlers timed by cpu_load_isr() */
+enum {
+    CPU_LOAD_ISR_USB,       /* OTG_FS */
+    CPU_LOAD_ISR_I2C,       /* I2C1 event and error */
+    CPU_LOAD_ISR_INTN,      /* EXTI1, hub INTn */
+    CPU_LOAD_ISR_KEYS,      /* EXTI4, 9_5, 15_10 */
+    CPU_LOAD_ISR_NUM
+};
+
+/* Tasks reported; with more, cpu_load_sample() keeps the last window */
+#define CPU_LOAD_MAX_TASKS  8
+#define CPU_LOAD_NAME_LEN   8
+
+typedef struct {
+    char name[CPU_LOAD_NAME_LEN];       /* NUL padded, not terminated */
+    uint16_t permille;
+    uint8_t priority;
+} cpu_load_task_t;
+
+/* The last complete window; shares are in 0.1 % units */
+typedef struct {
+    uint32_t windowUs;
+    uint16_t idle;                      /* idle task, sleep included */
+    uint16_t isr[CPU_LOAD_ISR_NUM];
+    uint8_t tasks;
+    cpu_load_task_t task[CPU_LOAD_MAX_TASKS];
+} cpu_load_stats_t;
+
+/* Interrupt context, at the end of a handler that read dwt_GetCycles()
+   into start on entry */
+void cpu_load_isr(int isr, uint32_t start);
+
+/* Closes the window and starts the next; windows must be shorter than
+   a DWT wrap. Housekeeping thread only. */
+void cpu_load_sample(void);
+
+/* Any context. Copies the last window. */
+void cpu_load_getStats(cpu_load_stats_t *stats);
+
+#endif /* CPU_LOAD_H */
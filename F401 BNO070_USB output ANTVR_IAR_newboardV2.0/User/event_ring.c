@@ -0,0 +1,102 @@
+/*
+ * Single-producer / single-consumer ring of decoded sensor hub events.
+ * See event_ring.h.
+ */
+
+#include <string.h>
+#include "event_ring.h"
+
+/* Orders the slot copy against the index update. Only a compiler
+   barrier is strictly needed on a single Cortex-M4, but a DMB is cheap
+   and keeps the ring correct if the consumer ever moves to an ISR. */
+#ifndef EVENT_RING_BARRIER
+#include "stm32f4xx.h"
+#define EVENT_RING_BARRIER() __DMB()
+#endif
+
+static int event_ring_isOrientation(uint8_t sensor)
+{
+    return sensor == SENSORHUB_ROTATION_VECTOR
+        || sensor == SENSORHUB_GAME_ROTATION_VECTOR
+        || sensor == SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR;
+}
+
+void event_ring_init(event_ring_t *ring, int latestWins)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->latestWins = latestWins;
+}
+
+int event_ring_push(event_ring_t *ring, const sensorhub_Event_t *event)
+{
+    uint32_t head = ring->head;
+    uint32_t depth;
+
+    if (ring->latestWins && event_ring_isOrientation(event->sensor)) {
+        uint32_t seq = ring->latestSeq;
+
+        if (seq != ring->latestTaken)
+            ring->stats.superseded++;
+
+        ring->latestSeq = seq + 1;
+        EVENT_RING_BARRIER();
+        ring->latest = *event;
+        EVENT_RING_BARRIER();
+        ring->latestSeq = seq + 2;
+
+        ring->stats.pushed++;
+        return 0;
+    }
+
+    depth = head - ring->tail;
+    if (depth >= EVENT_RING_SIZE) {
+        ring->stats.overflows++;
+        return -1;
+    }
+
+    ring->slots[head & (EVENT_RING_SIZE - 1)] = *event;
+    EVENT_RING_BARRIER();
+    ring->head = head + 1;
+
+    depth++;
+    if (depth > ring->stats.maxDepth)
+        ring->stats.maxDepth = depth;
+    ring->stats.pushed++;
+    return 0;
+}
+
+int event_ring_pop(event_ring_t *ring, sensorhub_Event_t *event)
+{
+    uint32_t tail = ring->tail;
+    uint32_t seq;
+
+    if (tail != ring->head) {
+        EVENT_RING_BARRIER();
+        *event = ring->slots[tail & (EVENT_RING_SIZE - 1)];
+        EVENT_RING_BARRIER();
+        ring->tail = tail + 1;
+        return 1;
+    }
+
+    /* Retry if the producer rewrote the latest slot under us */
+    do {
+        seq = ring->latestSeq;
+        if ((seq & 1) || seq == ring->latestTaken)
+            return 0;
+        EVENT_RING_BARRIER();
+        *event = ring->latest;
+        EVENT_RING_BARRIER();
+    } while (ring->latestSeq != seq);
+
+    ring->latestTaken = seq;
+    return 1;
+}
+
+void event_ring_getUsage(const event_ring_t *ring, block_pool_usage_t *usage)
+{
+    usage->blocks = EVENT_RING_SIZE;
+    usage->inUse = (uint16_t)(ring->head - ring->tail);
+    usage->maxInUse = (uint16_t)ring->stats.maxDepth;
+    usage->allocs = ring->stats.pushed;
+    usage->exhausted = ring->stats.overflows;
+}
@@ -0,0 +1,61 @@
+/*
+ * Single-producer / single-consumer ring of decoded sensor hub events.
+ *
+ * The sensor task pushes events as it drains the hub; the output task
+ * pops them and turns them into UART/USB traffic. Neither side ever
+ * blocks or takes a lock, so a slow USB or UART transfer cannot hold up
+ * the I2C reads.
+ *
+ * With latestWins set, orientation events (rotation vector, game and
+ * geomagnetic rotation vector) bypass the ring and land in a single
+ * slot that is overwritten by each new sample: the output side only
+ * ever cares about the newest orientation.
+ */
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stdint.h>
+#include "sensorhub.h"
+#include "block_pool.h"
+
+/* Must be a power of two */
+#ifndef EVENT_RING_SIZE
+#define EVENT_RING_SIZE 16
+#endif
+
+typedef struct {
+    uint32_t pushed;        /* events accepted into the ring or the latest slot */
+    uint32_t overflows;     /* events dropped because the ring was full */
+    uint32_t superseded;    /* orientation samples overwritten before being read */
+    uint32_t maxDepth;      /* high-water mark of the ring */
+} event_ring_stats_t;
+
+typedef struct {
+    sensorhub_Event_t slots[EVENT_RING_SIZE];
+    volatile uint32_t head;         /* written by the producer only */
+    volatile uint32_t tail;         /* written by the consumer only */
+
+    /* Latest-wins slot, guarded by a sequence count that is odd while
+       the producer is writing it */
+    sensorhub_Event_t latest;
+    volatile uint32_t latestSeq;    /* written by the producer only */
+    volatile uint32_t latestTaken;  /* written by the consumer only */
+
+    int latestWins;
+    event_ring_stats_t stats;       /* written by the producer only */
+} event_ring_t;
+
+void event_ring_init(event_ring_t *ring, int latestWins);
+
+/* Producer side. Returns 0, or -1 if the event was dropped. */
+int event_ring_push(event_ring_t *ring, const sensorhub_Event_t *event);
+
+/* Consumer side. Returns 1 and fills *event, or 0 if nothing is pending. */
+int event_ring_pop(event_ring_t *ring, sensorhub_Event_t *event);
+
+/* Any context. The ring's stats in block pool terms: slots, depth and
+   its high-water mark, events pushed and overflows. */
+void event_ring_getUsage(const event_ring_t *ring, block_pool_usage_t *usage);
+
+#endif /* EVENT_RING_H */
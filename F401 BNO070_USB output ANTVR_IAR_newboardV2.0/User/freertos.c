@@ -36,7 +36,41 @@
 #include "FreeRTOS.h"
 #include "task.h"
 /* USER CODE BEGIN 0 */
+#include "cpu_load.h"
+#include "dwt.h"
+#include "mem_stats.h"
 
+void vApplicationIdleHook(void)
+{
+  cpu_load_idleHook();
+}
+
+/* Called by vPortSuppressTicksAndSleep() around WFI, interrupts masked.
+   Keeps the DWT clock running across the sleep and counts it as idle. */
+void vApplicationPreSleep(void)
+{
+  dwt_SleepEnter();
+}
+
+void vApplicationPostSleep(void)
+{
+  cpu_load_sleep(dwt_SleepExit());
+}
+
+/* Both record the crash for after the reset; see mem_stats.h */
+void vApplicationStackOverflowHook(xTaskHandle xTask, signed char *pcTaskName)
+{
+  mem_stats_crash(MEM_STATS_CRASH_STACK_OVERFLOW, (const char *)pcTaskName);
+}
+
+void vApplicationMallocFailedHook(void)
+{
+  const char *name = NULL;
+
+  if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    name = (const char *)pcTaskGetTaskName(NULL);
+  mem_stats_crash(MEM_STATS_CRASH_MALLOC_FAILED, name);
+}
 /* USER CODE END 0 */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -2,23 +2,58 @@
 #include "cmsis_os.h"
 #include "key.h"
 
+/* Given by the key EXTI handlers, taken by KEY_Wait */
+static osSemaphoreId keySemaphore;
+
 //ʼ
 void KEY_Init(void) //IOʼ
 { 
   GPIO_InitTypeDef GPIO_InitStruct;
-  /*Configure GPIO pin LED: PA1,PA2,PA3,PA4 */
+  osSemaphoreDef(KEY_EDGE);
+
+  keySemaphore = osSemaphoreCreate(osSemaphore(KEY_EDGE), 1);
+  /* Created available; the first wait should block */
+  osSemaphoreWait(keySemaphore, 0);
+
+  /* Keys pull low when pressed. PB15 stays a plain input: EXTI line 15
+     is routed to PA15 below */
   GPIO_InitStruct.Pin = GPIO_PIN_15;
   GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   GPIO_InitStruct.Speed = GPIO_SPEED_LOW;
-  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+  HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
-  GPIO_InitStruct.Pin = GPIO_PIN_4|GPIO_PIN_6|GPIO_PIN_7|GPIO_PIN_12|GPIO_PIN_13|GPIO_PIN_14|GPIO_PIN_15;
+  GPIO_InitStruct.Pin = KEY_EXTI_PINS_B;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
-  
-  
-  
-  
+
+  GPIO_InitStruct.Pin = KEY_EXTI_PINS_A;
+  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  /* Below USB and INTn; they give semaphores, so at or below
+     configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY */
+  HAL_NVIC_SetPriority(EXTI4_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+void KEY_Wait(uint32_t timeoutMs)
+{
+  osSemaphoreWait(keySemaphore, timeoutMs);
+}
+
+void KEY_EXTI_IRQHandler(void)
+{
+  uint32_t pending = __HAL_GPIO_EXTI_GET_IT(KEY_EXTI_PINS_A | KEY_EXTI_PINS_B);
+
+  if (pending)
+  {
+    __HAL_GPIO_EXTI_CLEAR_IT(pending);
+    osSemaphoreRelease(keySemaphore);
+  }
 }
 //
 //ذֵ
@@ -24,6 +24,16 @@
 #define KEY6_PRESSED	        7
 #define KEY7_PRESSED	        8
 
+/* Keys that wake the input task on a falling edge. KEY7 (PB15) shares
+   EXTI line 15 with KEY0 (PA15) and is only seen by the periodic scan */
+#define KEY_EXTI_PINS_A		GPIO_PIN_15
+#define KEY_EXTI_PINS_B		(GPIO_PIN_4|GPIO_PIN_6|GPIO_PIN_7|GPIO_PIN_12|GPIO_PIN_13|GPIO_PIN_14)
+
 void KEY_Init(void);//IOʼ
 int8_t KEY_Scan(int8_t mode);  	//ɨ躯					    
+/* Blocks until a key edge or timeoutMs; call before the next scan when
+   no key is held */
+void KEY_Wait(uint32_t timeoutMs);
+/* From EXTI4, EXTI9_5 and EXTI15_10_IRQHandler */
+void KEY_EXTI_IRQHandler(void);
 #endif
\ No newline at end of file
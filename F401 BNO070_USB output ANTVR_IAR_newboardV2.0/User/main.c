@@ -40,21 +40,71 @@
 /* USER CODE BEGIN 0 */
 #include "bno070.h"
 #include "usb_device.h"
+#include "usbd_hid.h"
 #include <math.h>
+#include <string.h>
 #include "oula.h"
 #include "key.h"
 #include "adc.h"
 #include "stmflash.h"    
+#include "event_ring.h"
+#include "tracker_report.h"
+#include "usbd_hid_if.h"
+#include "tracker_config.h"
+#include "raw_log.h"
+#include "cpu_load.h"
+#include "mem_stats.h"
 /* USER CODE END 0 */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void StartThread(void const * argument);
 static void StartThread_joystick(void const * argument);
+static void StartThread_output(void const * argument);
+static void StartThread_housekeeping(void const * argument);
 static void MX_GPIO_Init(void);
 extern UART_HandleTypeDef huart2;
 extern USBD_HandleTypeDef hUsbDeviceFS;
 int8_t test_pbuffer[64];
+
+/* Sensor thread -> output thread. Orientation is latest-wins: only the
+   newest rotation vector is worth sending. Its usage is in the pools
+   feature report (tracker_config.c). */
+event_ring_t sensorEvents;
+static osSemaphoreId outputSemaphore;
+
+/* Task set, highest priority first. Stacks are in words; the printf
+   and float users get the most.
+ *
+ *   sensor        Waits for INTn and drains the hub over I2C. Above
+ *                 everything else: if it falls behind, the hub's own
+ *                 queue overflows and samples are gone for good.
+ *   output        Woken by the sensor task per batch; packs tracker
+ *                 reports and UART frames. Above input so head tracking
+ *                 latency never depends on key activity.
+ *   input         Woken by the key EXTI lines; scans every KEY_SCAN_MS
+ *                 only while a key is held.
+ *   housekeeping  Host commands (flash writes, hub resets) and the
+ *                 periodic traces. Nothing here is latency critical, and
+ *                 a blocking UART print must not delay the others.
+ */
+#define TASK_SENSOR_PRIORITY        osPriorityHigh
+#define TASK_SENSOR_STACK           512
+#define TASK_OUTPUT_PRIORITY        osPriorityAboveNormal
+#define TASK_OUTPUT_STACK           512
+#define TASK_INPUT_PRIORITY         osPriorityNormal
+#define TASK_INPUT_STACK            256
+#define TASK_HOUSEKEEPING_PRIORITY  osPriorityLow
+#define TASK_HOUSEKEEPING_STACK     384
+
+/* Key scan period while a key is held, and the longest idle wait: KEY7
+   has no EXTI line of its own (see key.h) */
+#define KEY_SCAN_MS                 5
+#define KEY_IDLE_POLL_MS            20
+
+/* Period of the housekeeping traces */
+#define HOUSEKEEPING_PERIOD_MS      1000
+
 union keynumT
 {                   /*һ*/
        int8_t key_num_buffer[34];
@@ -117,6 +167,16 @@ int main(void)
   /* Initialize all configured peripherals */
   MX_GPIO_Init();    
   MX_USART2_UART_Init();
+  if (mem_stats_init()) {
+    mem_stats_crash_t crash;
+
+    mem_stats_getCrash(&crash);
+    printf("Reset after crash %u: %s in %.8s at %u ms, heap free %u\n",
+           crash.count,
+           crash.cause == MEM_STATS_CRASH_STACK_OVERFLOW ? "stack overflow" : "malloc failed",
+           crash.name, crash.uptimeMs, crash.heapFree);
+  }
+  USBD_HID_ItfInit();
   MX_USB_DEVICE_Init();
   KEY_Init();
   //Adc_Init();
@@ -127,11 +187,25 @@ int main(void)
   /* Code generated for FreeRTOS */
   /* Create Start thread */
 
-  osThreadDef(USER_Thread, StartThread, osPriorityNormal, 0, configMINIMAL_STACK_SIZE);
+  osSemaphoreDef(OUTPUT_Sem);
+  outputSemaphore = osSemaphoreCreate(osSemaphore(OUTPUT_Sem), 1);
+  /* No latest-wins slot: every orientation sample goes into the packed
+     tracker reports */
+  event_ring_init(&sensorEvents, 0);
+
+  /* Every task blocks on an event; none polls. See the TASK_xxx defines
+     for the priority order */
+  osThreadDef(USER_Thread, StartThread, TASK_SENSOR_PRIORITY, 0, TASK_SENSOR_STACK);
   osThreadCreate (osThread(USER_Thread), NULL);
   
-  osThreadDef(JOYSTICK_Thread, StartThread_joystick, osPriorityNormal, 0, configMINIMAL_STACK_SIZE);
+  osThreadDef(OUTPUT_Thread, StartThread_output, TASK_OUTPUT_PRIORITY, 0, TASK_OUTPUT_STACK);
+  osThreadCreate (osThread(OUTPUT_Thread), NULL);
+
+  osThreadDef(JOYSTICK_Thread, StartThread_joystick, TASK_INPUT_PRIORITY, 0, TASK_INPUT_STACK);
   osThreadCreate (osThread(JOYSTICK_Thread), NULL);
+
+  osThreadDef(HOUSEKEEPING_Thread, StartThread_housekeeping, TASK_HOUSEKEEPING_PRIORITY, 0, TASK_HOUSEKEEPING_STACK);
+  osThreadCreate (osThread(HOUSEKEEPING_Thread), NULL);
   /* Start scheduler */
   osKernelStart(NULL, NULL);
   /* We should never get here as control is now taken by the scheduler */
@@ -263,38 +337,46 @@ static void readProductId()
 
 /* USER CODE END 4 */
 
-static int32_t round32(float f) {
-	return (int32_t)(f + ((f >= 0) ? 0.5 : -0.5));
-}
+/* Enables the rotation vector and the sensors the tracker reports carry,
+   and turns the others off */
+static void enableTrackerSensors(const tracker_config_t *config)
+{
+    sensorhub_SensorFeature_t settings;
+    settings.changeSensitivityEnabled = false;
+    settings.wakeupEnabled = false;
+    settings.changeSensitivityRelative = false;
+    settings.changeSensitivity = 0;              //all reports to be sent
+    settings.reportInterval = config->intervalUs;
+    settings.batchInterval = 0;
 
-#define toFixed32(x, Q) round32(x * (float)(1ull << Q))
+    tracker_report_init(config->fields);
+    tracker_report_setPrediction(config->predictionUs);
 
-static void StartThread(void const * argument) {
-  while(1){}
-#if 0
-  /* USER CODE BEGIN 5 */
-  
-  // ARVR FRS Record.  
-  // Parameters can be tuned to suit application.
-  const uint32_t arvrFrsData[] = {
-    toFixed32(0.2, 30),    // Scaling, dimensionless, 32Q30 format (0.2)
-    toFixed32(0.131, 29),  // Max Rotation, radians, 32Q29 format (7.5 degrees)
-    toFixed32(0.262, 29),  // Max Error, radians, 32Q29 format (15 degrees)
-    toFixed32(0.00175, 29) // Stability magnitude, radians, 32Q29 format (0.1 deg)
-  };
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_ROTATION_VECTOR,&settings);
+    /* Prediction needs the gyro even when it is not sent */
+    settings.reportInterval = ((config->fields & TRACKER_FIELD_GYRO) || config->predictionUs)
+                              ? config->intervalUs : 0;
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_GYROSCOPE_CALIBRATED,&settings);
+    settings.reportInterval = (config->fields & TRACKER_FIELD_ACCEL) ? config->intervalUs : 0;
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_ACCELEROMETER,&settings);
+
+#if USBD_RAW_LOG
+    settings.reportInterval = RAW_LOG_INTERVAL_US;
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_RAW_ACCELEROMETER,&settings);
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_RAW_GYROSCOPE,&settings);
+    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_RAW_MAGNETOMETER,&settings);
+#endif
+}
 
+// ARVR FRS Records, tuned through the ARVR feature report.
+// Note: FRS records are stored in non-volatile memory
+static void writeArvrFrs(const tracker_config_t *config)
+{
   int status;
-  printf("Probing for a BNO070...\n");
-  sensorhub_probe(&sensorhub);
-  
-  printf("Requesting product ID...\n");
-  readProductId();
-  
-  printf("Start FRS write...\n");      
-  // Note: FRS records are stored in non-volatile memory
+
   // set ARVR CONFIG FRS Record
   status = sensorhub_writeFRS(&sensorhub, SENSORHUB_FRS_ARVR_CONFIG,
-                              arvrFrsData, sizeof(arvrFrsData)/sizeof(uint32_t));
+                              config->arvr, sizeof(config->arvr)/sizeof(uint32_t));
   if (status == 0) {
     printf("ARVR_CONFIG FRS written successfully.\n");
   }
@@ -304,26 +386,39 @@ static void StartThread(void const * argument) {
   
   // set ARVR GAME CONFIG FRS Record
   status = sensorhub_writeFRS(&sensorhub, SENSORHUB_FRS_ARVR_GAME_CONFIG,
-                              arvrFrsData, sizeof(arvrFrsData)/sizeof(uint32_t));
+                              config->arvr, sizeof(config->arvr)/sizeof(uint32_t));
   if (status == 0) {
     printf("ARVR_GAME_CONFIG FRS written successfully.\n");
   }
   else {
     printf("ARVR_GAME_CONFIG FRS write error: %d\n\n", status);
   }
+}
+
+static void StartThread(void const * argument) {
+  /* USER CODE BEGIN 5 */
+  tracker_config_t config;
+  uint32_t changed;
+  int status;
+
+  tracker_config_take(&config);
+  printf("Probing for a BNO070...\n");
+  sensorhub_probe(&sensorhub);
+  
+  printf("Requesting product ID...\n");
+  readProductId();
+  
+  printf("Start FRS write...\n");      
+  writeArvrFrs(&config);
   
   //printf("%08x\n",0.131);
   
   printf("Enabling rotation vector events...\n\n");
     sensorhub_SensorFeature_t settings;
-    settings.changeSensitivityEnabled = false;
-    settings.wakeupEnabled = false;
-    settings.changeSensitivityRelative = false;
-    settings.changeSensitivity = 0;              //all reports to be sent
-    settings.reportInterval = 1000;             //50ms
-    settings.batchInterval = 0;
 
-    sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_ROTATION_VECTOR,&settings);
+    /* Tracker reports pack several samples, so the rate does not have
+       to follow the host polling interval */
+    enableTrackerSensors(&config);
    // sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_ACCELEROMETER,&settings);
     //sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_GYROSCOPE_CALIBRATED,&settings);
     //sensorhub_setDynamicFeature(&sensorhub, SENSORHUB_MAGNETIC_FIELD_CALIBRATED,&settings);
@@ -332,9 +427,8 @@ static void StartThread(void const * argument) {
     sensorhub_getDynamicFeature(&sensorhub, SENSORHUB_ACCELEROMETER,&settings);
     // sensorhub_getDynamicFeature(&sensorhub, SENSORHUB_RAW_ACCELEROMETER,&settings);
 
-    int reports = 0;
+    int bootTraced = 0;
     printf("\nWaiting for events...\n");
-    int8_t LED_STAT=0; 
     /* Infinite loop */
     for (;;) {
         sensorhub_Event_t events[5];
@@ -342,34 +436,248 @@ static void StartThread(void const * argument) {
         int i;
 
        while (numEvents == 0) {
-            sensorhub_poll(&sensorhub, events, 1, &numEvents);   //5,ݷŵevent
+            /* Host configuration is applied here, between hub transactions */
+            changed = tracker_config_take(&config);
+            if (changed & TRACKER_CONFIG_RECALIBRATE) {
+                /* Erasing the DCD record makes the hub start calibration
+                   from scratch after the reset */
+                status = sensorhub_writeFRS(&sensorhub, SENSORHUB_FRS_DCD, NULL, 0);
+                printf("Recalibrate: DCD erase %d\n", status);
+            }
+            if (changed & TRACKER_CONFIG_ARVR) {
+                writeArvrFrs(&config);
+            }
+            if (changed & (TRACKER_CONFIG_RECALIBRATE | TRACKER_CONFIG_ARVR)) {
+                /* The hub reads its calibration and FRS tuning at boot */
+                sensorhub_probe(&sensorhub);
+                enableTrackerSensors(&config);
+            }
+            else if (changed & TRACKER_CONFIG_SENSORS) {
+                enableTrackerSensors(&config);
+            }
+
+            /* Sleep until the hub asserts INTn, then drain what it has.
+               The timeout only bounds how long a command waits. */
+            if (sensorhub.waitForHOST_INTN(&sensorhub, 100) != SENSORHUB_STATUS_SUCCESS)
+                continue;
+            sensorhub_poll(&sensorhub, events, 5, &numEvents);   //5,ݷŵevent
         }
 
+        if (!bootTraced) {
+          bootTraced = 1;
+          printf("Boot trace (ms): reset released %u, hub ready %u, descriptor ok %u, first event %u\n",
+                 sensorhub.stats->bootResetReleased, sensorhub.stats->bootHubReady,
+                 sensorhub.stats->bootDescriptorOk, sensorhub.stats->bootFirstEvent);
+        }
+
+        /* Hand off to the output thread; never block on USB/UART here */
         for (i = 0; i < numEvents; i++) {
-          if ((reports % 100) == 0) {
-            
-         //   printf("\nEvent %d (I2C transfers %d, retries %d, errors %d)\n", reports, sensorhub.stats->i2cTransfers,sensorhub.stats->i2cRetries, sensorhub.stats->i2cErrors);
-         // }
-         // if ((reports % 10) == 0) {   //ÿ20printһ
-            HAL_GPIO_WritePin( GPIOA, GPIO_PIN_2, LED_STAT);
-            LED_STAT=~LED_STAT;
-         }
-             printEvent(&events[i]);
-            reports++;
+            event_ring_push(&sensorEvents, &events[i]);
         }
+        osSemaphoreRelease(outputSemaphore);
     }
 
   /* USER CODE END 5 */ 
-#endif
 }
  
+/* Drains sensorEvents into printEvent (UART and USB HID) */
+static void StartThread_output(void const * argument)
+{
+  int reports = 0;
+  int8_t LED_STAT=0;
+  sensorhub_Event_t event;
+
+  for (;;) {
+    osSemaphoreWait(outputSemaphore, osWaitForever);
+
+    while (event_ring_pop(&sensorEvents, &event)) {
+      if ((reports % 100) == 0) {
+        //   printf("\nEvent %d (I2C transfers %d, retries %d, errors %d)\n", reports, sensorhub.stats->i2cTransfers,sensorhub.stats->i2cRetries, sensorhub.stats->i2cErrors);
+        HAL_GPIO_WritePin( GPIOA, GPIO_PIN_2, LED_STAT);
+        LED_STAT=~LED_STAT;
+      }
+#if USBD_RAW_LOG
+      /* Everything is logged; the raw sensors would swamp the UART */
+      if (!raw_log_addEvent(&event))
+        printEvent(&event);
+#else
+      printEvent(&event);
+#endif
+      reports++;
+    }
+  }
+}
+
+/* Button edges must reach the host: wait for room in the event queue */
+static void sendButtonReport(int8_t *report)
+{
+  while (USBD_HID_SendEventReport(&hUsbDeviceFS, (uint8_t *)report, HID_REPORT_SIZE) == USBD_BUSY) {
+    osDelay(1);
+  }
+}
+
+/* Config channel commands from the host, posted by the USB interrupt.
+ *
+ *   0x11 0x22                  read back the key table
+ *   0x22 0x11 n b0 b1 b2 b3    remap key n (1..4) and store it in flash
+ *   0x33 0x44 i0 i1 i2 i3      sensor report interval, us, little endian
+ *   0x44 0x33                  erase the calibration and restart the hub
+ *
+ * The rest of the runtime configuration is in feature reports, see
+ * tracker_config.h.
+ */
+static void handleCommand(const hid_command_t *command)
+{
+  uint8_t reply[HID_CONFIG_REPORT_SIZE];
+  const uint8_t *cmd = command->data;
+
+  if (command->len >= 2 && cmd[0] == 0x11 && cmd[1] == 0x22) {
+    memset(reply, 0, sizeof(reply));
+    STMFLASH_Read(0X0800C004, (int8_t *)reply, 18);
+    while (USBD_HID_SendConfigReport(&hUsbDeviceFS, reply, sizeof(reply)) == USBD_BUSY) {
+      osDelay(1);
+    }
+  }
+  else if (command->len >= 7 && cmd[0] == 0x22 && cmd[1] == 0x11
+           && cmd[2] >= 1 && cmd[2] <= 4) {
+    STMFLASH_Read(0X0800C004, keynum.key_num_buffer, 18);
+    /* Q1_1..Q4_4 follow ID0/ID1, four bytes per key */
+    memcpy(&keynum.key_num_buffer[2 + (cmd[2] - 1) * 4], &cmd[3], 4);
+    STMFLASH_Write(0X0800C004, keynum.key_num_buffer, 18);
+  }
+  else if (command->len >= 6 && cmd[0] == 0x33 && cmd[1] == 0x44) {
+    uint32_t interval = cmd[2] | (cmd[3] << 8) | ((uint32_t)cmd[4] << 16)
+                      | ((uint32_t)cmd[5] << 24);
+    tracker_config_setInterval(interval);
+  }
+  else if (command->len >= 2 && cmd[0] == 0x44 && cmd[1] == 0x33) {
+    tracker_config_recalibrate();
+  }
+}
+
+/* Runs every HOUSEKEEPING_PERIOD_MS. The prints block on the UART,
+   which is why they live in the lowest priority task */
+static void housekeeping(void)
+{
+  uint32_t idle = cpu_load_idlePermille();
+  uint32_t warnings;
+
+  cpu_load_sample();
+  warnings = mem_stats_sample();
+  if (warnings) {
+    mem_stats_t mem;
+    int i;
+
+    mem_stats_get(&mem);
+    if (warnings & MEM_STATS_WARN_HEAP)
+      printf("Warning: heap low, %u of %u bytes free at worst\n",
+             mem.heapMinFree, mem.heapSize);
+    for (i = 0; i < mem.tasks; i++) {
+      if ((warnings & MEM_STATS_WARN_STACK) &&
+          mem.task[i].stackFree < MEM_STATS_STACK_WARN_WORDS)
+        printf("Warning: %.8s stack low, %u words free at worst\n",
+               mem.task[i].name, mem.task[i].stackFree);
+    }
+  }
+#ifdef MEM_STATS_TRACE
+  {
+    mem_stats_t mem;
+    int i;
+
+    mem_stats_get(&mem);
+    printf("Heap: %u free, %u at worst, largest block %u of %u blocks\n",
+           mem.heapFree, mem.heapMinFree, mem.heapLargest, mem.heapBlocks);
+    for (i = 0; i < mem.tasks; i++)
+      printf("  %-8.8s stack %u words free at worst\n",
+             mem.task[i].name, mem.task[i].stackFree);
+  }
+  {
+    block_pool_usage_t commands, events;
+
+    block_pool_getUsage(&hidCommandPool, &commands);
+    event_ring_getUsage(&sensorEvents, &events);
+    printf("Pools: commands %u/%u max %u refused %u, events %u/%u max %u refused %u\n",
+           commands.inUse, commands.blocks, commands.maxInUse, commands.exhausted,
+           events.inUse, events.blocks, events.maxInUse, events.exhausted);
+  }
+#endif
+#ifdef CPU_LOAD_TRACE
+  {
+    cpu_load_stats_t stats;
+    int i;
+
+    cpu_load_getStats(&stats);
+    printf("CPU: idle %u.%u%% (idle task %u.%u%%), ISR 0.1%%: usb %u i2c %u intn %u keys %u\n",
+           idle / 10, idle % 10, stats.idle / 10, stats.idle % 10,
+           stats.isr[CPU_LOAD_ISR_USB], stats.isr[CPU_LOAD_ISR_I2C],
+           stats.isr[CPU_LOAD_ISR_INTN], stats.isr[CPU_LOAD_ISR_KEYS]);
+    for (i = 0; i < stats.tasks; i++)
+      printf("  %-8.8s prio %u  %u.%u%%\n", stats.task[i].name,
+             stats.task[i].priority, stats.task[i].permille / 10,
+             stats.task[i].permille % 10);
+  }
+#else
+  (void)idle;
+#endif
+
+#ifdef USB_RATE_TRACE
+  if (USBD_HidInRate.reports > 1) {
+    USBD_InRateTypeDef rate = USBD_HidInRate;
+    USBD_ResetInRate();
+    printf("USB IN: %u reports, interval mean %u us min %u max %u, late %u\n",
+           rate.reports, rate.totalIntervalUs / (rate.reports - 1),
+           rate.minIntervalUs, rate.maxIntervalUs, rate.late);
+    printf("USB IN timing (%s): phase after SOF %u us, sample age mean %u us max %u\n",
+           USBD_HID_GetSofSync() ? "SOF sync" : "free running",
+           rate.phased ? rate.totalPhaseUs / rate.phased : 0,
+           rate.aged ? rate.totalAgeUs / rate.aged : 0, rate.maxAgeUs);
+    printf("Tracker IN: queued %u, reclaimed %u, dropped %u, sent %u\n",
+           USBD_HID_Stats[HID_ITF_TRACKER].queued,
+           USBD_HID_Stats[HID_ITF_TRACKER].reclaimed,
+           USBD_HID_Stats[HID_ITF_TRACKER].dropped,
+           USBD_HID_Stats[HID_ITF_TRACKER].sent);
+    printf("Buttons IN: queued %u, dropped %u, sent %u\n",
+           USBD_HID_Stats[HID_ITF_BUTTONS].queued,
+           USBD_HID_Stats[HID_ITF_BUTTONS].dropped,
+           USBD_HID_Stats[HID_ITF_BUTTONS].sent);
+#if USBD_RAW_LOG
+    printf("Raw log: %u records, %u bytes, dropped %u, max fill %u, transfers %u\n",
+           raw_log_stats.records, raw_log_stats.bytes, raw_log_stats.dropped,
+           raw_log_stats.maxFill, raw_log_stats.transfers);
+#endif
+  }
+#endif
+}
+
+/* Host commands as they arrive, and housekeeping() in between */
+static void StartThread_housekeeping(void const * argument)
+{
+  uint32_t next = osKernelSysTick() + HOUSEKEEPING_PERIOD_MS;
+
+  for (;;) {
+    int32_t wait = (int32_t)(next - osKernelSysTick());
+
+    if (wait > 0) {
+      osEvent evt = osMessageGet(hidCommandQueue, wait);
+
+      if (evt.status == osEventMessage) {
+        handleCommand(evt.value.p);
+        block_pool_free(&hidCommandPool, evt.value.p);
+        continue;
+      }
+    }
+
+    next += HOUSEKEEPING_PERIOD_MS;
+    housekeeping();
+  }
+}
+
 static void StartThread_joystick(void const * argument)
 {
-int8_t test_buf[16]={0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+int8_t test_buf[HID_REPORT_SIZE]={0x00};
 int8_t keysta,key,adcsta;
 int16_t adc_print;
 int8_t M1=1,M2=2,M3=3,M4=4;
-int8_t get_bufs[64];
 int8_t i;
 
 
@@ -391,87 +699,46 @@ int32_t intemp=(test_pbuffer[2]<<24) + (test_pbuffer[3]<<16) + (test_pbuffer[4]<
 
 while(1)  
  {
-#if 0
-   USBD_LL_PrepareReceive(&hUsbDeviceFS, 0x01,get_bufs,64);  //usb64ֽ
-/******************************************ԭʼļֵ2bit**********************************************************/      
-   if((get_bufs[0]==0x11) && (get_bufs[1]==0x22))  
-   {
-   STMFLASH_Read(0X0800C004,keynum.key_num_buffer,18); //flashжֵ  
-   USBD_HID_SendReport(&hUsbDeviceFS,keynum.key_num_buffer,16);   //ԭʼֵ  
-   }
-/******************************************յ޸ĵļֵ7bit**********************************************************/   
-   if((get_bufs[0]==0x22) && (get_bufs[1]==0x11))  
-   {  
-     STMFLASH_Read(0X0800C004,keynum.key_num_buffer,18); //flashжֵ   
-    int32_t modify_value=(get_bufs[3]<<24) + (get_bufs[4]<<16) + (get_bufs[5]<<8) + get_bufs[6];
-
-    if(get_bufs[2]==1)
-    {
-      keynum.key_num_struct.Q1_1=get_bufs[3];             //0x01000021 CTRL
-      keynum.key_num_struct.Q1_2=get_bufs[4];
-      keynum.key_num_struct.Q1_3=get_bufs[5];
-      keynum.key_num_struct.Q1_4=get_bufs[6];
-    }else if(get_bufs[2]==2)
-    {
-      keynum.key_num_struct.Q2_1=get_bufs[3];             //0x01000021 CTRL
-      keynum.key_num_struct.Q2_2=get_bufs[4];
-      keynum.key_num_struct.Q2_3=get_bufs[5];
-      keynum.key_num_struct.Q2_4=get_bufs[6];
-     }else if(get_bufs[2]==3)
-    {
-      keynum.key_num_struct.Q3_1=get_bufs[3];             //0x01000021 CTRL
-      keynum.key_num_struct.Q3_2=get_bufs[4];
-      keynum.key_num_struct.Q3_3=get_bufs[5];
-      keynum.key_num_struct.Q3_4=get_bufs[6];
-     }else if(get_bufs[2]==4)
-    {
-      keynum.key_num_struct.Q4_1=get_bufs[3];             //0x01000021 CTRL
-      keynum.key_num_struct.Q4_2=get_bufs[4];
-      keynum.key_num_struct.Q4_3=get_bufs[5];
-      keynum.key_num_struct.Q4_4=get_bufs[6];
-     }
-    STMFLASH_Write(0X0800C004,keynum.key_num_buffer,18);
-
-   STMFLASH_Read(0X0800C004,keynum.key_num_buffer,18); //flashжֵ ,ӵĻʱٲûбֵ
-   //USBD_HID_SendReport(&hUsbDeviceFS,keynum.key_num_buffer,16);   //¼ֵȷsendʱȷ     
-   }
-/****************************************************************************************************/      
-#endif     
    test_buf[1]++;
    if(test_buf[1]>200)test_buf[1]=0;
-   //USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);
+   //USBD_HID_SendReport(&hUsbDeviceFS,test_buf,HID_REPORT_SIZE);
    
    key=KEY_Scan(1);//֧
    if(key)
     {						    	 
- 			 if(key==KEY0_PRESSED)	{test_buf[3]=M1;  USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-			 if(key==KEY1_PRESSED)  {test_buf[3]=M2; USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-                         if(key==KEY2_PRESSED)	{test_buf[3]=M3;  USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-			 if(key==KEY3_PRESSED)  {test_buf[3]=M4; USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-                         if(key==KEY4_PRESSED)	{test_buf[3]=5;  USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-			 if(key==KEY5_PRESSED)  {test_buf[3]=6; USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-                         if(key==KEY6_PRESSED)	{test_buf[3]=7;  USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-			 if(key==KEY7_PRESSED)  {test_buf[3]=8; USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);keysta=1;}
-                         osDelay(5);
+ 			 if(key==KEY0_PRESSED)	{test_buf[3]=M1;  sendButtonReport(test_buf);keysta=1;}
+			 if(key==KEY1_PRESSED)  {test_buf[3]=M2; sendButtonReport(test_buf);keysta=1;}
+                         if(key==KEY2_PRESSED)	{test_buf[3]=M3;  sendButtonReport(test_buf);keysta=1;}
+			 if(key==KEY3_PRESSED)  {test_buf[3]=M4; sendButtonReport(test_buf);keysta=1;}
+                         if(key==KEY4_PRESSED)	{test_buf[3]=5;  sendButtonReport(test_buf);keysta=1;}
+			 if(key==KEY5_PRESSED)  {test_buf[3]=6; sendButtonReport(test_buf);keysta=1;}
+                         if(key==KEY6_PRESSED)	{test_buf[3]=7;  sendButtonReport(test_buf);keysta=1;}
+			 if(key==KEY7_PRESSED)  {test_buf[3]=8; sendButtonReport(test_buf);keysta=1;}
+                         osDelay(KEY_SCAN_MS);
 		}else if(keysta)//֮ǰа
 		{
 			keysta=0; //һʼûʱȫֱkeystaΪ0ᷢĿ
                         test_buf[3]=0;
-			USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16); //ɿ
+			sendButtonReport(test_buf); //ɿ
 		} 
+		else
+		{
+			/* Nothing held: sleep until a key goes down */
+			KEY_Wait(KEY_IDLE_POLL_MS);
+		}
  
 #if 0  
    adc_print=Get_Adc2();   
   // printf("adc value: %d\n",adc_print);
-   if(adc_print>2600){test_buf[2]=1;USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);adcsta=1; }
-   else if(adc_print<1800){test_buf[2]=2;USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);adcsta=1;}
+   if(adc_print>2600){test_buf[2]=1;USBD_HID_SendReport(&hUsbDeviceFS,test_buf,HID_REPORT_SIZE);adcsta=1; }
+   else if(adc_print<1800){test_buf[2]=2;USBD_HID_SendReport(&hUsbDeviceFS,test_buf,HID_REPORT_SIZE);adcsta=1;}
    else 
    {
      osDelay(5);
      if(adcsta)
      {
        test_buf[2]=0;
-       USBD_HID_SendReport(&hUsbDeviceFS,test_buf,16);
+       USBD_HID_SendReport(&hUsbDeviceFS,test_buf,HID_REPORT_SIZE);
        adcsta=0;
      }
    }
@@ -0,0 +1,148 @@
+/*
+ * Stack, heap and crash telemetry. See mem_stats.h.
+ */
+
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "cmsis_os.h"
+#include "mem_stats.h"
+
+#define MEM_STATS_CRASH_MAGIC       0x43524153ul    /* "CRAS" */
+
+typedef struct {
+    uint32_t magic;
+    mem_stats_crash_t crash;
+    uint32_t check;
+} mem_stats_record_t;
+
+/* Not touched by the startup code, so it keeps its contents across a
+   reset (see the .noinit section in the linker configuration) */
+__no_init static mem_stats_record_t crashRecord;
+
+/* Last sample, under a critical section */
+static mem_stats_t memStats;
+static uint8_t memWarned;
+
+static uint32_t mem_stats_check(const mem_stats_record_t *record)
+{
+    const uint8_t *p = (const uint8_t *)&record->crash;
+    uint32_t sum = record->magic;
+    int i;
+
+    for (i = 0; i < sizeof(record->crash); i++)
+        sum = (sum << 1 | sum >> 31) + p[i];
+    return ~sum;
+}
+
+static int mem_stats_valid(void)
+{
+    return crashRecord.magic == MEM_STATS_CRASH_MAGIC
+        && crashRecord.check == mem_stats_check(&crashRecord);
+}
+
+int mem_stats_init(void)
+{
+    if (!mem_stats_valid()) {
+        memset(&crashRecord, 0, sizeof(crashRecord));
+        return 0;
+    }
+    return crashRecord.crash.cause != MEM_STATS_CRASH_NONE;
+}
+
+uint32_t mem_stats_sample(void)
+{
+    xTaskStatusType status[MEM_STATS_MAX_TASKS];
+    mem_stats_t stats;
+    size_t largest, blocks;
+    uint32_t primask;
+    uint32_t warned;
+    unsigned portBASE_TYPE n;
+    int i;
+
+    /* Zero if the array is too small for the task set */
+    n = uxTaskGetSystemState(status, MEM_STATS_MAX_TASKS, NULL);
+    if (n == 0)
+        return 0;
+
+    memset(&stats, 0, sizeof(stats));
+    vPortGetFreeBlockStats(&largest, &blocks);
+    stats.heapSize = configTOTAL_HEAP_SIZE;
+    stats.heapFree = xPortGetFreeHeapSize();
+    stats.heapMinFree = xPortGetMinimumEverFreeHeapSize();
+    stats.heapLargest = largest;
+    stats.heapBlocks = (uint16_t)blocks;
+    if (stats.heapMinFree < MEM_STATS_HEAP_WARN_BYTES)
+        stats.warnings |= MEM_STATS_WARN_HEAP;
+
+    stats.tasks = (uint8_t)n;
+    for (i = 0; i < n; i++) {
+        strncpy(stats.task[i].name, (const char *)status[i].pcTaskName,
+                MEM_STATS_NAME_LEN);
+        stats.task[i].stackFree = status[i].usStackHighWaterMark;
+        if (status[i].usStackHighWaterMark < MEM_STATS_STACK_WARN_WORDS)
+            stats.warnings |= MEM_STATS_WARN_STACK;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memStats = stats;
+    __set_PRIMASK(primask);
+
+    /* Watermarks only ever fall, so each warning is raised once */
+    warned = stats.warnings & ~memWarned;
+    memWarned |= stats.warnings;
+    return warned;
+}
+
+void mem_stats_get(mem_stats_t *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = memStats;
+    __set_PRIMASK(primask);
+}
+
+void mem_stats_getCrash(mem_stats_crash_t *crash)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (mem_stats_valid())
+        *crash = crashRecord.crash;
+    else
+        memset(crash, 0, sizeof(*crash));
+    __set_PRIMASK(primask);
+}
+
+void mem_stats_clearCrash(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(&crashRecord, 0, sizeof(crashRecord));
+    __set_PRIMASK(primask);
+}
+
+void mem_stats_crash(uint8_t cause, const char *name)
+{
+    uint32_t uptime = HAL_GetTick();
+    uint8_t count = mem_stats_valid() ? crashRecord.crash.count : 0;
+
+    __disable_irq();
+    memset(&crashRecord, 0, sizeof(crashRecord));
+    crashRecord.magic = MEM_STATS_CRASH_MAGIC;
+    crashRecord.crash.cause = cause;
+    crashRecord.crash.count = (count < 255) ? count + 1 : count;
+    if (name != NULL)
+        strncpy(crashRecord.crash.name, name, MEM_STATS_NAME_LEN);
+    crashRecord.crash.uptimeMs = uptime;
+    crashRecord.crash.heapFree = xPortGetFreeHeapSize();
+    crashRecord.check = mem_stats_check(&crashRecord);
+
+    /* The stack that overflowed has trashed whatever lies below it;
+       start over rather than run on */
+    NVIC_SystemReset();
+    for (;;) {
+    }
+}
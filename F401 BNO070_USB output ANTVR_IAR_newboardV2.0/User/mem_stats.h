@@ -0,0 +1,82 @@
+/*
+ * RAM telemetry: the lowest free stack of every task and the heap_4
+ * figures (free now, lowest ever, largest free block), sampled by the
+ * housekeeping thread, and a crash record for the kernel's stack
+ * overflow and malloc failed hooks.
+ *
+ * The crash record lives in .noinit RAM, so it survives the reset the
+ * hooks end with (not a power cycle); a checksum tells it apart from
+ * what RAM holds after power up. It is read back through the memory
+ * feature report (see tracker_config.h) until the host clears it.
+ */
+
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdint.h>
+
+/* Tasks reported; with more, mem_stats_sample() keeps the last sample */
+#define MEM_STATS_MAX_TASKS         8
+#define MEM_STATS_NAME_LEN          8
+
+/* Early warning thresholds: a task whose free stack has gone below
+   this many words, or a heap whose lowest free size has gone below
+   this many bytes, sets a MEM_STATS_WARN_xxx bit */
+#ifndef MEM_STATS_STACK_WARN_WORDS
+#define MEM_STATS_STACK_WARN_WORDS  48
+#endif
+#ifndef MEM_STATS_HEAP_WARN_BYTES
+#define MEM_STATS_HEAP_WARN_BYTES   1024
+#endif
+
+#define MEM_STATS_WARN_STACK        0x01
+#define MEM_STATS_WARN_HEAP         0x02
+
+/* Crash causes */
+enum {
+    MEM_STATS_CRASH_NONE,
+    MEM_STATS_CRASH_STACK_OVERFLOW,
+    MEM_STATS_CRASH_MALLOC_FAILED
+};
+
+typedef struct {
+    char name[MEM_STATS_NAME_LEN];      /* NUL padded, not terminated */
+    uint16_t stackFree;                 /* lowest free stack, words */
+} mem_stats_task_t;
+
+typedef struct {
+    uint32_t heapSize;
+    uint32_t heapFree;
+    uint32_t heapMinFree;               /* lowest since boot */
+    uint32_t heapLargest;               /* largest free block */
+    uint16_t heapBlocks;                /* free blocks */
+    uint8_t warnings;                   /* MEM_STATS_WARN_xxx */
+    uint8_t tasks;
+    mem_stats_task_t task[MEM_STATS_MAX_TASKS];
+} mem_stats_t;
+
+typedef struct {
+    uint8_t cause;                      /* MEM_STATS_CRASH_xxx */
+    uint8_t count;                      /* crashes since power up or clear */
+    char name[MEM_STATS_NAME_LEN];      /* task running at the time */
+    uint32_t uptimeMs;
+    uint32_t heapFree;
+} mem_stats_crash_t;
+
+/* Before the scheduler starts. Drops a crash record that fails its
+   checksum (power up) and returns 1 if a valid one remains. */
+int mem_stats_init(void);
+
+/* Housekeeping thread only. Returns MEM_STATS_WARN_xxx bits that are
+   new since the previous call. */
+uint32_t mem_stats_sample(void);
+
+/* Any context. Copy the last sample and the crash record. */
+void mem_stats_get(mem_stats_t *stats);
+void mem_stats_getCrash(mem_stats_crash_t *crash);
+void mem_stats_clearCrash(void);
+
+/* From the kernel hooks: records the crash and resets; never returns */
+void mem_stats_crash(uint8_t cause, const char *name);
+
+#endif /* MEM_STATS_H */
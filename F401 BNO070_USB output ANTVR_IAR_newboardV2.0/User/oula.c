@@ -8,12 +8,11 @@
 #include <math.h>
 #include "oula.h"
 #include "usbd_hid.h"
+#include "tracker_report.h"
 
 extern UART_HandleTypeDef huart2;
 float last_val;
 float last_val2;
-int8_t send_buf[16]={0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
 
 void float_char(float f,unsigned char *s)
 {
@@ -128,6 +127,7 @@ void printEvent(const sensorhub_Event_t * event)
         break;
         
     case SENSORHUB_ACCELEROMETER:
+        if (tracker_report_addEvent(event)) break;
         x=event->un.accelerometer.x_16Q8;
         y=event->un.accelerometer.y_16Q8;
         z=event->un.accelerometer.z_16Q8;
@@ -152,6 +152,7 @@ void printEvent(const sensorhub_Event_t * event)
         break;
      
      case SENSORHUB_GYROSCOPE_CALIBRATED:
+        if (tracker_report_addEvent(event)) break;
         x=event->un.gyroscope.x_16Q9;
         y=event->un.gyroscope.y_16Q9;
         z=event->un.gyroscope.z_16Q9;
@@ -271,12 +272,8 @@ void printEvent(const sensorhub_Event_t * event)
 #endif        
         //printf("r:%f i:%f j:%f k:%f\n",r,i,j,k);
         //printf("roll:%f pitch:%f yaw:%f\n",Euler[0]*57,Euler[1]*57,Euler[2]*57);  
-        float_char(i,send_buf);
-        float_char(j,send_buf+4);
-        float_char(k,send_buf+8);
-        float_char(r,send_buf+12);
-        
-        USBD_HID_SendReport(&hUsbDeviceFS,send_buf,16);
+        /* Packed into the multi-sample tracker report */
+        tracker_report_addEvent(event);
         break;
         
     default:
@@ -0,0 +1,194 @@
+/*
+ * Raw sensor log on the USB bulk endpoint. See raw_log.h.
+ */
+
+#include "usbd_hid.h"
+
+#if USBD_RAW_LOG
+
+#include "stm32f4xx_hal.h"
+#include "raw_log.h"
+#include "usb_device.h"
+
+#if (RAW_LOG_BUFFER_SIZE & (RAW_LOG_BUFFER_SIZE - 1)) != 0
+#error "RAW_LOG_BUFFER_SIZE must be a power of two"
+#endif
+
+/* Longest single bulk transfer, so buffer space comes back steadily */
+#define RAW_LOG_MAX_TRANSFER    1024
+
+raw_log_stats_t raw_log_stats;
+
+/* Free running byte counts: the output thread advances head, the USB
+   interrupt advances sent (data handed to the endpoint) and tail (data
+   delivered). Both sides run under a critical section. */
+static uint8_t rawLogBuffer[RAW_LOG_BUFFER_SIZE];
+static uint32_t rawLogHead;
+static uint32_t rawLogSent;
+static uint32_t rawLogTail;
+static uint8_t rawLogDropped;
+
+static uint8_t *raw_log_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *raw_log_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+/* Number of field16 words in the payload of the fused reports */
+static int raw_log_words(uint8_t sensor)
+{
+    switch (sensor) {
+    case SENSORHUB_ROTATION_VECTOR:
+    case SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR:
+        return 5;
+    case SENSORHUB_GAME_ROTATION_VECTOR:
+        return 4;
+    case SENSORHUB_GYROSCOPE_UNCALIBRATED:
+    case SENSORHUB_MAGNETIC_FIELD_UNCALIBRATED:
+        return 6;
+    default:
+        return 3;
+    }
+}
+
+/* Builds the record in frame; returns its length */
+static int raw_log_frame(const sensorhub_Event_t *event, uint8_t dropped,
+                         uint8_t *frame)
+{
+    uint8_t *p = frame + RAW_LOG_HEADER_SIZE;
+    uint8_t sum = 0;
+    int n, i;
+
+    switch (event->sensor) {
+    case SENSORHUB_RAW_ACCELEROMETER:
+        p = raw_log_put16(p, event->un.rawAccelerometer.x);
+        p = raw_log_put16(p, event->un.rawAccelerometer.y);
+        p = raw_log_put16(p, event->un.rawAccelerometer.z);
+        p = raw_log_put32(p, event->un.rawAccelerometer.timestamp);
+        break;
+
+    case SENSORHUB_RAW_GYROSCOPE:
+        p = raw_log_put16(p, event->un.rawGyroscope.x);
+        p = raw_log_put16(p, event->un.rawGyroscope.y);
+        p = raw_log_put16(p, event->un.rawGyroscope.z);
+        p = raw_log_put16(p, event->un.rawGyroscope.temperature);
+        p = raw_log_put32(p, event->un.rawGyroscope.timestamp);
+        break;
+
+    case SENSORHUB_RAW_MAGNETOMETER:
+        p = raw_log_put16(p, event->un.rawMagnetometer.x);
+        p = raw_log_put16(p, event->un.rawMagnetometer.y);
+        p = raw_log_put16(p, event->un.rawMagnetometer.z);
+        p = raw_log_put32(p, event->un.rawMagnetometer.timestamp);
+        break;
+
+    default:
+        n = raw_log_words(event->sensor);
+        for (i = 0; i < n; i++)
+            p = raw_log_put16(p, event->un.field16[i]);
+        break;
+    }
+
+    frame[0] = RAW_LOG_SYNC;
+    frame[1] = (uint8_t)(p - frame - RAW_LOG_HEADER_SIZE);
+    frame[2] = event->sensor;
+    frame[3] = event->sequenceNumber;
+    frame[4] = event->status;
+    frame[5] = dropped;
+    raw_log_put32(frame + 6, event->timestamp);
+
+    n = p - frame;
+    for (i = 1; i < n; i++)
+        sum += frame[i];
+    frame[n] = (uint8_t)-sum;
+    return n + 1;
+}
+
+/* Starts the next bulk transfer if none is in flight. Interrupts
+   disabled or USB interrupt context */
+static void raw_log_kick(void)
+{
+    uint32_t offset = rawLogSent & (RAW_LOG_BUFFER_SIZE - 1);
+    uint32_t len = rawLogHead - rawLogSent;
+
+    if (rawLogSent != rawLogTail || len == 0)
+        return;
+
+    /* One contiguous piece; the rest follows from raw_log_sent */
+    if (len > RAW_LOG_BUFFER_SIZE - offset)
+        len = RAW_LOG_BUFFER_SIZE - offset;
+    if (len > RAW_LOG_MAX_TRANSFER)
+        len = RAW_LOG_MAX_TRANSFER;
+
+    if (USBD_HID_SendLog(&hUsbDeviceFS, &rawLogBuffer[offset], len) == USBD_OK)
+        rawLogSent += len;
+}
+
+int raw_log_addEvent(const sensorhub_Event_t *event)
+{
+    uint8_t frame[RAW_LOG_MAX_RECORD];
+    uint32_t primask;
+    uint32_t offset;
+    uint32_t fill;
+    int n, i;
+
+    n = raw_log_frame(event, rawLogDropped, frame);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    fill = rawLogHead - rawLogTail;
+    if (fill + n > RAW_LOG_BUFFER_SIZE) {
+        /* The host is not reading fast enough (or not at all) */
+        if (rawLogDropped < 255)
+            rawLogDropped++;
+        raw_log_stats.dropped++;
+    }
+    else {
+        offset = rawLogHead & (RAW_LOG_BUFFER_SIZE - 1);
+        for (i = 0; i < n; i++)
+            rawLogBuffer[(offset + i) & (RAW_LOG_BUFFER_SIZE - 1)] = frame[i];
+        rawLogHead += n;
+        rawLogDropped = 0;
+        raw_log_stats.records++;
+        raw_log_stats.bytes += n;
+        if (fill + n > raw_log_stats.maxFill)
+            raw_log_stats.maxFill = fill + n;
+        raw_log_kick();
+    }
+    __set_PRIMASK(primask);
+
+    return event->sensor == SENSORHUB_RAW_ACCELEROMETER
+        || event->sensor == SENSORHUB_RAW_GYROSCOPE
+        || event->sensor == SENSORHUB_RAW_MAGNETOMETER;
+}
+
+void raw_log_sent(uint16_t len)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (len == 0) {
+        /* Cut short by a reset: send it again once configured */
+        rawLogSent = rawLogTail;
+        raw_log_stats.resent++;
+    }
+    else {
+        rawLogTail += len;
+        raw_log_stats.transfers++;
+        raw_log_kick();
+    }
+    __set_PRIMASK(primask);
+}
+
+#endif /* USBD_RAW_LOG */
@@ -0,0 +1,139 @@
+/*
+ * Raw sensor log: every hub event, raw accelerometer, gyro and
+ * magnetometer included, as framed records on a USB bulk IN endpoint.
+ * Lab builds only (USBD_RAW_LOG, see usbd_hid.h); the stream takes the
+ * place of the buttons interface as vendor specific interface 1, so the
+ * host reads it with libusb bulk transfers on endpoint 0x82 rather than
+ * through hidraw.
+ *
+ * The stream is a plain byte sequence: records are packed back to back
+ * and may straddle USB transfers. All fields are little endian.
+ *
+ *   0  sync       0xA5
+ *   1  len        payload length
+ *   2  sensor     SH-1 report ID (SENSORHUB_xxx)
+ *   3  seq        hub sequence number of the report
+ *   4  status     hub status byte, accuracy in bits 1:0
+ *   5  dropped    records lost to a full buffer just before this one
+ *                 (saturates at 255)
+ *   6  timestamp  uint32, microseconds (INTn time minus hub delay)
+ *  10  payload    len bytes
+ *   +  checksum   makes the sum of bytes 1 to the checksum zero (mod 256)
+ *
+ * Payloads:
+ *
+ *   raw accelerometer, magnetometer   int16 x, y, z, uint32 sensor time
+ *   raw gyroscope                     int16 x, y, z, temperature,
+ *                                     uint32 sensor time
+ *   rotation vector, geomagnetic RV   int16 i, j, k, real, accuracy
+ *   game rotation vector              int16 i, j, k, real
+ *   uncalibrated gyro, magnetometer   int16 x, y, z, bias x, y, z
+ *   anything else                     int16 x, y, z
+ *
+ * Fixed point formats are those of the SH-1 reports. The raw sensor
+ * time is the hub's own sample time, in its units; timestamp is on the
+ * host interface clock, shared with the tracker reports.
+ *
+ * The format part of this header (up to RAW_LOG_HOST) has no firmware
+ * dependencies and can be shared with host software, which splits the
+ * stream with raw_log_parse(). A capture tool only has to append the
+ * bulk data to a file; the same function reads the file back.
+ */
+
+#ifndef RAW_LOG_H
+#define RAW_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAW_LOG_SYNC            0xA5
+#define RAW_LOG_HEADER_SIZE     10
+#define RAW_LOG_MAX_PAYLOAD     12
+#define RAW_LOG_MAX_RECORD      (RAW_LOG_HEADER_SIZE + RAW_LOG_MAX_PAYLOAD + 1)
+
+typedef struct {
+    uint8_t sensor;
+    uint8_t seq;
+    uint8_t status;
+    uint8_t dropped;
+    uint32_t timestamp;
+    uint8_t len;
+    const uint8_t *payload;     /* points into the parsed buffer */
+} raw_log_record_t;
+
+/* Splits one record off the front of buf. Returns the number of bytes
+   to discard: a whole record (filled in *record), or bytes skipped to
+   find the next sync, in which case record->payload is NULL. Returns 0
+   if buf ends in the middle of a record; call again with more data. */
+static inline int raw_log_parse(const uint8_t *buf, int size,
+                                raw_log_record_t *record)
+{
+    uint8_t sum = 0;
+    int skip, n, i;
+
+    record->payload = NULL;
+    for (skip = 0; skip < size && buf[skip] != RAW_LOG_SYNC; skip++)
+        ;
+    if (skip > 0)
+        return skip;
+    if (size < 2)
+        return 0;
+    if (buf[1] > RAW_LOG_MAX_PAYLOAD)
+        return 1;
+    n = RAW_LOG_HEADER_SIZE + buf[1] + 1;
+    if (size < n)
+        return 0;
+    for (i = 1; i < n; i++)
+        sum += buf[i];
+    if (sum != 0)
+        return 1;
+
+    record->len = buf[1];
+    record->sensor = buf[2];
+    record->seq = buf[3];
+    record->status = buf[4];
+    record->dropped = buf[5];
+    record->timestamp = buf[6] | (buf[7] << 8) | ((uint32_t)buf[8] << 16)
+                      | ((uint32_t)buf[9] << 24);
+    record->payload = buf + RAW_LOG_HEADER_SIZE;
+    return n;
+}
+
+#ifndef RAW_LOG_HOST
+
+#include "sensorhub.h"
+
+/* Buffer between the output thread and the bulk endpoint; must be a
+   power of two. Holds about 200 ms of raw and fused data at 1 kHz */
+#ifndef RAW_LOG_BUFFER_SIZE
+#define RAW_LOG_BUFFER_SIZE     8192
+#endif
+
+/* Report interval requested for the raw sensors; the hub runs each at
+   the nearest rate it supports */
+#ifndef RAW_LOG_INTERVAL_US
+#define RAW_LOG_INTERVAL_US     1000
+#endif
+
+typedef struct {
+    uint32_t records;       /* records buffered */
+    uint32_t bytes;         /* ... and their size */
+    uint32_t dropped;       /* records lost to a full buffer */
+    uint32_t maxFill;       /* high-water mark of the buffer, bytes */
+    uint32_t transfers;     /* bulk transfers completed */
+    uint32_t resent;        /* transfers cut short by a USB reset */
+} raw_log_stats_t;
+
+extern raw_log_stats_t raw_log_stats;
+
+/* Output task side. Frames the event into the buffer and starts a bulk
+   transfer if the endpoint is idle; never blocks. Returns 1 for the raw
+   sensor events, which have no other use, 0 for the rest. */
+int raw_log_addEvent(const sensorhub_Event_t *event);
+
+/* USB interrupt context: the LogSent callback of the HID class */
+void raw_log_sent(uint16_t len);
+
+#endif /* RAW_LOG_HOST */
+
+#endif /* RAW_LOG_H */
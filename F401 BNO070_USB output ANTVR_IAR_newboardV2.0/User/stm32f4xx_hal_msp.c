@@ -79,6 +79,12 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c)
     GPIO_InitStruct.Alternate = GPIO_AF4_I2C1;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+    /* I2C1 interrupts drive HAL_I2C_Master_Transfer_IT and signal the
+       waiting task, so keep them inside the RTOS-managed range */
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
   }
 
 }
@@ -90,6 +96,9 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c)
   {
     /* Peripheral clock disable */
     __I2C1_CLK_DISABLE();
+
+    HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
   
     /**I2C1 GPIO Configuration    
     PB8     ------> I2C1_SCL
@@ -34,13 +34,35 @@
 #include "stm32f4xx_hal.h"
 #include "stm32f4xx.h"
 #include "stm32f4xx_it.h"
+#include "cmsis_os.h"
+#include "i2c_master_transfer.h"
+#include "dwt.h"
+#include "key.h"
+#include "cpu_load.h"
 
 /* USER CODE BEGIN 0 */
+/* HAL time. HAL_IncTick counts SysTick interrupts, which stop being
+   periodic once the scheduler runs with tickless idle; from then on the
+   kernel tick, stepped on after every sleep, carries it on from where
+   HAL_IncTick left off. */
+static __IO uint32_t halTick;
 
+void HAL_IncTick(void)
+{
+  halTick++;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  if (osKernelRunning())
+    return halTick + osKernelSysTick();
+  return halTick;
+}
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
 extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
+extern I2C_HandleTypeDef hi2c1;
 
 /******************************************************************************/
 /*            Cortex-M4 Processor Interruption and Exception Handlers         */ 
@@ -54,9 +76,11 @@ extern void xPortSysTickHandler(void);
 void SysTick_Handler(void)
 {
   //xPortSysTickHandler();   //for bno old
-  HAL_IncTick();
+  if (!osKernelRunning())
+    HAL_IncTick();
   HAL_SYSTICK_IRQHandler(); //call back in null
   osSystickHandler();  //for bno added by gu
+  dwt_Tick();
 }
 #endif
 /******************************************************************************/
@@ -72,9 +96,79 @@ void SysTick_Handler(void)
 void OTG_FS_IRQHandler(void)
 {
   /* USER CODE BEGIN OTG_FS_IRQn 0 */
-
+  uint32_t start = dwt_GetCycles();
   /* USER CODE END OTG_FS_IRQn 0 */
   HAL_PCD_IRQHandler(&hpcd_USB_OTG_FS);
+  /* USER CODE BEGIN OTG_FS_IRQn 1 */
+  cpu_load_isr(CPU_LOAD_ISR_USB, start);
+  /* USER CODE END OTG_FS_IRQn 1 */
+}
+
+/**
+* @brief This function handles EXTI line1 interrupt (BNO070 INTn, PB1).
+*/
+void EXTI1_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
+  cpu_load_isr(CPU_LOAD_ISR_INTN, start);
+}
+
+/**
+* @brief This function handles EXTI line4 interrupt (KEY1, PB4).
+*/
+void EXTI4_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  KEY_EXTI_IRQHandler();
+  cpu_load_isr(CPU_LOAD_ISR_KEYS, start);
+}
+
+/**
+* @brief This function handles EXTI lines 5-9 interrupt (KEY2/3, PB6/7).
+*/
+void EXTI9_5_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  KEY_EXTI_IRQHandler();
+  cpu_load_isr(CPU_LOAD_ISR_KEYS, start);
+}
+
+/**
+* @brief This function handles EXTI lines 10-15 interrupt (KEY0, PA15;
+* KEY4-6, PB12-14).
+*/
+void EXTI15_10_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  KEY_EXTI_IRQHandler();
+  cpu_load_isr(CPU_LOAD_ISR_KEYS, start);
+}
+
+/**
+* @brief This function handles I2C1 event interrupt.
+*/
+void I2C1_EV_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  HAL_I2C_Master_Transfer_EV_IRQHandler(&hi2c1);
+  cpu_load_isr(CPU_LOAD_ISR_I2C, start);
+}
+
+/**
+* @brief This function handles I2C1 error interrupt.
+*/
+void I2C1_ER_IRQHandler(void)
+{
+  uint32_t start = dwt_GetCycles();
+
+  HAL_I2C_Master_Transfer_ER_IRQHandler(&hi2c1);
+  cpu_load_isr(CPU_LOAD_ISR_I2C, start);
 }
 
 /* USER CODE BEGIN 1 */
@@ -0,0 +1,426 @@
+/*
+ * Runtime tracker configuration through HID feature reports. See
+ * tracker_config.h.
+ */
+
+#include <string.h>
+#include "stm32f4xx_hal.h"
+#include "tracker_config.h"
+#include "tracker_report.h"
+#include "usbd_hid.h"
+#include "usbd_hid_if.h"
+#include "bno070.h"
+#include "cpu_load.h"
+#include "mem_stats.h"
+#include "block_pool.h"
+#include "event_ring.h"
+#include "usb_device.h"
+
+#if TRACKER_FEATURE_SENSORS != HID_FEATURE_SENSORS_ID || \
+    TRACKER_FEATURE_SENSORS_SIZE != HID_FEATURE_SENSORS_SIZE || \
+    TRACKER_FEATURE_ARVR != HID_FEATURE_ARVR_ID || \
+    TRACKER_FEATURE_ARVR_SIZE != HID_FEATURE_ARVR_SIZE || \
+    TRACKER_FEATURE_PREDICTION != HID_FEATURE_PREDICTION_ID || \
+    TRACKER_FEATURE_PREDICTION_SIZE != HID_FEATURE_PREDICTION_SIZE || \
+    TRACKER_FEATURE_STATS != HID_FEATURE_STATS_ID || \
+    TRACKER_FEATURE_STATS_SIZE != HID_FEATURE_STATS_SIZE || \
+    TRACKER_FEATURE_TIMING != HID_FEATURE_TIMING_ID || \
+    TRACKER_FEATURE_TIMING_SIZE != HID_FEATURE_TIMING_SIZE || \
+    TRACKER_FEATURE_CPU != HID_FEATURE_CPU_ID || \
+    TRACKER_FEATURE_CPU_SIZE != HID_FEATURE_CPU_SIZE || \
+    TRACKER_FEATURE_MEMORY != HID_FEATURE_MEMORY_ID || \
+    TRACKER_FEATURE_MEMORY_SIZE != HID_FEATURE_MEMORY_SIZE || \
+    TRACKER_FEATURE_POOLS != HID_FEATURE_POOLS_ID || \
+    TRACKER_FEATURE_POOLS_SIZE != HID_FEATURE_POOLS_SIZE
+#error "Feature report layout does not match the HID report descriptor"
+#endif
+
+/* The stats report holds one uint32 per TRACKER_STAT_xxx */
+typedef char tracker_config_statsSizeCheck[
+    (TRACKER_FEATURE_STATS_SIZE == TRACKER_STAT_NUM * 4) ? 1 : -1];
+
+/* The cpu report is a straight copy of cpu_load_stats_t */
+typedef char tracker_config_cpuSizeCheck[
+    (TRACKER_FEATURE_CPU_SIZE == 16 + TRACKER_CPU_MAX_TASKS * TRACKER_CPU_TASK_SIZE &&
+     TRACKER_CPU_MAX_TASKS == CPU_LOAD_MAX_TASKS &&
+     TRACKER_CPU_NAME_LEN == CPU_LOAD_NAME_LEN &&
+     (int)TRACKER_CPU_ISR_NUM == (int)CPU_LOAD_ISR_NUM) ? 1 : -1];
+
+/* ... and the memory report of mem_stats_t and mem_stats_crash_t */
+typedef char tracker_config_memorySizeCheck[
+    (TRACKER_MEM_CRASH_OFFSET == 20 + TRACKER_MEM_MAX_TASKS * TRACKER_MEM_TASK_SIZE &&
+     TRACKER_FEATURE_MEMORY_SIZE == TRACKER_MEM_CRASH_OFFSET + 12 + TRACKER_MEM_NAME_LEN &&
+     TRACKER_MEM_MAX_TASKS == MEM_STATS_MAX_TASKS &&
+     TRACKER_MEM_NAME_LEN == MEM_STATS_NAME_LEN &&
+     TRACKER_MEM_WARN_STACK == MEM_STATS_WARN_STACK &&
+     TRACKER_MEM_WARN_HEAP == MEM_STATS_WARN_HEAP &&
+     (int)TRACKER_CRASH_STACK_OVERFLOW == (int)MEM_STATS_CRASH_STACK_OVERFLOW &&
+     (int)TRACKER_CRASH_MALLOC_FAILED == (int)MEM_STATS_CRASH_MALLOC_FAILED) ? 1 : -1];
+
+typedef char tracker_config_poolsSizeCheck[
+    (TRACKER_FEATURE_POOLS_SIZE == TRACKER_POOL_NUM * TRACKER_POOL_ENTRY_SIZE) ? 1 : -1];
+
+/* main.c, sensor thread to output thread */
+extern event_ring_t sensorEvents;
+
+#define TRACKER_INTERVAL_MIN_US     1000
+#define TRACKER_INTERVAL_MAX_US     1000000
+
+/* Positive constants only; usable in static initializers */
+#define TRACKER_FIXED(x, Q)         ((uint32_t)((x) * (double)(1ul << (Q)) + 0.5))
+
+/* Written by the USB interrupt and the command thread, read by the sensor
+   thread; every access is under a critical section */
+static tracker_config_t trackerConfig = {
+    TRACKER_REPORT_FIELDS,
+    TRACKER_SAMPLE_INTERVAL_US,
+    {
+        TRACKER_FIXED(0.2, 30),     /* scaling, 0.2 */
+        TRACKER_FIXED(0.131, 29),   /* max rotation, 7.5 degrees */
+        TRACKER_FIXED(0.262, 29),   /* max error, 15 degrees */
+        TRACKER_FIXED(0.00175, 29), /* stability magnitude, 0.1 degrees */
+    },
+    TRACKER_PREDICTION_US,
+};
+static uint32_t trackerConfigChanged;
+
+/* Every feature report, for SET_REPORT to check before the data stage */
+static const struct {
+    uint8_t id;
+    uint8_t writable;
+    uint16_t size;
+} trackerFeatures[] = {
+    { TRACKER_FEATURE_SENSORS, 1, TRACKER_FEATURE_SENSORS_SIZE },
+    { TRACKER_FEATURE_ARVR, 1, TRACKER_FEATURE_ARVR_SIZE },
+    { TRACKER_FEATURE_PREDICTION, 1, TRACKER_FEATURE_PREDICTION_SIZE },
+    { TRACKER_FEATURE_STATS, 0, TRACKER_FEATURE_STATS_SIZE },
+    { TRACKER_FEATURE_TIMING, 1, TRACKER_FEATURE_TIMING_SIZE },
+    { TRACKER_FEATURE_CPU, 0, TRACKER_FEATURE_CPU_SIZE },
+    { TRACKER_FEATURE_MEMORY, 1, TRACKER_FEATURE_MEMORY_SIZE },
+    { TRACKER_FEATURE_POOLS, 0, TRACKER_FEATURE_POOLS_SIZE },
+};
+
+static uint32_t tracker_config_get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void tracker_config_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void tracker_config_getStats(uint8_t *report)
+{
+    uint32_t stats[TRACKER_STAT_NUM];
+    int i;
+
+    stats[TRACKER_STAT_TRACKER_SENT] = USBD_HID_Stats[HID_ITF_TRACKER].sent;
+    stats[TRACKER_STAT_TRACKER_RECLAIMED] = USBD_HID_Stats[HID_ITF_TRACKER].reclaimed;
+    stats[TRACKER_STAT_TRACKER_DROPPED] = USBD_HID_Stats[HID_ITF_TRACKER].dropped;
+    stats[TRACKER_STAT_BUTTONS_SENT] = USBD_HID_Stats[HID_ITF_BUTTONS].sent;
+    stats[TRACKER_STAT_BUTTONS_DROPPED] = USBD_HID_Stats[HID_ITF_BUTTONS].dropped;
+    stats[TRACKER_STAT_COMMANDS] = USBD_HID_Stats[HID_ITF_CONFIG].received;
+    stats[TRACKER_STAT_COMMANDS_DROPPED] = hidCommandsDropped;
+    stats[TRACKER_STAT_SAMPLES] = tracker_report_stats.samples;
+    stats[TRACKER_STAT_SAMPLES_DROPPED] = tracker_report_stats.dropped;
+    stats[TRACKER_STAT_IN_REPORTS] = USBD_HidInRate.reports;
+    stats[TRACKER_STAT_IN_MAX_INTERVAL] = USBD_HidInRate.maxIntervalUs;
+    stats[TRACKER_STAT_IN_LATE] = USBD_HidInRate.late;
+    stats[TRACKER_STAT_I2C_ERRORS] = sensorhub.stats->i2cErrors;
+    stats[TRACKER_STAT_HUB_RESETS] = sensorhub.stats->hubResets;
+    stats[TRACKER_STAT_UPTIME_MS] = HAL_GetTick();
+
+    for (i = 0; i < TRACKER_STAT_NUM; i++)
+        tracker_config_put32(report + 4 * i, stats[i]);
+}
+
+static void tracker_config_getCpu(uint8_t *report)
+{
+    cpu_load_stats_t stats;
+    uint8_t *p;
+    int i;
+
+    cpu_load_getStats(&stats);
+
+    memset(report, 0, TRACKER_FEATURE_CPU_SIZE);
+    tracker_config_put32(report, stats.windowUs);
+    report[4] = (uint8_t)stats.idle;
+    report[5] = (uint8_t)(stats.idle >> 8);
+    for (i = 0; i < CPU_LOAD_ISR_NUM; i++) {
+        report[6 + 2 * i] = (uint8_t)stats.isr[i];
+        report[7 + 2 * i] = (uint8_t)(stats.isr[i] >> 8);
+    }
+    report[14] = stats.tasks;
+    for (i = 0; i < stats.tasks; i++) {
+        p = report + 16 + i * TRACKER_CPU_TASK_SIZE;
+        memcpy(p, stats.task[i].name, TRACKER_CPU_NAME_LEN);
+        p[8] = (uint8_t)stats.task[i].permille;
+        p[9] = (uint8_t)(stats.task[i].permille >> 8);
+        p[10] = stats.task[i].priority;
+    }
+}
+
+static void tracker_config_getMemory(uint8_t *report)
+{
+    mem_stats_t stats;
+    mem_stats_crash_t crash;
+    uint8_t *p;
+    int i;
+
+    mem_stats_get(&stats);
+    mem_stats_getCrash(&crash);
+
+    memset(report, 0, TRACKER_FEATURE_MEMORY_SIZE);
+    tracker_config_put32(report, stats.heapSize);
+    tracker_config_put32(report + 4, stats.heapFree);
+    tracker_config_put32(report + 8, stats.heapMinFree);
+    tracker_config_put32(report + 12, stats.heapLargest);
+    report[16] = (uint8_t)stats.heapBlocks;
+    report[17] = (uint8_t)(stats.heapBlocks >> 8);
+    report[18] = stats.warnings;
+    report[19] = stats.tasks;
+    for (i = 0; i < stats.tasks; i++) {
+        p = report + 20 + i * TRACKER_MEM_TASK_SIZE;
+        memcpy(p, stats.task[i].name, TRACKER_MEM_NAME_LEN);
+        p[8] = (uint8_t)stats.task[i].stackFree;
+        p[9] = (uint8_t)(stats.task[i].stackFree >> 8);
+    }
+
+    p = report + TRACKER_MEM_CRASH_OFFSET;
+    p[0] = crash.cause;
+    p[1] = crash.count;
+    tracker_config_put32(p + 4, crash.uptimeMs);
+    tracker_config_put32(p + 8, crash.heapFree);
+    memcpy(p + 12, crash.name, TRACKER_MEM_NAME_LEN);
+}
+
+static void tracker_config_getPools(uint8_t *report)
+{
+    block_pool_usage_t usage[TRACKER_POOL_NUM];
+    uint8_t *p;
+    int i;
+
+    block_pool_getUsage(&hidCommandPool, &usage[TRACKER_POOL_COMMANDS]);
+    event_ring_getUsage(&sensorEvents, &usage[TRACKER_POOL_EVENTS]);
+    usage[TRACKER_POOL_BUTTONS].blocks = HID_EVENT_QUEUE_LEN - 1;
+    usage[TRACKER_POOL_BUTTONS].inUse = USBD_HID_GetEventQueueDepth(&hUsbDeviceFS);
+    usage[TRACKER_POOL_BUTTONS].maxInUse = (uint16_t)USBD_HID_Stats[HID_ITF_BUTTONS].maxDepth;
+    usage[TRACKER_POOL_BUTTONS].allocs = USBD_HID_Stats[HID_ITF_BUTTONS].queued;
+    usage[TRACKER_POOL_BUTTONS].exhausted = USBD_HID_Stats[HID_ITF_BUTTONS].dropped;
+
+    memset(report, 0, TRACKER_FEATURE_POOLS_SIZE);
+    for (i = 0; i < TRACKER_POOL_NUM; i++) {
+        p = report + i * TRACKER_POOL_ENTRY_SIZE;
+        p[0] = (uint8_t)usage[i].blocks;
+        p[1] = (uint8_t)(usage[i].blocks >> 8);
+        p[2] = (uint8_t)usage[i].inUse;
+        p[3] = (uint8_t)(usage[i].inUse >> 8);
+        p[4] = (uint8_t)usage[i].maxInUse;
+        p[5] = (uint8_t)(usage[i].maxInUse >> 8);
+        tracker_config_put32(p + 8, usage[i].allocs);
+        tracker_config_put32(p + 12, usage[i].exhausted);
+    }
+}
+
+static void tracker_config_getTiming(uint8_t *report)
+{
+    USBD_InRateTypeDef rate;
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    rate = USBD_HidInRate;
+    __set_PRIMASK(primask);
+
+    memset(report, 0, TRACKER_FEATURE_TIMING_SIZE);
+    report[0] = USBD_HID_GetSofSync();
+    report[1] = (USBD_GetSofUsers() & USBD_SOF_TIMING) ? 1 : 0;
+    tracker_config_put32(report + 4, rate.reports);
+    tracker_config_put32(report + 8, rate.phased ? rate.totalPhaseUs / rate.phased : 0);
+    tracker_config_put32(report + 12, rate.aged ? rate.totalAgeUs / rate.aged : 0);
+    tracker_config_put32(report + 16, rate.maxAgeUs);
+}
+
+int tracker_config_getFeatureSize(uint8_t id, uint16_t *len, uint8_t *writable)
+{
+    int i;
+
+    for (i = 0; i < sizeof(trackerFeatures) / sizeof(trackerFeatures[0]); i++) {
+        if (trackerFeatures[i].id == id) {
+            *len = trackerFeatures[i].size;
+            *writable = trackerFeatures[i].writable;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int tracker_config_getFeature(uint8_t id, uint8_t *report, uint16_t *len)
+{
+    tracker_config_t config;
+    uint32_t primask;
+    int i;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    config = trackerConfig;
+    __set_PRIMASK(primask);
+
+    switch (id) {
+    case TRACKER_FEATURE_SENSORS:
+        report[0] = config.fields;
+        tracker_config_put32(report + 1, config.intervalUs);
+        *len = TRACKER_FEATURE_SENSORS_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_ARVR:
+        for (i = 0; i < 4; i++)
+            tracker_config_put32(report + 4 * i, config.arvr[i]);
+        *len = TRACKER_FEATURE_ARVR_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_PREDICTION:
+        report[0] = (uint8_t)config.predictionUs;
+        report[1] = (uint8_t)(config.predictionUs >> 8);
+        *len = TRACKER_FEATURE_PREDICTION_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_STATS:
+        tracker_config_getStats(report);
+        *len = TRACKER_FEATURE_STATS_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_TIMING:
+        tracker_config_getTiming(report);
+        *len = TRACKER_FEATURE_TIMING_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_CPU:
+        tracker_config_getCpu(report);
+        *len = TRACKER_FEATURE_CPU_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_MEMORY:
+        tracker_config_getMemory(report);
+        *len = TRACKER_FEATURE_MEMORY_SIZE;
+        return 0;
+
+    case TRACKER_FEATURE_POOLS:
+        tracker_config_getPools(report);
+        *len = TRACKER_FEATURE_POOLS_SIZE;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+int tracker_config_setFeature(uint8_t id, const uint8_t *report, uint16_t len)
+{
+    uint32_t primask;
+    uint32_t interval;
+    uint16_t horizon;
+    int i;
+
+    switch (id) {
+    case TRACKER_FEATURE_SENSORS:
+        if (len != TRACKER_FEATURE_SENSORS_SIZE)
+            return -1;
+        interval = tracker_config_get32(report + 1);
+        if ((report[0] & ~(TRACKER_FIELD_QUAT | TRACKER_FIELD_GYRO | TRACKER_FIELD_ACCEL))
+            || interval < TRACKER_INTERVAL_MIN_US || interval > TRACKER_INTERVAL_MAX_US)
+            return -1;
+        primask = __get_PRIMASK();
+        __disable_irq();
+        trackerConfig.fields = report[0] | TRACKER_FIELD_QUAT;
+        trackerConfig.intervalUs = interval;
+        trackerConfigChanged |= TRACKER_CONFIG_SENSORS;
+        __set_PRIMASK(primask);
+        return 0;
+
+    case TRACKER_FEATURE_ARVR:
+        if (len != TRACKER_FEATURE_ARVR_SIZE)
+            return -1;
+        primask = __get_PRIMASK();
+        __disable_irq();
+        for (i = 0; i < 4; i++)
+            trackerConfig.arvr[i] = tracker_config_get32(report + 4 * i);
+        trackerConfigChanged |= TRACKER_CONFIG_ARVR;
+        __set_PRIMASK(primask);
+        return 0;
+
+    case TRACKER_FEATURE_PREDICTION:
+        if (len != TRACKER_FEATURE_PREDICTION_SIZE)
+            return -1;
+        horizon = report[0] | (report[1] << 8);
+        if (horizon > TRACKER_PREDICTION_MAX_US)
+            return -1;
+        primask = __get_PRIMASK();
+        __disable_irq();
+        trackerConfig.predictionUs = horizon;
+        trackerConfigChanged |= TRACKER_CONFIG_SENSORS;
+        __set_PRIMASK(primask);
+        return 0;
+
+    case TRACKER_FEATURE_TIMING:
+        if (len != TRACKER_FEATURE_TIMING_SIZE || report[0] > 1 || report[1] > 1)
+            return -1;
+        /* Only USB state, nothing for the sensor thread */
+        USBD_HID_SetSofSync(report[0]);
+        USBD_SofInterrupt(USBD_SOF_TIMING, report[1]);
+        USBD_ResetInRate();
+        return 0;
+
+    case TRACKER_FEATURE_MEMORY:
+        if (len != TRACKER_FEATURE_MEMORY_SIZE)
+            return -1;
+        mem_stats_clearCrash();
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+void tracker_config_setInterval(uint32_t intervalUs)
+{
+    uint32_t primask;
+
+    if (intervalUs < TRACKER_INTERVAL_MIN_US || intervalUs > TRACKER_INTERVAL_MAX_US)
+        return;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    trackerConfig.intervalUs = intervalUs;
+    trackerConfigChanged |= TRACKER_CONFIG_SENSORS;
+    __set_PRIMASK(primask);
+}
+
+void tracker_config_recalibrate(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    trackerConfigChanged |= TRACKER_CONFIG_RECALIBRATE;
+    __set_PRIMASK(primask);
+}
+
+uint32_t tracker_config_take(tracker_config_t *config)
+{
+    uint32_t primask;
+    uint32_t changed;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *config = trackerConfig;
+    changed = trackerConfigChanged;
+    trackerConfigChanged = 0;
+    __set_PRIMASK(primask);
+
+    return changed;
+}
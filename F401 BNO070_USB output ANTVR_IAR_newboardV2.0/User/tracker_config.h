@@ -0,0 +1,226 @@
+/*
+ * Runtime tracker configuration through HID feature reports on the config
+ * interface (HID interface 2). Hosts use GET_REPORT/SET_REPORT on the
+ * control pipe (HIDIOCGFEATURE/HIDIOCSFEATURE on hidraw), so configuration
+ * never competes with the streaming endpoints. Byte 0 of every report is
+ * the report ID; all fields are little endian. SET_REPORT stalls for a
+ * read only report or a wrong length, and in the status stage for
+ * values out of range, so HIDIOCSFEATURE fails rather than the write
+ * being dropped.
+ *
+ *   0x02 sensors (read/write, 5 bytes)
+ *     0  fields      TRACKER_FIELD_xxx bits to pack into tracker reports;
+ *                    the hub sensors are enabled to match
+ *     1  interval    uint32, hub report interval in microseconds
+ *
+ *   0x03 ARVR tuning (read/write, 16 bytes), the ARVR_CONFIG and
+ *        ARVR_GAME_CONFIG FRS records; the hub is reset to apply them
+ *     0  scaling     uint32, dimensionless, Q30
+ *     4  maxRotation uint32, radians, Q29
+ *     8  maxError    uint32, radians, Q29
+ *    12  stability   uint32, radians, Q29
+ *
+ *   0x04 prediction (read/write, 2 bytes)
+ *     0  horizon     uint16, microseconds to extrapolate the rotation
+ *                    vector with the gyro; 0 turns prediction off
+ *
+ *   0x05 stats (read only, 60 bytes)
+ *     0  counters    uint32 each, TRACKER_STAT_xxx order
+ *
+ *   0x06 timing (read/write, 20 bytes); a write sets sync and every
+ *        frame, ignores the rest and restarts the measurement
+ *     0  sync        1 if tracker reports are loaded into the IN FIFO at
+ *                    the SOF of the poll frame, 0 if as soon as possible
+ *     1  everyFrame  1 to take the SOF interrupt in every frame, so the
+ *                    phase is known for every report; it keeps the CPU
+ *                    from sleeping longer than a frame. 0 to take it only
+ *                    while a report waits for its frame (sync)
+ *     2  reserved    2 bytes
+ *     4  reports     uint32, tracker reports collected since the restart
+ *     8  phase       uint32, mean time from SOF to collection, us, over
+ *                    the reports collected in a frame whose SOF was taken
+ *    12  meanAge     uint32, mean age of the newest sample at collection, us
+ *    16  maxAge      uint32, largest such age, us
+ *
+ *        Comparing meanAge with sync on and off shows what the SOF
+ *        synchronisation gains on a given host.
+ *
+ *   0x07 cpu (read only, 112 bytes), the last one second window; all
+ *        shares are in 0.1 % units of the window
+ *     0  window      uint32, window length, us
+ *     4  idle        uint16, idle task share, tickless sleep included
+ *     6  isr         uint16 each, time in the interrupt handlers,
+ *                    TRACKER_CPU_ISR_xxx order; also part of the share
+ *                    of the task each one interrupted
+ *    14  tasks       number of task entries in use
+ *    15  reserved
+ *    16  task        TRACKER_CPU_MAX_TASKS entries of 12 bytes:
+ *                      0  name      TRACKER_CPU_NAME_LEN bytes, NUL padded
+ *                      8  share     uint16
+ *                     10  priority  FreeRTOS priority
+ *                     11  reserved
+ *
+ *   0x08 memory (read/write, 136 bytes), sampled once a second; a write
+ *        of any content clears the crash record
+ *     0  heapSize    uint32, heap_4 arena, bytes
+ *     4  heapFree    uint32, free now
+ *     8  heapMinFree uint32, lowest free since boot
+ *    12  largest     uint32, largest free block; against heapFree this
+ *                    shows the fragmentation
+ *    16  blocks      uint16, number of free blocks
+ *    18  warnings    TRACKER_MEM_WARN_xxx bits
+ *    19  tasks       number of task entries in use
+ *    20  task        TRACKER_MEM_MAX_TASKS entries of 12 bytes:
+ *                      0  name       TRACKER_MEM_NAME_LEN bytes, NUL padded
+ *                      8  stackFree  uint16, lowest free stack, words
+ *                     10  reserved
+ *   116  crash       the last kernel detected crash, kept across the
+ *                    reset that follows it:
+ *                      0  cause      TRACKER_CRASH_xxx
+ *                      1  count      crashes since power up or clear
+ *                      2  reserved
+ *                      4  uptime     uint32, ms since boot at the crash
+ *                      8  heapFree   uint32, at the crash
+ *                     12  name       task running, NUL padded
+ *
+ *   0x09 pools (read only, 48 bytes), the fixed-size block stores, one
+ *        16 byte entry each in TRACKER_POOL_xxx order:
+ *     0  blocks      uint16, capacity
+ *     2  inUse       uint16, in use now
+ *     4  maxInUse    uint16, high-water mark since boot
+ *     6  reserved
+ *     8  allocs      uint32, blocks handed out
+ *    12  exhausted   uint32, allocations refused because all were in use
+ *
+ * Settings written here are picked up by the sensor thread between hub
+ * polls and are not kept across resets. A GET returns the last value set.
+ *
+ * The format part of this header (up to TRACKER_CONFIG_HOST) has no
+ * firmware dependencies and can be shared with host software.
+ */
+
+#ifndef TRACKER_CONFIG_H
+#define TRACKER_CONFIG_H
+
+#include <stdint.h>
+
+#define TRACKER_FEATURE_SENSORS         0x02
+#define TRACKER_FEATURE_SENSORS_SIZE    5
+#define TRACKER_FEATURE_ARVR            0x03
+#define TRACKER_FEATURE_ARVR_SIZE       16
+#define TRACKER_FEATURE_PREDICTION      0x04
+#define TRACKER_FEATURE_PREDICTION_SIZE 2
+#define TRACKER_FEATURE_STATS           0x05
+#define TRACKER_FEATURE_STATS_SIZE      60
+#define TRACKER_FEATURE_TIMING          0x06
+#define TRACKER_FEATURE_TIMING_SIZE     20
+#define TRACKER_FEATURE_CPU             0x07
+#define TRACKER_FEATURE_CPU_SIZE        112
+
+#define TRACKER_CPU_MAX_TASKS           8
+#define TRACKER_CPU_NAME_LEN            8
+#define TRACKER_CPU_TASK_SIZE           12
+
+#define TRACKER_FEATURE_MEMORY          0x08
+#define TRACKER_FEATURE_MEMORY_SIZE     136
+
+#define TRACKER_MEM_MAX_TASKS           8
+#define TRACKER_MEM_NAME_LEN            8
+#define TRACKER_MEM_TASK_SIZE           12
+#define TRACKER_MEM_CRASH_OFFSET        116
+
+#define TRACKER_MEM_WARN_STACK          0x01    /* a task has little stack left */
+#define TRACKER_MEM_WARN_HEAP           0x02    /* the heap came close to full */
+
+#define TRACKER_FEATURE_POOLS           0x09
+#define TRACKER_FEATURE_POOLS_SIZE      48
+#define TRACKER_POOL_ENTRY_SIZE         16
+
+enum {
+    TRACKER_POOL_COMMANDS,          /* host command blocks */
+    TRACKER_POOL_EVENTS,            /* decoded hub events, sensor to output task */
+    TRACKER_POOL_BUTTONS,           /* button event reports waiting for the IN endpoint */
+    TRACKER_POOL_NUM
+};
+
+enum {
+    TRACKER_CRASH_NONE,
+    TRACKER_CRASH_STACK_OVERFLOW,
+    TRACKER_CRASH_MALLOC_FAILED
+};
+
+enum {
+    TRACKER_CPU_ISR_USB,            /* OTG_FS */
+    TRACKER_CPU_ISR_I2C,            /* I2C1 event and error */
+    TRACKER_CPU_ISR_INTN,           /* EXTI1, hub INTn */
+    TRACKER_CPU_ISR_KEYS,           /* key EXTI lines */
+    TRACKER_CPU_ISR_NUM
+};
+
+/* Longest accepted prediction horizon */
+#define TRACKER_PREDICTION_MAX_US       50000
+
+enum {
+    TRACKER_STAT_TRACKER_SENT,      /* tracker IN reports sent */
+    TRACKER_STAT_TRACKER_RECLAIMED, /* tracker reports reopened to append
+                                       a sample before they were sent */
+    TRACKER_STAT_TRACKER_DROPPED,   /* tracker reports refused by the class */
+    TRACKER_STAT_BUTTONS_SENT,
+    TRACKER_STAT_BUTTONS_DROPPED,
+    TRACKER_STAT_COMMANDS,          /* config channel OUT reports received */
+    TRACKER_STAT_COMMANDS_DROPPED,  /* ... and lost to a full command queue */
+    TRACKER_STAT_SAMPLES,           /* rotation vector samples packed */
+    TRACKER_STAT_SAMPLES_DROPPED,   /* samples the host never collected */
+    TRACKER_STAT_IN_REPORTS,        /* tracker IN completions measured */
+    TRACKER_STAT_IN_MAX_INTERVAL,   /* longest gap between them, us */
+    TRACKER_STAT_IN_LATE,           /* gaps over 1.5 polling intervals */
+    TRACKER_STAT_I2C_ERRORS,
+    TRACKER_STAT_HUB_RESETS,
+    TRACKER_STAT_UPTIME_MS,
+    TRACKER_STAT_NUM
+};
+
+#ifndef TRACKER_CONFIG_HOST
+
+/* Prediction horizon at boot; override at build time */
+#ifndef TRACKER_PREDICTION_US
+#define TRACKER_PREDICTION_US           0
+#endif
+
+typedef struct {
+    uint8_t fields;             /* TRACKER_FIELD_xxx */
+    uint32_t intervalUs;
+    uint32_t arvr[4];           /* scaling, maxRotation, maxError, stability */
+    uint16_t predictionUs;
+} tracker_config_t;
+
+/* tracker_config_take() result bits: what changed since the last call */
+#define TRACKER_CONFIG_SENSORS      0x01    /* fields, interval, prediction */
+#define TRACKER_CONFIG_ARVR         0x02
+#define TRACKER_CONFIG_RECALIBRATE  0x04
+
+/* Any context. Gives the length of a feature report (without the ID
+   byte) and whether the host may write it; returns 0, or -1 for an
+   unknown report ID. */
+int tracker_config_getFeatureSize(uint8_t id, uint16_t *len, uint8_t *writable);
+
+/* Any context. Fills a feature report (without the ID byte) and its
+   length; returns 0, or -1 for an unknown report ID. */
+int tracker_config_getFeature(uint8_t id, uint8_t *report, uint16_t *len);
+
+/* Any context. Validates and records a feature report for the sensor
+   thread (the timing and memory reports take effect at once); returns 0, or -1 if
+   it is unknown, read only or out of range. */
+int tracker_config_setFeature(uint8_t id, const uint8_t *report, uint16_t len);
+
+/* Requests from the command thread */
+void tracker_config_setInterval(uint32_t intervalUs);
+void tracker_config_recalibrate(void);
+
+/* Sensor thread side. Copies the current configuration to config and
+   returns the TRACKER_CONFIG_xxx bits set since the last call. */
+uint32_t tracker_config_take(tracker_config_t *config);
+
+#endif /* TRACKER_CONFIG_HOST */
+
+#endif /* TRACKER_CONFIG_H */
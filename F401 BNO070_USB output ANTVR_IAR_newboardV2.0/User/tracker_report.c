@@ -0,0 +1,171 @@
+/*
+ * Packed multi-sample head tracker reports. See tracker_report.h.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "tracker_report.h"
+#include "usb_device.h"
+#include "usbd_hid.h"
+
+#if TRACKER_REPORT_SIZE != HID_TRACKER_REPORT_SIZE
+#error "Tracker report format does not match the HID report descriptor"
+#endif
+
+tracker_report_stats_t tracker_report_stats;
+
+static uint8_t trackerFields = TRACKER_REPORT_FIELDS;
+static uint16_t predictionUs;
+static uint8_t reportSeq;
+static uint16_t sampleSeq;
+static int16_t lastGyro[3];
+static int16_t lastAccel[3];
+
+static uint8_t *tracker_report_put16(uint8_t *p, int16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)((uint16_t)v >> 8);
+    return p + 2;
+}
+
+void tracker_report_init(uint8_t fields)
+{
+    trackerFields = fields | TRACKER_FIELD_QUAT;
+}
+
+void tracker_report_setPrediction(uint16_t horizonUs)
+{
+    predictionUs = horizonUs;
+}
+
+static int16_t tracker_report_toQ14(float v)
+{
+    v *= 16384.0f;
+    if (v > 32767.0f)
+        v = 32767.0f;
+    else if (v < -32768.0f)
+        v = -32768.0f;
+    return (int16_t)(v + ((v >= 0) ? 0.5f : -0.5f));
+}
+
+/* q' = q * [w * dt / 2, 1], renormalised. The gyro is in the sensor frame,
+   so the rotation is applied on the right. */
+static void tracker_report_predict(int16_t *q)
+{
+    const float scale = predictionUs * 1e-6f * 0.5f / (1 << 9);
+    float hx = lastGyro[0] * scale;
+    float hy = lastGyro[1] * scale;
+    float hz = lastGyro[2] * scale;
+    float x = q[0] / 16384.0f;
+    float y = q[1] / 16384.0f;
+    float z = q[2] / 16384.0f;
+    float w = q[3] / 16384.0f;
+    float px = w * hx + x + y * hz - z * hy;
+    float py = w * hy - x * hz + y + z * hx;
+    float pz = w * hz + x * hy - y * hx + z;
+    float pw = w - x * hx - y * hy - z * hz;
+    float norm = sqrtf(px * px + py * py + pz * pz + pw * pw);
+
+    if (norm <= 0.0f)
+        return;
+    q[0] = tracker_report_toQ14(px / norm);
+    q[1] = tracker_report_toQ14(py / norm);
+    q[2] = tracker_report_toQ14(pz / norm);
+    q[3] = tracker_report_toQ14(pw / norm);
+}
+
+static void tracker_report_addSample(const sensorhub_Event_t *event)
+{
+    int size = tracker_report_sampleSize(trackerFields);
+    int max = tracker_report_maxSamples(trackerFields);
+    uint8_t header = trackerFields | (predictionUs ? TRACKER_FIELD_PREDICTED : 0);
+    int16_t quat[4];
+    uint16_t pending;
+    uint8_t *report;
+    uint8_t *p;
+
+    /* A reclaimed report the host has not collected yet is appended to,
+       so no sample is lost while it keeps polling */
+    report = USBD_HID_GetReportBuffer(&hUsbDeviceFS, &pending);
+    if (report == NULL) {
+        tracker_report_stats.dropped++;
+        return;
+    }
+
+    if (pending == 0 || report[1] != header) {
+        if (pending != 0)
+            tracker_report_stats.dropped += report[0];
+        memset(report, 0, TRACKER_REPORT_SIZE);
+        report[1] = header;
+        report[2] = reportSeq++;
+        tracker_report_stats.reports++;
+    }
+    else if (report[0] == max) {
+        /* Full: keep the newest samples */
+        memmove(report + TRACKER_HEADER_SIZE,
+                report + TRACKER_HEADER_SIZE + size, (max - 1) * size);
+        report[0]--;
+        if (report[3] < 255)
+            report[3]++;
+        tracker_report_stats.dropped++;
+    }
+
+    p = report + TRACKER_HEADER_SIZE + report[0] * size;
+    p = tracker_report_put16(p, (int16_t)sampleSeq++);
+    *p++ = (uint8_t)event->timestamp;
+    *p++ = (uint8_t)(event->timestamp >> 8);
+    *p++ = (uint8_t)(event->timestamp >> 16);
+    *p++ = (uint8_t)(event->timestamp >> 24);
+    quat[0] = event->un.rotationVector.i_16Q14;
+    quat[1] = event->un.rotationVector.j_16Q14;
+    quat[2] = event->un.rotationVector.k_16Q14;
+    quat[3] = event->un.rotationVector.real_16Q14;
+    if (predictionUs)
+        tracker_report_predict(quat);
+    p = tracker_report_put16(p, quat[0]);
+    p = tracker_report_put16(p, quat[1]);
+    p = tracker_report_put16(p, quat[2]);
+    p = tracker_report_put16(p, quat[3]);
+    if (trackerFields & TRACKER_FIELD_GYRO) {
+        p = tracker_report_put16(p, lastGyro[0]);
+        p = tracker_report_put16(p, lastGyro[1]);
+        p = tracker_report_put16(p, lastGyro[2]);
+    }
+    if (trackerFields & TRACKER_FIELD_ACCEL) {
+        p = tracker_report_put16(p, lastAccel[0]);
+        p = tracker_report_put16(p, lastAccel[1]);
+        p = tracker_report_put16(p, lastAccel[2]);
+    }
+    report[0]++;
+    tracker_report_stats.samples++;
+
+    USBD_HID_SubmitReport(&hUsbDeviceFS, TRACKER_REPORT_SIZE, event->timestamp);
+}
+
+int tracker_report_addEvent(const sensorhub_Event_t *event)
+{
+    switch (event->sensor) {
+    case SENSORHUB_ROTATION_VECTOR:
+        tracker_report_addSample(event);
+        return 1;
+
+    case SENSORHUB_GYROSCOPE_CALIBRATED:
+        if (!(trackerFields & TRACKER_FIELD_GYRO) && !predictionUs)
+            return 0;
+        lastGyro[0] = event->un.gyroscope.x_16Q9;
+        lastGyro[1] = event->un.gyroscope.y_16Q9;
+        lastGyro[2] = event->un.gyroscope.z_16Q9;
+        return 1;
+
+    case SENSORHUB_ACCELEROMETER:
+        if (!(trackerFields & TRACKER_FIELD_ACCEL))
+            return 0;
+        lastAccel[0] = event->un.accelerometer.x_16Q8;
+        lastAccel[1] = event->un.accelerometer.y_16Q8;
+        lastAccel[2] = event->un.accelerometer.z_16Q8;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
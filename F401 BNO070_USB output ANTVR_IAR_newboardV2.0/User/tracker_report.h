@@ -0,0 +1,149 @@
+/*
+ * Packed multi-sample head tracker reports (HID interface 0).
+ *
+ * Each 64-byte input report carries up to tracker_report_maxSamples() rotation
+ * vector samples, so the host receives every sample even when it polls
+ * slower than the hub produces them. All fields are little endian.
+ *
+ *   0  count      number of samples in this report
+ *   1  fields     TRACKER_FIELD_xxx bits present in every sample
+ *   2  reportSeq  increments for each new report
+ *   3  dropped    samples discarded from this report because it was
+ *                 full before the host collected it (saturates at 255)
+ *   4  samples    count * tracker_report_sampleSize(fields) bytes
+ *
+ * Each sample:
+ *
+ *   0  seq        uint16, increments per sample; gaps mean lost samples
+ *   2  timestamp  uint32, microseconds (INTn time minus hub delay)
+ *   6  quat       int16 i, j, k, real, Q14
+ *  14  gyro       int16 x, y, z, rad/s Q9     if TRACKER_FIELD_GYRO
+ *   +  accel      int16 x, y, z, m/s^2 Q8     if TRACKER_FIELD_ACCEL
+ *
+ * Gyro and accel are the newest values from their own sensor reports at
+ * the time of the rotation vector sample. With TRACKER_FIELD_PREDICTED
+ * set, quat has been extrapolated with the gyro to timestamp plus the
+ * prediction horizon (see tracker_config.h); timestamp is unchanged.
+ *
+ * The format part of this header (up to TRACKER_REPORT_HOST) has no
+ * firmware dependencies and can be shared with host software, which
+ * decodes a report with tracker_report_decode().
+ */
+
+#ifndef TRACKER_REPORT_H
+#define TRACKER_REPORT_H
+
+#include <stdint.h>
+
+#define TRACKER_REPORT_SIZE         64
+#define TRACKER_HEADER_SIZE         4
+
+#define TRACKER_FIELD_QUAT          0x01    /* always present */
+#define TRACKER_FIELD_GYRO          0x02
+#define TRACKER_FIELD_ACCEL         0x04
+#define TRACKER_FIELD_PREDICTED     0x08    /* header only, no sample data */
+
+/* Fields sent by default; override at build time */
+#ifndef TRACKER_REPORT_FIELDS
+#define TRACKER_REPORT_FIELDS       TRACKER_FIELD_QUAT
+#endif
+
+/* Rotation vector (and gyro/accel) report interval requested from the hub */
+#ifndef TRACKER_SAMPLE_INTERVAL_US
+#define TRACKER_SAMPLE_INTERVAL_US  1000
+#endif
+
+typedef struct {
+    uint16_t seq;
+    uint32_t timestamp;
+    int16_t quat_16Q14[4];      /* i, j, k, real */
+    int16_t gyro_16Q9[3];       /* zero unless TRACKER_FIELD_GYRO */
+    int16_t accel_16Q8[3];      /* zero unless TRACKER_FIELD_ACCEL */
+} tracker_sample_t;
+
+static inline int tracker_report_sampleSize(uint8_t fields)
+{
+    return 14 + ((fields & TRACKER_FIELD_GYRO) ? 6 : 0)
+              + ((fields & TRACKER_FIELD_ACCEL) ? 6 : 0);
+}
+
+static inline int tracker_report_maxSamples(uint8_t fields)
+{
+    return (TRACKER_REPORT_SIZE - TRACKER_HEADER_SIZE)
+           / tracker_report_sampleSize(fields);
+}
+
+static inline int16_t tracker_report_get16(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+/* Decodes up to maxSamples samples of a report. Returns the number of
+   samples written to samples[], or -1 if the report is malformed. */
+static inline int tracker_report_decode(const uint8_t *report,
+                                        tracker_sample_t *samples,
+                                        int maxSamples)
+{
+    uint8_t count = report[0];
+    uint8_t fields = report[1];
+    int size = tracker_report_sampleSize(fields);
+    const uint8_t *p = report + TRACKER_HEADER_SIZE;
+    int n, i;
+
+    if (count > tracker_report_maxSamples(fields))
+        return -1;
+
+    for (n = 0; n < count && n < maxSamples; n++, p += size) {
+        const uint8_t *f = p + 14;
+        tracker_sample_t *s = &samples[n];
+
+        s->seq = (uint16_t)tracker_report_get16(p);
+        s->timestamp = p[2] | (p[3] << 8) | ((uint32_t)p[4] << 16)
+                     | ((uint32_t)p[5] << 24);
+        for (i = 0; i < 4; i++)
+            s->quat_16Q14[i] = tracker_report_get16(p + 6 + 2 * i);
+        for (i = 0; i < 3; i++) {
+            s->gyro_16Q9[i] = 0;
+            s->accel_16Q8[i] = 0;
+        }
+        if (fields & TRACKER_FIELD_GYRO) {
+            for (i = 0; i < 3; i++)
+                s->gyro_16Q9[i] = tracker_report_get16(f + 2 * i);
+            f += 6;
+        }
+        if (fields & TRACKER_FIELD_ACCEL) {
+            for (i = 0; i < 3; i++)
+                s->accel_16Q8[i] = tracker_report_get16(f + 2 * i);
+        }
+    }
+    return n;
+}
+
+#ifndef TRACKER_REPORT_HOST
+
+#include "sensorhub.h"
+
+typedef struct {
+    uint32_t samples;       /* rotation vector samples packed */
+    uint32_t reports;       /* reports started */
+    uint32_t dropped;       /* samples lost to a full or discarded report */
+} tracker_report_stats_t;
+
+extern tracker_report_stats_t tracker_report_stats;
+
+/* Selects the TRACKER_FIELD_xxx bits for the following reports. The
+   caller enables the matching hub sensors. */
+void tracker_report_init(uint8_t fields);
+
+/* Extrapolates the quaternion horizonUs ahead with the latest gyro
+   sample; 0 turns prediction off. The caller enables the gyro. */
+void tracker_report_setPrediction(uint16_t horizonUs);
+
+/* Output task side. Packs a rotation vector sample into the tracker
+   report and submits it, or records gyro/accel for the next sample.
+   Returns 1 if the event was consumed, 0 if the tracker does not use it. */
+int tracker_report_addEvent(const sensorhub_Event_t *event);
+
+#endif /* TRACKER_REPORT_HOST */
+
+#endif /* TRACKER_REPORT_H */
@@ -38,6 +38,7 @@
 #include "usbd_core.h"
 #include "usbd_desc.h"
 #include "usbd_hid.h"
+#include "usbd_hid_if.h"
 
 /* USB Device Core handle declaration */
 USBD_HandleTypeDef hUsbDeviceFS;
@@ -50,6 +51,8 @@ void MX_USB_DEVICE_Init(void)
 
   USBD_RegisterClass(&hUsbDeviceFS, &USBD_HID);
 
+  USBD_HID_RegisterInterface(&hUsbDeviceFS, &USBD_HID_fops_FS);
+
   USBD_Start(&hUsbDeviceFS);
 
 }
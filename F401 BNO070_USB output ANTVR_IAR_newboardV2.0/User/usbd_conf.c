@@ -36,8 +36,43 @@
 #include "stm32f4xx_hal.h"
 #include "usbd_def.h"
 #include "usbd_core.h"
+#include "usbd_hid.h"
+#include "dwt.h"
+
+/* OTG_FS FIFO allocation in 32-bit words; the F401 core has 320 in
+   total. The tracker and buttons IN FIFOs hold two reports each so the
+   next one can be loaded while the host has yet to collect the previous
+   one; the config channel gets one */
+#define USBD_FS_RX_FIFO_WORDS     0x80
+#define USBD_FS_TX0_FIFO_WORDS    0x40
+#define USBD_FS_TX1_FIFO_WORDS    (2 * HID_TRACKER_EPIN_SIZE / 4)
+#if USBD_RAW_LOG
+#define USBD_FS_TX2_FIFO_WORDS    (2 * HID_LOG_EPIN_SIZE / 4)
+#else
+#define USBD_FS_TX2_FIFO_WORDS    (2 * HID_BUTTONS_EPIN_SIZE / 4)
+#endif
+#define USBD_FS_TX3_FIFO_WORDS    (HID_CONFIG_EPIN_SIZE / 4)
+
+#if (USBD_FS_RX_FIFO_WORDS + USBD_FS_TX0_FIFO_WORDS + USBD_FS_TX1_FIFO_WORDS + \
+     USBD_FS_TX2_FIFO_WORDS + USBD_FS_TX3_FIFO_WORDS) > 320
+#error "OTG_FS FIFO allocation exceeds the 1.25 KB FIFO RAM"
+#endif
+
+/* Class data arena. USBD_HID_HandleTypeDef holds the state of all three
+   HID interfaces; it is the only class allocation. The budget catches
+   the handle outgrowing what was planned for it in RAM */
+#define USBD_CLASS_DATA_BUDGET    1024
+#define USBD_CLASS_DATA_WORDS     ((sizeof(USBD_HID_HandleTypeDef) + 3) / 4)
+
+typedef char USBD_ClassDataBudgetCheck[
+    (sizeof(USBD_HID_HandleTypeDef) <= USBD_CLASS_DATA_BUDGET) ? 1 : -1];
 
 PCD_HandleTypeDef hpcd_USB_OTG_FS;
+USBD_InRateTypeDef USBD_HidInRate;
+
+static uint32_t USBD_ClassData[USBD_CLASS_DATA_WORDS];   /* word aligned */
+static uint8_t USBD_ClassDataUsed;
+static uint8_t USBD_SofUsers;           /* USBD_SOF_xxx bits */
 
 /* External functions --------------------------------------------------------*/
 void SystemClock_Config(void);
@@ -79,7 +114,9 @@ void HAL_PCD_MspInit(PCD_HandleTypeDef* hpcd)
     __USB_OTG_FS_CLK_ENABLE();
 
     /* Peripheral interrupt init*/
-    HAL_NVIC_SetPriority(OTG_FS_IRQn, 0, 0);
+    /* At configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY so the HID class
+       can post host commands to the RTOS from the interrupt */
+    HAL_NVIC_SetPriority(OTG_FS_IRQn, 5, 0);
     HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
   /* USER CODE BEGIN USB_OTG_FS_MspInit 1 */
 
@@ -141,9 +178,165 @@ void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
   */
 void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 {
+  if (epnum == (HID_TRACKER_EPIN_ADDR & 0x7F))
+  {
+    uint32_t now = dwt_GetCycles();
+    uint32_t stamp;
+    uint32_t phase;
+    
+    if (USBD_HidInRate.reports != 0)
+    {
+      uint32_t interval = dwt_CyclesToUs(now - USBD_HidInRate.lastCycles);
+      
+      if (interval < USBD_HidInRate.minIntervalUs)
+      {
+        USBD_HidInRate.minIntervalUs = interval;
+      }
+      if (interval > USBD_HidInRate.maxIntervalUs)
+      {
+        USBD_HidInRate.maxIntervalUs = interval;
+      }
+      USBD_HidInRate.totalIntervalUs += interval;
+      if (interval > USBD_HID_GetPollingInterval(hpcd->pData) * 1500)
+      {
+        USBD_HidInRate.late++;
+      }
+    }
+    USBD_HidInRate.lastCycles = now;
+    USBD_HidInRate.reports++;
+    /* An older SOF means the interrupt was masked for this frame */
+    phase = dwt_CyclesToUs(now - USBD_HidInRate.lastSofCycles);
+    if (phase < 1000)
+    {
+      USBD_HidInRate.totalPhaseUs += phase;
+      USBD_HidInRate.phased++;
+    }
+    
+    /* The class still holds the report until USBD_LL_DataInStage */
+    if ((USBD_HID_GetInFlightTimestamp(hpcd->pData, &stamp) == USBD_OK) && (stamp != 0))
+    {
+      uint32_t age = dwt_CyclesToTimeUs(now) - stamp;
+      
+      if (age > USBD_HidInRate.maxAgeUs)
+      {
+        USBD_HidInRate.maxAgeUs = age;
+      }
+      USBD_HidInRate.totalAgeUs += age;
+      USBD_HidInRate.aged++;
+    }
+  }
   USBD_LL_DataInStage(hpcd->pData, epnum, hpcd->IN_ep[epnum].xfer_buff);
 }
 
+/**
+  * @brief  Restart the HID IN rate, phase and sample age measurement.
+  * @param  None
+  * @retval None
+  */
+void USBD_ResetInRate(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  
+  __disable_irq();
+  USBD_HidInRate.reports = 0;
+  USBD_HidInRate.minIntervalUs = 0xFFFFFFFF;
+  USBD_HidInRate.maxIntervalUs = 0;
+  USBD_HidInRate.totalIntervalUs = 0;
+  USBD_HidInRate.late = 0;
+  USBD_HidInRate.phased = 0;
+  USBD_HidInRate.totalPhaseUs = 0;
+  USBD_HidInRate.aged = 0;
+  USBD_HidInRate.totalAgeUs = 0;
+  USBD_HidInRate.maxAgeUs = 0;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Unmask the SOF interrupt while at least one user needs it.
+  *         A SOF that came while it was masked is discarded, so the
+  *         first one taken is current
+  * @param  user: USBD_SOF_xxx
+  * @param  enable: 1 if this user needs the interrupt, 0 if no longer
+  * @retval None
+  */
+void USBD_SofInterrupt(uint8_t user, uint8_t enable)
+{
+  USB_OTG_GlobalTypeDef *USBx = hpcd_USB_OTG_FS.Instance;
+  uint32_t primask = __get_PRIMASK();
+  
+  __disable_irq();
+  if (enable)
+  {
+    if (USBD_SofUsers == 0)
+    {
+      USBx->GINTSTS = USB_OTG_GINTSTS_SOF;
+      USBx->GINTMSK |= USB_OTG_GINTMSK_SOFM;
+    }
+    USBD_SofUsers |= user;
+  }
+  else
+  {
+    USBD_SofUsers &= ~user;
+    if (USBD_SofUsers == 0)
+    {
+      USBx->GINTMSK &= ~USB_OTG_GINTMSK_SOFM;
+    }
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Return the USBD_SOF_xxx users of the SOF interrupt.
+  * @param  None
+  * @retval USBD_SOF_xxx bits
+  */
+uint8_t USBD_GetSofUsers(void)
+{
+  return USBD_SofUsers;
+}
+
+/**
+  * @brief  Return the number of the current frame, from the last SOF the
+  *         core received whether or not its interrupt was taken.
+  * @param  None
+  * @retval frame number, 0..2047 at full speed
+  */
+uint32_t USBD_GetFrameNumber(void)
+{
+  USB_OTG_GlobalTypeDef *USBx = hpcd_USB_OTG_FS.Instance;
+  
+  return (USBx_DEVICE->DSTS & USB_OTG_DSTS_FNSOF) >> 8;
+}
+
+/**
+  * @brief  Hand out the static class data arena (USBD_malloc).
+  *         Enumeration and re-enumeration never touch the heap.
+  * @param  size: requested size in bytes
+  * @retval pointer to the arena, or NULL if it is too small or in use
+  */
+void *USBD_static_malloc(uint32_t size)
+{
+  if ((size > sizeof(USBD_ClassData)) || USBD_ClassDataUsed)
+  {
+    return NULL;
+  }
+  USBD_ClassDataUsed = 1;
+  return USBD_ClassData;
+}
+
+/**
+  * @brief  Release the static class data arena (USBD_free).
+  * @param  p: pointer from USBD_static_malloc
+  * @retval None
+  */
+void USBD_static_free(void *p)
+{
+  if (p == USBD_ClassData)
+  {
+    USBD_ClassDataUsed = 0;
+  }
+}
+
 /**
   * @brief  SOF callback.
   * @param  hpcd: PCD handle
@@ -151,6 +344,7 @@ void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
   */
 void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
 {
+  USBD_HidInRate.lastSofCycles = dwt_GetCycles();
   USBD_LL_SOF(hpcd->pData);
 }
 
@@ -281,6 +475,7 @@ USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
   hpcd_USB_OTG_FS.Init.dma_enable = DISABLE;
   hpcd_USB_OTG_FS.Init.ep0_mps = DEP0CTL_MPS_64;
   hpcd_USB_OTG_FS.Init.phy_itface = PCD_PHY_EMBEDDED;
+  /* Unmasked on demand by USBD_SofInterrupt */
   hpcd_USB_OTG_FS.Init.Sof_enable = DISABLE;
   hpcd_USB_OTG_FS.Init.low_power_enable = DISABLE;
   //hpcd_USB_OTG_FS.Init.lpm_enable = DISABLE;
@@ -288,9 +483,13 @@ USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
   hpcd_USB_OTG_FS.Init.use_dedicated_ep1 = DISABLE;
   HAL_PCD_Init(&hpcd_USB_OTG_FS);
 
-  HAL_PCD_SetRxFiFo(&hpcd_USB_OTG_FS, 0x80);
-  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 0, 0x40);
-  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 1, 0x80);
+  HAL_PCD_SetRxFiFo(&hpcd_USB_OTG_FS, USBD_FS_RX_FIFO_WORDS);
+  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 0, USBD_FS_TX0_FIFO_WORDS);
+  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 1, USBD_FS_TX1_FIFO_WORDS);
+  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 2, USBD_FS_TX2_FIFO_WORDS);
+  HAL_PCD_SetTxFiFo(&hpcd_USB_OTG_FS, 3, USBD_FS_TX3_FIFO_WORDS);
+  
+  USBD_ResetInRate();
   }
   return USBD_OK;
 }
@@ -57,7 +57,7 @@
   */ 
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES     1
+#define USBD_MAX_NUM_INTERFACES     3
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1
 /*---------- -----------*/
@@ -81,8 +81,11 @@
   */ 
 
  /* Memory management macros */   
-#define USBD_malloc               malloc
-#define USBD_free                 free
+/* Class data comes from a static arena in usbd_conf.c: the class is
+   initialised from the OTG interrupt, where the IAR heap is neither
+   reentrant nor large enough */
+#define USBD_malloc               USBD_static_malloc
+#define USBD_free                 USBD_static_free
 #define USBD_memset               memset
 #define USBD_memcpy               memcpy
 
@@ -129,6 +132,28 @@
 /** @defgroup USBD_CONF_Exported_Types
   * @{
   */ 
+/* Achieved tracker IN report rate, measured when each IN transfer completes
+   (i.e. when the host has collected the report) */
+typedef struct
+{
+  uint32_t reports;          /* IN transfers completed */
+  uint32_t minIntervalUs;    /* shortest gap between completions */
+  uint32_t maxIntervalUs;    /* longest gap between completions */
+  uint32_t totalIntervalUs;  /* sum of gaps, mean = total / (reports - 1) */
+  uint32_t late;             /* gaps longer than 1.5 polling intervals */
+  uint32_t lastCycles;       /* DWT cycle count of the last completion */
+  
+  /* Where in the frame the host collects the report, and how old its
+     newest sample is by then. The phase is only known for completions
+     in a frame whose SOF was taken, see USBD_SofInterrupt */
+  uint32_t lastSofCycles;    /* DWT cycle count of the last SOF */
+  uint32_t phased;           /* completions with a known phase */
+  uint32_t totalPhaseUs;     /* sum of completion times after SOF */
+  uint32_t aged;             /* completions with a timestamped report */
+  uint32_t totalAgeUs;       /* sum of newest sample ages, mean = / aged */
+  uint32_t maxAgeUs;
+}
+USBD_InRateTypeDef;
 /**
   * @}
   */ 
@@ -143,6 +168,13 @@
 /** @defgroup USBD_CONF_Exported_Variables
   * @{
   */ 
+extern USBD_InRateTypeDef USBD_HidInRate;
+
+/* Users of the SOF interrupt. It fires every frame and would wake the
+   CPU from tickless idle every millisecond, so it is only unmasked while
+   one of them needs it */
+#define USBD_SOF_SYNC             0x01    /* tracker report waiting for its frame */
+#define USBD_SOF_TIMING           0x02    /* phase measured in every frame */
 /**
   * @}
   */ 
@@ -150,6 +182,12 @@
 /** @defgroup USBD_CONF_Exported_FunctionsPrototype
   * @{
   */ 
+void USBD_ResetInRate(void);
+void USBD_SofInterrupt(uint8_t user, uint8_t enable);
+uint8_t USBD_GetSofUsers(void);
+uint32_t USBD_GetFrameNumber(void);
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
 /**
   * @}
   */ 
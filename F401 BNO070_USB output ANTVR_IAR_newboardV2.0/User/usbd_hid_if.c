@@ -0,0 +1,78 @@
+/*
+ * HID class application glue. See usbd_hid_if.h.
+ */
+
+#include <string.h>
+#include "usbd_hid_if.h"
+#include "tracker_config.h"
+#include "raw_log.h"
+
+static void USBD_HID_OutEvent_FS(uint8_t *report, uint16_t len);
+static int8_t USBD_HID_FeatureSize_FS(uint8_t id, uint16_t *len, uint8_t *writable);
+static int8_t USBD_HID_GetFeature_FS(uint8_t id, uint8_t *report, uint16_t *len);
+static int8_t USBD_HID_SetFeature_FS(uint8_t id, uint8_t *report, uint16_t len);
+
+USBD_HID_ItfTypeDef USBD_HID_fops_FS = {
+    USBD_HID_OutEvent_FS,
+    USBD_HID_FeatureSize_FS,
+    USBD_HID_GetFeature_FS,
+    USBD_HID_SetFeature_FS,
+#if USBD_RAW_LOG
+    raw_log_sent,
+#endif
+};
+
+BLOCK_POOL_DEF(hidCommandPool, hid_command_t, HID_COMMAND_QUEUE_LEN);
+osMessageQId hidCommandQueue;
+uint32_t hidCommandsDropped;
+
+/* As deep as the pool, so a post never fails for want of queue space */
+osMessageQDef(hidCommand, HID_COMMAND_QUEUE_LEN, hid_command_t *);
+
+void USBD_HID_ItfInit(void)
+{
+    hidCommandQueue = osMessageCreate(osMessageQ(hidCommand), NULL);
+}
+
+/* USB interrupt context */
+static void USBD_HID_OutEvent_FS(uint8_t *report, uint16_t len)
+{
+    hid_command_t *command;
+
+    if (hidCommandQueue == NULL) {
+        hidCommandsDropped++;
+        return;
+    }
+
+    command = block_pool_alloc(&hidCommandPool);
+    if (command == NULL) {
+        hidCommandsDropped++;
+        return;
+    }
+
+    if (len > sizeof(command->data))
+        len = sizeof(command->data);
+    memcpy(command->data, report, len);
+    command->len = len;
+    if (osMessagePut(hidCommandQueue, (uint32_t)command, 0) != osOK) {
+        block_pool_free(&hidCommandPool, command);
+        hidCommandsDropped++;
+    }
+}
+
+/* USB interrupt context. Feature reports only record the request; the
+   sensor thread applies it between hub polls. */
+static int8_t USBD_HID_FeatureSize_FS(uint8_t id, uint16_t *len, uint8_t *writable)
+{
+    return tracker_config_getFeatureSize(id, len, writable);
+}
+
+static int8_t USBD_HID_GetFeature_FS(uint8_t id, uint8_t *report, uint16_t *len)
+{
+    return tracker_config_getFeature(id, report, len);
+}
+
+static int8_t USBD_HID_SetFeature_FS(uint8_t id, uint8_t *report, uint16_t len)
+{
+    return tracker_config_setFeature(id, report, len);
+}
@@ -0,0 +1,43 @@
+/*
+ * HID class application glue: host commands arriving on the config
+ * channel OUT endpoint, and the config channel feature reports (handled
+ * by tracker_config.c).
+ *
+ * The USB interrupt copies each OUT report into a block from
+ * hidCommandPool and posts it to hidCommandQueue; the housekeeping
+ * thread in main.c takes it from there and gives the block back. The
+ * endpoint is re-armed as soon as the copy is made, so a slow command
+ * (a flash write, a hub reset) never holds up the next one or the
+ * streaming endpoints.
+ */
+
+#ifndef USBD_HID_IF_H
+#define USBD_HID_IF_H
+
+#include "cmsis_os.h"
+#include "usbd_hid.h"
+#include "block_pool.h"
+
+/* Commands that can wait for the command thread */
+#define HID_COMMAND_QUEUE_LEN   4
+
+typedef struct {
+    uint8_t data[HID_CONFIG_EPOUT_SIZE];
+    uint16_t len;
+} hid_command_t;
+
+extern USBD_HID_ItfTypeDef USBD_HID_fops_FS;
+
+/* HID_COMMAND_QUEUE_LEN blocks of hid_command_t */
+extern block_pool_t hidCommandPool;
+
+/* hid_command_t pointers, oldest first */
+extern osMessageQId hidCommandQueue;
+
+/* Commands lost because every block was in use */
+extern uint32_t hidCommandsDropped;
+
+/* Creates hidCommandQueue. Call before MX_USB_DEVICE_Init. */
+void USBD_HID_ItfInit(void);
+
+#endif /* USBD_HID_IF_H */
@@ -46,6 +46,7 @@
 
 #include "bno070.h"
 #include "i2c_master_transfer.h"
+#include "dwt.h"
 #include "cmsis_os.h"
 #include <stdio.h>
 #include <stdarg.h>
@@ -138,7 +139,7 @@ static void bno070_GPIO_Init()
 
   /*Configure GPIO pin INTn: D2, Nucleo PA6*/
   GPIO_InitStruct.Pin = BNO_INTN_BIT;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(BNO_INTN_PORT, &GPIO_InitStruct);
   
@@ -150,14 +151,65 @@ static void bno070_GPIO_Init()
   HAL_GPIO_WritePin(BNO_ADR_PORT, BNO_ADR_BIT, 0);
 }
 
+#define I2C_TIMEOUT_MS 1000
+
+/* Given from the INTn EXTI handler, taken by the sensor task */
+static osSemaphoreId intnSemaphore;
+
+/* DWT cycle count at the last INTn falling edge */
+static volatile uint32_t intnCycles;
+
+/* Given when HAL_I2C_Master_Transfer_IT finishes, taken by i2cTransfer */
+static osSemaphoreId i2cSemaphore;
+
 /* Initialize resources for BNO070 */
 void bno070_Init()
 {
+    osSemaphoreDef(BNO_INTN);
+    osSemaphoreDef(BNO_I2C);
+
     bno070_GPIO_Init();
     bno070_I2C1_Init();
+    dwt_Init();
+
+    intnSemaphore = osSemaphoreCreate(osSemaphore(BNO_INTN), 1);
+    i2cSemaphore = osSemaphoreCreate(osSemaphore(BNO_I2C), 1);
+    /* Binary semaphores are created available; take it so the first
+       transfer really waits for its completion */
+    osSemaphoreWait(i2cSemaphore, 0);
+
+    /* EXTI1 gives a semaphore, so it must sit at or below
+       configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY */
+    HAL_NVIC_SetPriority(EXTI1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+}
+
+/* Called from I2C1_EV/ER_IRQHandler when an async transfer ends */
+void HAL_I2C_Master_TransferCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  osSemaphoreRelease(i2cSemaphore);
+}
+
+void HAL_I2C_Master_TransferErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  osSemaphoreRelease(i2cSemaphore);
+}
+
+/* Called from EXTI1_IRQHandler on the falling edge of INTn */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == BNO_INTN_BIT)
+  {
+    intnCycles = dwt_GetCycles();
+    osSemaphoreRelease(intnSemaphore);
+  }
 }
 
 /* Support functions for BNO070-based sensorhub */
+
+/* Define BNO070_DEBUG to get the sensorhub library's diagnostics (HID
+   descriptor dump, retries) on the UART. It slows the boot noticeably. */
+#ifdef BNO070_DEBUG
 static void debugPrintf(const char *format, ...)
 {
   static char buffer[256];
@@ -168,6 +220,7 @@ static void debugPrintf(const char *format, ...)
   printf("%s", buffer);
   va_end(ap);
 }
+#endif
 
 static void logError(const struct sensorhub_s *sh, int err)
 {
@@ -184,7 +237,32 @@ static int i2cTransfer(const struct sensorhub_s *sh,
                        int receiveLength)
 {
  
-  int rc = HAL_I2C_Master_Transfer(&hi2c1, address, (uint8_t *) sendData, sendLength, receiveData, receiveLength, 1000);
+  int rc;
+
+  if (osKernelRunning())
+  {
+    /* Sleep while the transfer runs from the I2C1 interrupts */
+    rc = HAL_I2C_Master_Transfer_IT(&hi2c1, address, (uint8_t *) sendData, sendLength, receiveData, receiveLength);
+    if (rc == HAL_OK)
+    {
+      if (osSemaphoreWait(i2cSemaphore, I2C_TIMEOUT_MS) != osOK)
+      {
+        HAL_I2C_Master_Transfer_Abort(&hi2c1);
+        /* Drop a completion that raced with the abort */
+        osSemaphoreWait(i2cSemaphore, 0);
+        rc = HAL_TIMEOUT;
+      }
+      else if (hi2c1.ErrorCode != HAL_I2C_ERROR_NONE)
+      {
+        rc = HAL_ERROR;
+      }
+    }
+  }
+  else
+  {
+    rc = HAL_I2C_Master_Transfer(&hi2c1, address, (uint8_t *) sendData, sendLength, receiveData, receiveLength, I2C_TIMEOUT_MS);
+  }
+
   if (rc == HAL_OK)
   {
     return SENSORHUB_STATUS_SUCCESS;
@@ -210,31 +288,70 @@ static int gpioGetHOST_INTN(const struct sensorhub_s *sh)
   return HAL_GPIO_ReadPin(BNO_INTN_PORT, BNO_INTN_BIT);
 }
 
+static int waitForHOST_INTN(const struct sensorhub_s *sh, uint32_t timeout)
+{
+  uint32_t start = HAL_GetTick();
+
+  /* The semaphore may hold a stale give from an edge that was already
+     serviced, so the pin level is what decides. */
+  while (HAL_GPIO_ReadPin(BNO_INTN_PORT, BNO_INTN_BIT) != GPIO_PIN_RESET)
+  {
+    uint32_t elapsed = HAL_GetTick() - start;
+    if (timeout != osWaitForever && elapsed >= timeout)
+    {
+      return SENSORHUB_STATUS_NO_REPORT_PENDING;
+    }
+    osSemaphoreWait(intnSemaphore,
+                    (timeout == osWaitForever) ? osWaitForever : timeout - elapsed);
+  }
+
+  return SENSORHUB_STATUS_SUCCESS;
+}
+
+static uint32_t getHOST_INTN_Time(const struct sensorhub_s *sh)
+{
+  return dwt_CyclesToTimeUs(intnCycles);
+}
+
 static void delay(const struct sensorhub_s *sh, int milliseconds)
 {
   osDelay(milliseconds);
 }
 
+static void delayUs(const struct sensorhub_s *sh, uint32_t microseconds)
+{
+  dwt_DelayUs(microseconds);
+}
+
 static uint32_t getTick(const struct sensorhub_s *sh)
 {
     return HAL_GetTick();
 }
 
 static sensorhub_stats_t sensorhubStats;
+static sensorhub_state_t sensorhubState;
 
 // Create sensorhub based on BNO070
 sensorhub_t sensorhub = {
     BNO070_APP_I2C_8BIT_ADDR,
     BNO070_BOOTLOADER_I2C_8BIT_ADDR,
     &sensorhubStats,
+    &sensorhubState,
     i2cTransfer,
     gpioSetRSTN,
     gpioSetBOOTN,
     gpioGetHOST_INTN,
+    waitForHOST_INTN,
+    getHOST_INTN_Time,
     delay,
+    delayUs,
     getTick,
     logError,
+#ifdef BNO070_DEBUG
+    debugPrintf,
+#else
     0, // debugPrintf,
+#endif
     5,                          /* I2C retries */
     NULL                        /* cookie */
 };
@@ -0,0 +1,110 @@
+/*
+ * Cycle counter (DWT CYCCNT) helpers. See dwt.h.
+ */
+
+#include "dwt.h"
+
+/* Cycle count and microsecond time of the last dwt_Tick() */
+static uint32_t baseCycles;
+static uint32_t baseUs;
+
+/* CYCCNT when the SysTick sleep period started, see dwt_SleepEnter() */
+static uint32_t sleepCycles;
+
+/* Enable the cycle counter. Safe to call more than once. */
+void dwt_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/* Busy-wait for the given number of microseconds. Only meant for short
+   settle times; use osDelay for anything near a millisecond. */
+void dwt_DelayUs(uint32_t us)
+{
+  uint32_t start = DWT->CYCCNT;
+  uint32_t cycles = us * (SystemCoreClock / 1000000);
+
+  while (DWT->CYCCNT - start < cycles)
+  {
+  }
+}
+
+uint32_t dwt_CyclesToUs(uint32_t cycles)
+{
+  return cycles / (SystemCoreClock / 1000000);
+}
+
+/* Advance the microsecond timeline by the whole microseconds elapsed
+   since the last call. Leftover cycles carry over to the next call. */
+void dwt_Tick(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t mhz = SystemCoreClock / 1000000;
+  uint32_t us;
+
+  __disable_irq();
+  us = (DWT->CYCCNT - baseCycles) / mhz;
+  baseUs += us;
+  baseCycles += us * mhz;
+  __set_PRIMASK(primask);
+}
+
+/* Convert a cycle count captured within the last wrap (e.g. in an ISR)
+   to the microsecond timeline. Captures slightly older than the last
+   dwt_Tick() are handled by the signed difference. */
+uint32_t dwt_CyclesToTimeUs(uint32_t cycles)
+{
+  uint32_t primask = __get_PRIMASK();
+  int32_t mhz = SystemCoreClock / 1000000;
+  uint32_t us;
+
+  __disable_irq();
+  us = baseUs + (int32_t)(cycles - baseCycles) / mhz;
+  __set_PRIMASK(primask);
+
+  return us;
+}
+
+uint32_t dwt_GetTimeUs(void)
+{
+  return dwt_CyclesToTimeUs(DWT->CYCCNT);
+}
+
+/* SysTick counts (processor clock) since it was last reloaded. Only
+   valid with interrupts masked: a reload then leaves the SysTick
+   exception pending, and it can happen at most once while sleeping. */
+static uint32_t dwt_SysTickElapsed(void)
+{
+  uint32_t load = SysTick->LOAD;
+  uint32_t pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+  uint32_t val = SysTick->VAL;
+
+  if (!pending && (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+  {
+    /* Reloaded between the two reads */
+    pending = 1;
+    val = SysTick->VAL;
+  }
+  return load - val + (pending ? load + 1 : 0);
+}
+
+/* Tickless idle, interrupts masked, just after the port has restarted
+   SysTick for the sleep period */
+void dwt_SleepEnter(void)
+{
+  sleepCycles = DWT->CYCCNT - dwt_SysTickElapsed();
+}
+
+/* Tickless idle, interrupts masked, straight after WFI. Adds whatever
+   CYCCNT missed while the core clock was stopped and returns the
+   cycles slept. */
+uint32_t dwt_SleepExit(void)
+{
+  uint32_t elapsed = dwt_SysTickElapsed();
+  uint32_t counted = DWT->CYCCNT - sleepCycles;
+
+  if (elapsed > counted)
+    DWT->CYCCNT += elapsed - counted;
+  return elapsed;
+}
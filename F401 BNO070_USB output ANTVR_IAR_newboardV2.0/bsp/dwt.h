@@ -0,0 +1,32 @@
+/*
+ * Cycle counter (DWT CYCCNT) helpers for microsecond-scale waits and
+ * timestamps. The counter runs at the core clock and wraps every
+ * 2^32 cycles (about 51 s at 84 MHz); use unsigned differences.
+ *
+ * dwt_Tick() must run at least once per wrap (it is called from
+ * SysTick) to keep the 32-bit microsecond timeline continuous. That
+ * timeline itself wraps every 2^32 us (about 71 minutes).
+ *
+ * The core clock, and with it CYCCNT, may stop in WFI. Tickless idle
+ * brackets its sleep with dwt_SleepEnter() and dwt_SleepExit(), which
+ * move the counter on by the time SysTick measured, so cycle stamps
+ * stay on the same clock across a sleep.
+ */
+
+#ifndef DWT_H
+#define DWT_H
+
+#include "stm32f4xx_hal.h"
+
+void dwt_Init(void);
+void dwt_DelayUs(uint32_t us);
+uint32_t dwt_CyclesToUs(uint32_t cycles);
+void dwt_Tick(void);
+uint32_t dwt_CyclesToTimeUs(uint32_t cycles);
+uint32_t dwt_GetTimeUs(void);
+void dwt_SleepEnter(void);
+uint32_t dwt_SleepExit(void);
+
+#define dwt_GetCycles() (DWT->CYCCNT)
+
+#endif /* DWT_H */
@@ -483,3 +483,327 @@ HAL_StatusTypeDef HAL_I2C_Master_Transfer(I2C_HandleTypeDef *hi2c,
 
   return HAL_OK;
 }
+
+/*
+ * Interrupt-driven version of HAL_I2C_Master_Transfer. The same
+ * START / write / repeated START / read / STOP sequence is run from the
+ * I2C event and error interrupts so the calling task can sleep while the
+ * bus is busy. Only one transfer may be in flight at a time.
+ */
+typedef struct {
+  I2C_HandleTypeDef *hi2c;
+  uint16_t devAddress;
+  uint8_t *txData;
+  uint16_t txCount;
+  uint8_t *rxData;
+  uint16_t rxCount;
+  uint8_t *lenByte;
+  int handledLength;
+  int rxAddressed;
+} I2C_MasterTransfer_t;
+
+static I2C_MasterTransfer_t xfer;
+
+__weak void HAL_I2C_Master_TransferCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+__weak void HAL_I2C_Master_TransferErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+}
+
+static void I2C_MasterTransferDone(I2C_HandleTypeDef *hi2c)
+{
+  __HAL_I2C_DISABLE_IT(hi2c, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR);
+
+  /* Disable Pos */
+  hi2c->Instance->CR1 &= ~I2C_CR1_POS;
+
+  hi2c->State = HAL_I2C_STATE_READY;
+
+  /* Process Unlocked */
+  __HAL_UNLOCK(hi2c);
+
+  if (hi2c->ErrorCode == HAL_I2C_ERROR_NONE)
+    HAL_I2C_Master_TransferCpltCallback(hi2c);
+  else
+    HAL_I2C_Master_TransferErrorCallback(hi2c);
+}
+
+/**
+  * @brief  Starts a combined write/read transfer in interrupt mode.
+  *         Completion is reported through HAL_I2C_Master_TransferCpltCallback
+  *         or HAL_I2C_Master_TransferErrorCallback from interrupt context.
+  * @param  hi2c : Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @param  DevAddress: Target device address
+  * @param  txData: Pointer to data to write, sent first
+  * @param  txSize: Amount of data to write (may be 0)
+  * @param  rxData: Pointer to receive buffer, filled after a repeated start
+  * @param  rxSize: Max amount of data to read (may be 0). As with
+  *                 HAL_I2C_Master_Transfer the read is cut short to the
+  *                 length in the first byte received.
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_I2C_Master_Transfer_IT(I2C_HandleTypeDef *hi2c,
+                                             uint16_t DevAddress,
+                                             uint8_t *txData,
+                                             uint16_t txSize,
+                                             uint8_t *rxData,
+                                             uint16_t rxSize)
+{
+  if(hi2c->State != HAL_I2C_STATE_READY)
+    return HAL_BUSY;
+
+  if (txSize == 0 && rxSize == 0)
+    return HAL_ERROR;
+
+  if(txSize != 0 && txData == NULL)
+    return  HAL_ERROR;
+
+  if(rxSize != 0 && rxData == NULL)
+    return  HAL_ERROR;
+
+  /* The STOP of the previous transfer may still be on the bus */
+  if(I2C_WaitOnFlagUntilTimeout(hi2c, I2C_FLAG_BUSY, SET, 2) != HAL_OK)
+    return HAL_BUSY;
+
+  /* Process Locked */
+  __HAL_LOCK(hi2c);
+
+  xfer.hi2c = hi2c;
+  xfer.devAddress = DevAddress;
+  xfer.txData = txData;
+  xfer.txCount = txSize;
+  xfer.rxData = rxData;
+  xfer.rxCount = rxSize;
+  xfer.lenByte = rxData;
+  xfer.handledLength = 0;
+  xfer.rxAddressed = 0;
+
+  hi2c->State = (txSize > 0) ? HAL_I2C_STATE_BUSY_TX : HAL_I2C_STATE_BUSY_RX;
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+  __HAL_I2C_ENABLE_IT(hi2c, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR);
+
+  /* Enable Acknowledge, Generate Start */
+  hi2c->Instance->CR1 |= I2C_CR1_ACK | I2C_CR1_START;
+
+  return HAL_OK;
+}
+
+/* Address phase of the read: set up ACK/POS the same way the blocking
+   transfer does for 1, 2 and 3+ byte reads */
+static void I2C_MasterTransfer_ADDR(I2C_HandleTypeDef *hi2c)
+{
+  if(hi2c->State == HAL_I2C_STATE_BUSY_TX)
+  {
+    __HAL_I2C_CLEAR_ADDRFLAG(hi2c);
+    return;
+  }
+
+  xfer.rxAddressed = 1;
+
+  if(xfer.rxCount == 1)
+  {
+    hi2c->Instance->CR1 &= ~I2C_CR1_ACK;
+    __HAL_I2C_CLEAR_ADDRFLAG(hi2c);
+    hi2c->Instance->CR1 |= I2C_CR1_STOP;
+  }
+  else if(xfer.rxCount == 2)
+  {
+    hi2c->Instance->CR1 &= ~I2C_CR1_ACK;
+    hi2c->Instance->CR1 |= I2C_CR1_POS;
+    __HAL_I2C_CLEAR_ADDRFLAG(hi2c);
+  }
+  else
+  {
+    hi2c->Instance->CR1 |= I2C_CR1_ACK;
+    __HAL_I2C_CLEAR_ADDRFLAG(hi2c);
+  }
+}
+
+/* Write phase finished (BTF): either turn the bus around with a
+   repeated start or stop if there is nothing to read */
+static void I2C_MasterTransfer_TXDone(I2C_HandleTypeDef *hi2c)
+{
+  if(xfer.rxCount > 0)
+  {
+    hi2c->State = HAL_I2C_STATE_BUSY_RX;
+    __HAL_I2C_ENABLE_IT(hi2c, I2C_IT_BUF);
+    hi2c->Instance->CR1 |= I2C_CR1_ACK | I2C_CR1_START;
+  }
+  else
+  {
+    hi2c->Instance->CR1 |= I2C_CR1_STOP;
+    I2C_MasterTransferDone(hi2c);
+  }
+}
+
+static void I2C_MasterTransfer_RXNE(I2C_HandleTypeDef *hi2c)
+{
+  if(xfer.rxCount > 3)
+  {
+    (*xfer.rxData++) = hi2c->Instance->DR;
+
+    if (!xfer.handledLength)
+    {
+      xfer.handledLength = 1;
+      int specifiedSize = *xfer.lenByte;
+      if (specifiedSize < xfer.rxCount)
+      {
+        xfer.rxCount = specifiedSize;
+        if (xfer.rxCount < 4)
+          xfer.rxCount = 4;
+      }
+    }
+    xfer.rxCount--;
+  }
+  else if(xfer.rxCount == 2 || xfer.rxCount == 3)
+  {
+    /* Finish the last bytes on BTF so NACK/STOP land on time */
+    __HAL_I2C_DISABLE_IT(hi2c, I2C_IT_BUF);
+  }
+  else
+  {
+    (*xfer.rxData++) = hi2c->Instance->DR;
+    xfer.rxCount--;
+    I2C_MasterTransferDone(hi2c);
+  }
+}
+
+static void I2C_MasterTransfer_RXBTF(I2C_HandleTypeDef *hi2c)
+{
+  if(xfer.rxCount == 3)
+  {
+    /* Disable Acknowledge */
+    hi2c->Instance->CR1 &= ~I2C_CR1_ACK;
+
+    (*xfer.rxData++) = hi2c->Instance->DR;
+    xfer.rxCount--;
+  }
+  else
+  {
+    /* Generate Stop */
+    hi2c->Instance->CR1 |= I2C_CR1_STOP;
+
+    (*xfer.rxData++) = hi2c->Instance->DR;
+    xfer.rxCount--;
+    (*xfer.rxData++) = hi2c->Instance->DR;
+    xfer.rxCount--;
+
+    I2C_MasterTransferDone(hi2c);
+  }
+}
+
+/**
+  * @brief  Event interrupt handler for HAL_I2C_Master_Transfer_IT.
+  *         Call from I2Cx_EV_IRQHandler.
+  * @param  hi2c : Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @retval None
+  */
+void HAL_I2C_Master_Transfer_EV_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+  uint32_t sr1 = hi2c->Instance->SR1;
+  uint32_t bufIt = hi2c->Instance->CR2 & I2C_CR2_ITBUFEN;
+
+  if(sr1 & I2C_SR1_SB)
+  {
+    /* Send slave address */
+    if(hi2c->State == HAL_I2C_STATE_BUSY_TX)
+      hi2c->Instance->DR = __HAL_I2C_7BIT_ADD_WRITE(xfer.devAddress);
+    else
+      hi2c->Instance->DR = __HAL_I2C_7BIT_ADD_READ(xfer.devAddress);
+  }
+  else if(sr1 & I2C_SR1_ADDR)
+  {
+    I2C_MasterTransfer_ADDR(hi2c);
+  }
+  else if(hi2c->State == HAL_I2C_STATE_BUSY_TX)
+  {
+    if((sr1 & I2C_SR1_TXE) && bufIt && xfer.txCount > 0)
+    {
+      /* Write data to DR */
+      hi2c->Instance->DR = (*xfer.txData++);
+      xfer.txCount--;
+
+      /* Wait for BTF on the last byte before turning the bus around */
+      if(xfer.txCount == 0)
+        __HAL_I2C_DISABLE_IT(hi2c, I2C_IT_BUF);
+    }
+    else if((sr1 & I2C_SR1_BTF) && xfer.txCount == 0)
+    {
+      I2C_MasterTransfer_TXDone(hi2c);
+    }
+  }
+  else if(hi2c->State == HAL_I2C_STATE_BUSY_RX && xfer.rxAddressed)
+  {
+    /* BTF left over from the write phase is ignored until the
+       repeated start has been addressed */
+    if((sr1 & I2C_SR1_RXNE) && bufIt)
+      I2C_MasterTransfer_RXNE(hi2c);
+    else if(sr1 & I2C_SR1_BTF)
+      I2C_MasterTransfer_RXBTF(hi2c);
+  }
+}
+
+/**
+  * @brief  Error interrupt handler for HAL_I2C_Master_Transfer_IT.
+  *         Call from I2Cx_ER_IRQHandler.
+  * @param  hi2c : Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @retval None
+  */
+void HAL_I2C_Master_Transfer_ER_IRQHandler(I2C_HandleTypeDef *hi2c)
+{
+  uint32_t sr1 = hi2c->Instance->SR1;
+
+  if(sr1 & I2C_SR1_BERR)
+  {
+    hi2c->ErrorCode |= HAL_I2C_ERROR_BERR;
+    __HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_BERR);
+  }
+  if(sr1 & I2C_SR1_ARLO)
+  {
+    hi2c->ErrorCode |= HAL_I2C_ERROR_ARLO;
+    __HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_ARLO);
+  }
+  if(sr1 & I2C_SR1_AF)
+  {
+    hi2c->ErrorCode |= HAL_I2C_ERROR_AF;
+    __HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_AF);
+  }
+  if(sr1 & I2C_SR1_OVR)
+  {
+    hi2c->ErrorCode |= HAL_I2C_ERROR_OVR;
+    __HAL_I2C_CLEAR_FLAG(hi2c, I2C_FLAG_OVR);
+  }
+
+  if(hi2c->ErrorCode != HAL_I2C_ERROR_NONE)
+  {
+    /* Release the bus */
+    hi2c->Instance->CR1 |= I2C_CR1_STOP;
+    I2C_MasterTransferDone(hi2c);
+  }
+}
+
+/**
+  * @brief  Abandons a HAL_I2C_Master_Transfer_IT that did not complete
+  *         in time, e.g. because the slave is holding SCL.
+  * @param  hi2c : Pointer to a I2C_HandleTypeDef structure that contains
+  *                the configuration information for the specified I2C.
+  * @retval None
+  */
+void HAL_I2C_Master_Transfer_Abort(I2C_HandleTypeDef *hi2c)
+{
+  __HAL_I2C_DISABLE_IT(hi2c, I2C_IT_EVT | I2C_IT_BUF | I2C_IT_ERR);
+
+  hi2c->Instance->CR1 |= I2C_CR1_STOP;
+  hi2c->Instance->CR1 &= ~I2C_CR1_POS;
+  hi2c->ErrorCode |= HAL_I2C_ERROR_TIMEOUT;
+  hi2c->State = HAL_I2C_STATE_READY;
+
+  /* Process Unlocked */
+  __HAL_UNLOCK(hi2c);
+}
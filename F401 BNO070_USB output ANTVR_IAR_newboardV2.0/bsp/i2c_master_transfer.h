@@ -11,4 +11,16 @@ HAL_StatusTypeDef HAL_I2C_Master_Transfer(I2C_HandleTypeDef *hi2c,
                                           uint16_t rxSize, 
                                           uint32_t Timeout);
 
+HAL_StatusTypeDef HAL_I2C_Master_Transfer_IT(I2C_HandleTypeDef *hi2c,
+                                             uint16_t DevAddress,
+                                             uint8_t *txData,
+                                             uint16_t txSize,
+                                             uint8_t *rxData,
+                                             uint16_t rxSize);
+void HAL_I2C_Master_Transfer_EV_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_Master_Transfer_ER_IRQHandler(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_Master_Transfer_Abort(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_Master_TransferCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_Master_TransferErrorCallback(I2C_HandleTypeDef *hi2c);
+
 #endif /* I2C_MASTER_TRANSFER_H */
\ No newline at end of file
@@ -44,9 +44,27 @@
 * patent rights of the copyright holder.
 **************************************************************************/
 
+#include <string.h>
 #include "sensorhub.h"
 #include "sensorhub_hid.h"
 #include "i2c_master_transfer.h"
+
+/* Time for the hub to deassert HOST_INTN after a report has been read */
+#ifndef SENSORHUB_INTN_SETTLE_US
+#define SENSORHUB_INTN_SETTLE_US 20
+#endif
+
+/* Upper bound on the hub's boot time after RSTN is released */
+#ifndef SENSORHUB_BOOT_TIMEOUT_MS
+#define SENSORHUB_BOOT_TIMEOUT_MS 1000
+#endif
+
+/* Product ID responses and reset notifications arriving this long
+   after a product ID request or a probe are unsolicited */
+#ifndef SENSORHUB_STALE_RESPONSE_MS
+#define SENSORHUB_STALE_RESPONSE_MS 1000
+#endif
+
 static int checkError(const sensorhub_t * sh, int rc)
 {
     if (rc < 0 && sh->onError)
@@ -81,7 +99,8 @@ int sensorhub_i2cTransferWithRetry(const sensorhub_t * sh,
         sh->stats->i2cRetries++;
         retries++;
         
-        printf("retry %d times\n",retries);
+        if (sh->debugPrintf)
+            sh->debugPrintf("retry %d times\n", retries);
     }
 
     return rc;
@@ -96,21 +115,18 @@ static int sensorhub_i2c_handshake(const sensorhub_t * sh) {
         BNO070_REGISTER_HID_DESCRIPTOR & 0xFF,
         (BNO070_REGISTER_HID_DESCRIPTOR >> 8) & 0xFF
     };
-    union {
-        hid_descriptor_t desc;
-        uint8_t descBuf[sizeof(hid_descriptor_t)];
-    };
+    hid_descriptor_t desc;
 
     // Call I2C directly with no retries.
     rc = sh->i2cTransfer(sh, sh->sensorhubAddress, cmd, sizeof(cmd),
-                                        descBuf, sizeof(descBuf));
-    if (rc < 0) { printf("fail to get HID 1 time\n");
+                                        (uint8_t *)&desc, sizeof(desc));
+    if (rc < 0) {
         return rc;
     }
 
-  //  if (sh->debugPrintf) {
-    //  sh->debugPrintf(
-      printf( "I2C Hid Descriptor:\r\n"
+    /* ~40 ms of blocking UART at 115200, so only when debugging */
+    if (sh->debugPrintf) {
+      sh->debugPrintf( "I2C Hid Descriptor:\r\n"
             "    wHIDDescLength            = %04x\r\n"
             "    bcdVersion                = %04x\r\n"
             "    wReportDescriptorLength   = %04x\r\n"
@@ -138,8 +154,7 @@ static int sensorhub_i2c_handshake(const sensorhub_t * sh) {
             , (unsigned int) desc.wProductID
             , (unsigned int) desc.wVersionID
         );
-    //}
-   //osDelay(500);
+    }
     if (desc.wHIDDescLength != BNO070_DESC_V1_LEN) {
         return checkError(sh, SENSORHUB_STATUS_INVALID_HID_DESCRIPTOR);
     }
@@ -151,11 +166,23 @@ static int sensorhub_i2c_handshake(const sensorhub_t * sh) {
     return SENSORHUB_STATUS_SUCCESS;
 }
 
+/* Wait for the hub to come out of reset. With an INTn interrupt this
+   returns as soon as the hub signals it has booted; otherwise fall
+   back to a fixed wait that covers the hub's worst-case boot time. */
+static void sensorhub_waitForBoot(const sensorhub_t * sh)
+{
+    if (sh->waitForHOST_INTN)
+        sh->waitForHOST_INTN(sh, SENSORHUB_BOOT_TIMEOUT_MS);
+    else
+        sh->delay(sh, 100);
+}
+
 static int sensorhub_probe_internal(const sensorhub_t * sh, bool reset)
 {
     uint8_t data[2];
     int i;
     int rc;
+    uint32_t startTime;
   
     if (reset) {
         bool host_intn_pulled_low;
@@ -165,8 +192,6 @@ static int sensorhub_probe_internal(const sensorhub_t * sh, bool reset)
 
         /* BNO070 BOOTN high (no bootloader mode) */
        sh->setBOOTN(sh, 1);
-        //printf("set boot=1\n");
-        //HAL_GPIO_WritePin(GPIOB, GPIO_PIN_5, 1);
         
         /* Let the BNO sit in reset for a little while */
         sh->delay(sh, 10);
@@ -176,6 +201,10 @@ static int sensorhub_probe_internal(const sensorhub_t * sh, bool reset)
 
         /* Take the BNO070 out of reset */
         sh->setRSTN(sh, 1);
+        sh->stats->bootResetReleased = sh->getTick(sh);
+        sh->stats->bootHubReady = 0;
+        sh->stats->bootDescriptorOk = 0;
+        sh->stats->bootFirstEvent = 0;
 
         if (host_intn_pulled_low) {
             /* If HOST_INTN is pulled low, wait for the BNO to set
@@ -185,27 +214,39 @@ static int sensorhub_probe_internal(const sensorhub_t * sh, bool reset)
              * ready by then and we probably missed the short time
              * that it wasn't.
              */
-          printf("int=0 first time\n");
+            if (sh->debugPrintf)
+                sh->debugPrintf("int=0 first time\n");
             for (i = 0; i < 100; i++) {
                 if (sh->getHOST_INTN(sh))
                     break;
                 sh->delay(sh, 1);
             }
         }
+
+        /* The hub asserts HOST_INTN once it has booted */
+        sensorhub_waitForBoot(sh);
+        sh->stats->bootHubReady = sh->getTick(sh);
     }
-   sh->delay(sh, 100);  //ҪʱҪȻظԶ
-    /* Wait for the BNO070 to boot and check the HID descriptor */
-    for (i = 0; i < 100; i++) {  //ɹظ
+
+    /* Check the HID descriptor, retrying quickly in case the hub is
+       still finishing its boot */
+    startTime = sh->getTick(sh);
+    for (;;) {
         rc = sensorhub_i2c_handshake(sh);
-        if (rc != SENSORHUB_STATUS_ERROR_I2C_IO) break;  //success,򷵻ERROR_I2C
-        sh->delay(sh, 10);      //thjf
+        if (rc != SENSORHUB_STATUS_ERROR_I2C_IO)
+            break;
+        if (sh->getTick(sh) - startTime >= SENSORHUB_BOOT_TIMEOUT_MS)
+            break;
+        sh->delay(sh, 1);
     }
     if (rc < 0) {
         return checkError(sh, rc);
     }
+    sh->stats->bootDescriptorOk = sh->getTick(sh);
 
     if (!sh->getHOST_INTN(sh)) {    //int=0,ͨնͷINT
-      printf("int=0\n");
+        if (sh->debugPrintf)
+            sh->debugPrintf("int=0\n");
         /* Clear the interrupt by reading 2x */
         for (i = 0; i < 2; i++) {       
             int rc =
@@ -229,6 +270,13 @@ static int sensorhub_probe_internal(const sensorhub_t * sh, bool reset)
 }
 
 int sensorhub_probe(const sensorhub_t * sh) {
+  /* The reset below clears every sensor setting on the hub, and the
+     hub answers it with a product ID response of its own */
+  if (sh->state) {
+    memset(sh->state->features, 0, sizeof(sh->state->features));
+    sh->state->resetDetected = false;
+    sh->state->productIdRequestTick = sh->getTick(sh);
+  }
   return sensorhub_probe_internal(sh, true);
 }
 
@@ -266,9 +314,20 @@ static inline void write32(uint8_t * buffer, uint32_t value)
     buffer[3] = (uint8_t) (value >> 24);
 }
 
-int sensorhub_setDynamicFeature(const sensorhub_t * sh,
-                                sensorhub_Sensor_t sensor,
-                                const sensorhub_SensorFeature_t * settings)
+static bool sensorhub_featureEqual(const sensorhub_SensorFeature_t * a,
+                                   const sensorhub_SensorFeature_t * b)
+{
+    return a->changeSensitivityEnabled == b->changeSensitivityEnabled
+        && a->changeSensitivityRelative == b->changeSensitivityRelative
+        && a->wakeupEnabled == b->wakeupEnabled
+        && a->changeSensitivity == b->changeSensitivity
+        && a->reportInterval == b->reportInterval
+        && a->batchInterval == b->batchInterval;
+}
+
+static int sensorhub_writeFeature(const sensorhub_t * sh,
+                                  sensorhub_Sensor_t sensor,
+                                  const sensorhub_SensorFeature_t * settings)
 {
     uint8_t payload[11];
 
@@ -278,12 +337,66 @@ int sensorhub_setDynamicFeature(const sensorhub_t * sh,
     write16(&payload[1], settings->changeSensitivity);
     write32(&payload[3], settings->reportInterval);
     write32(&payload[7], settings->batchInterval);
+    sh->stats->featureWrites++;
     return checkError(sh, shhid_setReport(sh,
                                           HID_REPORT_TYPE_FEATURE,
                                           sensor,
                                           payload, sizeof(payload)));
 }
 
+int sensorhub_setDynamicFeature(const sensorhub_t * sh,
+                                sensorhub_Sensor_t sensor,
+                                const sensorhub_SensorFeature_t * settings)
+{
+    int rc;
+
+    if (sh->state == NULL || sensor >= SENSORHUB_MAX_SENSORS)
+        return sensorhub_writeFeature(sh, sensor, settings);
+
+    if (sh->state->features[sensor].valid
+        && sensorhub_featureEqual(&sh->state->features[sensor].settings,
+                                  settings)) {
+        sh->stats->featureWritesSkipped++;
+        return SENSORHUB_STATUS_SUCCESS;
+    }
+
+    rc = sensorhub_writeFeature(sh, sensor, settings);
+    if (rc == SENSORHUB_STATUS_SUCCESS) {
+        sh->state->features[sensor].valid = true;
+        sh->state->features[sensor].settings = *settings;
+    } else {
+        /* Unknown what the hub ended up with */
+        sh->state->features[sensor].valid = false;
+    }
+    return rc;
+}
+
+/* Bring the hub back after an unexpected reset: handshake again and
+   resend every cached feature setting. Bounded by the probe timeout
+   plus one set feature transfer per enabled sensor. */
+static int sensorhub_recover(const sensorhub_t * sh)
+{
+    uint32_t startTime = sh->getTick(sh);
+    int rc;
+    int i;
+
+    sh->state->resetDetected = false;
+    sh->stats->hubResets++;
+
+    /* The hub follows its reset notification with a product ID
+       response; that one is expected */
+    sh->state->productIdRequestTick = startTime;
+
+    rc = sensorhub_probe_internal(sh, false);
+    for (i = 0; rc == SENSORHUB_STATUS_SUCCESS && i < SENSORHUB_MAX_SENSORS; i++) {
+        if (sh->state->features[i].valid)
+            rc = sensorhub_writeFeature(sh, i, &sh->state->features[i].settings);
+    }
+
+    sh->stats->lastRecoveryMs = sh->getTick(sh) - startTime;
+    return rc;
+}
+
 int sensorhub_getDynamicFeature(const sensorhub_t * sh,
                                 sensorhub_Sensor_t sensor,
                                 sensorhub_SensorFeature_t * settings)
@@ -305,23 +418,100 @@ int sensorhub_getDynamicFeature(const sensorhub_t * sh,
     settings->reportInterval = read32(&payload[3]);
     settings->batchInterval = read32(&payload[7]);
     
-    //printf("%02d\n",settings->changeSensitivityRelative);
-    int p;
-    printf("read feature report\n");
-    for(p=0;p<11;p++)printf("%02x ",payload[p]); printf("\n"); 
+    if (sh->debugPrintf) {
+        int p;
+        sh->debugPrintf("read feature report\n");
+        for (p = 0; p < 11; p++)
+            sh->debugPrintf("%02x ", payload[p]);
+        sh->debugPrintf("\n");
+    }
     return SENSORHUB_STATUS_SUCCESS;
 }
 
+/* How to decode an input report, indexed by report ID. The payload
+   after the 6-byte header is a run of little-endian 16/32-bit fields
+   laid out exactly like the matching member of sensorhub_Event_t.un,
+   so decoding is a bounds check and one copy. Report IDs with no entry
+   are unknown. */
+typedef struct {
+    uint8_t payloadLen;     /* bytes after the header, 0 = not decoded */
+    uint8_t qPoint;         /* Q-point of the 16-bit fields, 0 = integer */
+    uint8_t notAnEvent;     /* response to a host request, not an event */
+} sensorhub_ReportDesc_t;
+
+#define SENSORHUB_REPORT_HEADER_LEN 6
+
+static const sensorhub_ReportDesc_t reportDesc[256] = {
+    /* 1 16-bit integer */
+    [SENSORHUB_HUMIDITY] = {2, 8},
+    [SENSORHUB_PROXIMITY] = {2, 4},
+    [SENSORHUB_TEMPERATURE] = {2, 7},
+    [SENSORHUB_SIGNIFICANT_MOTION] = {2, 0},
+    [SENSORHUB_SHAKE_DETECTOR] = {2, 0},
+    [SENSORHUB_FLIP_DETECTOR] = {2, 0},
+    [SENSORHUB_PICKUP_DETECTOR] = {2, 0},
+    [SENSORHUB_STEP_DETECTOR] = {2, 0},
+    [SENSORHUB_STABILITY_DETECTOR] = {2, 0},
+
+    /* 1 32-bit integer */
+    [SENSORHUB_PRESSURE] = {4, 20},
+    [SENSORHUB_AMBIENT_LIGHT] = {4, 8},
+
+    /* 4 16-bit integers and a 32-bit timestamp */
+    [SENSORHUB_RAW_ACCELEROMETER] = {12, 0},
+    [SENSORHUB_RAW_GYROSCOPE] = {12, 0},
+    [SENSORHUB_RAW_MAGNETOMETER] = {12, 0},
+
+    /* 3 16-bit integers */
+    [SENSORHUB_ACCELEROMETER] = {6, 8},
+    [SENSORHUB_LINEAR_ACCELERATION] = {6, 8},
+    [SENSORHUB_GRAVITY] = {6, 8},
+    [SENSORHUB_GYROSCOPE_CALIBRATED] = {6, 9},
+    [SENSORHUB_MAGNETIC_FIELD_CALIBRATED] = {6, 4},
+
+    /* 4 16-bit integers */
+    [SENSORHUB_GAME_ROTATION_VECTOR] = {8, 14},
+
+    /* 5 16-bit integers (accuracy is Q12) */
+    [SENSORHUB_ROTATION_VECTOR] = {10, 14},
+    [SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR] = {10, 14},
+
+    /* 6 16-bit integers */
+    [SENSORHUB_GYROSCOPE_UNCALIBRATED] = {12, 9},
+    [SENSORHUB_MAGNETIC_FIELD_UNCALIBRATED] = {12, 5},
+
+    /* 32-bit latency, 16-bit steps, 16-bit reserved */
+    [SENSORHUB_STEP_COUNTER] = {8, 0},
+
+    /* 8-bit tap flags */
+    [SENSORHUB_TAP_DETECTOR] = {1, 0},
+
+    /* Stale FRS read or write responses */
+    [SENSORHUB_PRODUCT_ID_RESPONSE] = {0, 0, 1},
+    [SENSORHUB_FRS_READ_RESPONSE] = {0, 0, 1},
+    [SENSORHUB_FRS_WRITE_RESPONSE] = {0, 0, 1},
+
+    /* TBD: SENSORHUB_SAR, SENSORHUB_ACTIVITY_CLASSIFICATION */
+};
+
+int sensorhub_getQPoint(sensorhub_Sensor_t sensor)
+{
+    return reportDesc[sensor & 0xff].qPoint;
+}
+
 static int sensorhub_decodeEvent(const sensorhub_t * sh,
                                  const uint8_t * report,
                                  sensorhub_Event_t * event)
 {
+    const sensorhub_ReportDesc_t *desc;
+
     /* Get the length. Technically, it's 2 bytes, but valid reports won't come
        close to using the 2nd byte */
     int length = report[0];
     if (length > BNO070_MAX_INPUT_REPORT_LEN || report[1] != 0)
     {
-      printf("report too long= %2x\n",length);  
+      if (sh->debugPrintf)
+        sh->debugPrintf("report too long= %2x\n", length);
       return checkError(sh, SENSORHUB_STATUS_REPORT_LEN_TOO_LONG);
     }  
     /* Fill out common fields */
@@ -330,125 +520,42 @@ static int sensorhub_decodeEvent(const sensorhub_t * sh,
     event->status = report[4];
     event->delay = report[5];
 
-    switch (event->sensor) {
-        /* Reports that are 1 16-bit integer */
-    case SENSORHUB_HUMIDITY:
-    case SENSORHUB_PROXIMITY:
-    case SENSORHUB_TEMPERATURE:
-    case SENSORHUB_SIGNIFICANT_MOTION:
-    case SENSORHUB_SHAKE_DETECTOR:
-    case SENSORHUB_FLIP_DETECTOR:
-    case SENSORHUB_PICKUP_DETECTOR:
-    case SENSORHUB_STEP_DETECTOR:
-    case SENSORHUB_STABILITY_DETECTOR:
-        if (length < 8)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field16[0] = read16(&report[6]);
-        break;
-
-        /* Reports that are 1 32-bit integer */
-    case SENSORHUB_PRESSURE:
-    case SENSORHUB_AMBIENT_LIGHT:
-        if (length < 10)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field32[0] = read32(&report[6]);
-        break;
-
-        /* 4 16-bit integers and a 32-bit timestamp */
-    case SENSORHUB_RAW_ACCELEROMETER:
-    case SENSORHUB_RAW_GYROSCOPE:
-    case SENSORHUB_RAW_MAGNETOMETER:
-        if (length < 18)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field16[0] = read16(&report[6]);
-        event->un.field16[1] = read16(&report[8]);
-        event->un.field16[2] = read16(&report[10]);
-        event->un.field16[3] = read16(&report[12]);
-        event->un.field32[2] = read32(&report[14]);
-        break;
+    desc = &reportDesc[event->sensor];
 
-        /* Reports that are 3 16-bit integers */
-    case SENSORHUB_ACCELEROMETER:                                           //length=12
-    case SENSORHUB_LINEAR_ACCELERATION:
-    case SENSORHUB_GRAVITY:
-    case SENSORHUB_GYROSCOPE_CALIBRATED:
-    case SENSORHUB_MAGNETIC_FIELD_CALIBRATED:
-        if (length < 12)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field16[0] = read16(&report[6]);
-        event->un.field16[1] = read16(&report[8]);
-        event->un.field16[2] = read16(&report[10]);
-        break;
-
-        /* Reports that are 4 16-bit integers */
-    case SENSORHUB_GAME_ROTATION_VECTOR:
-        if (length < 16)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field16[0] = read16(&report[6]);
-        event->un.field16[1] = read16(&report[8]);
-        event->un.field16[2] = read16(&report[10]);
-        event->un.field16[3] = read16(&report[12]);
-        break;
-
-        /* Reports that are 5 16-bit integers */
-    case SENSORHUB_ROTATION_VECTOR: 
-    case SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR:
-        if (length < 16)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-        
-        event->un.field16[0] = read16(&report[6]);
-        event->un.field16[1] = read16(&report[8]);
-        event->un.field16[2] = read16(&report[10]);
-        event->un.field16[3] = read16(&report[12]);
-        event->un.field16[4] = read16(&report[14]);
-        break;
+    /* NOTE: Don't run these through checkError, since they are such a
+     *       minor annoyance that we don't want to alert the user. The
+     *       calling code can do more if it wants.
+     */
+    if (desc->notAnEvent)
+        return SENSORHUB_STATUS_NOT_AN_EVENT;
+    if (desc->payloadLen == 0)
+        return SENSORHUB_STATUS_REPORT_UNKNOWN;
 
-        /* Reports that are 6 16-bit integers */
-    case SENSORHUB_GYROSCOPE_UNCALIBRATED:
-    case SENSORHUB_MAGNETIC_FIELD_UNCALIBRATED:
-        if (length < 16)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
-
-        event->un.field16[0] = read16(&report[6]);
-        event->un.field16[1] = read16(&report[8]);
-        event->un.field16[2] = read16(&report[10]);
-        event->un.field16[3] = read16(&report[12]);
-        event->un.field16[4] = read16(&report[14]);
-        event->un.field16[5] = read16(&report[16]);
-        break;
+    if (length < SENSORHUB_REPORT_HEADER_LEN + desc->payloadLen)
+        return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
 
-    case SENSORHUB_STEP_COUNTER:
-        if (length < 14)
-            return checkError(sh, SENSORHUB_STATUS_REPORT_INVALID_LEN);
+    /* Both the report and the union are little-endian */
+    memset(&event->un, 0, sizeof(event->un));
+    memcpy(&event->un, &report[SENSORHUB_REPORT_HEADER_LEN], desc->payloadLen);
 
-        event->un.stepCounter.detectLatency = read32(&report[6]);
-        event->un.stepCounter.steps = read16(&report[10]);
-        event->un.stepCounter.reserved = read16(&report[12]);
-        break;
+    return SENSORHUB_STATUS_SUCCESS;
+}
 
-    case SENSORHUB_PRODUCT_ID_RESPONSE:
-    case SENSORHUB_FRS_READ_RESPONSE:
-    case SENSORHUB_FRS_WRITE_RESPONSE:
-        /* Stale FRS read or write responses */
-        /* NOTE: Don't run these through checkError, since they are such a
-         *       minor annoyance that we don't want to alert the user. The
-         *       calling code can do more if it wants.
-         */
-        return SENSORHUB_STATUS_NOT_AN_EVENT;
+/* The read is a single transaction that stops at the length in the HID
+   header (see HAL_I2C_Master_Transfer), so the bytes actually moved are
+   the header length, floored at the 4 bytes the I2C master needs to
+   NACK and STOP cleanly. A separate header-only read would not help:
+   the hub restarts the report on the next read and it costs another
+   START and address byte. */
+static int sensorhub_inputReportBusLength(const uint8_t * report)
+{
+    int len = report[0] | (report[1] << 8);
 
-        /* TBD */
-    case SENSORHUB_SAR:
-    case SENSORHUB_TAP_DETECTOR:
-    case SENSORHUB_ACTIVITY_CLASSIFICATION:
-    default:
-        return checkError(sh, SENSORHUB_STATUS_REPORT_UNKNOWN);
-    }
-    return SENSORHUB_STATUS_SUCCESS;
+    if (len > BNO070_MAX_INPUT_REPORT_LEN)
+        len = BNO070_MAX_INPUT_REPORT_LEN;
+    if (len < 4)
+        len = 4;
+    return len;
 }
 
 static int sensorhub_pollForReport(const sensorhub_t * sh,
@@ -464,11 +571,76 @@ static int sensorhub_pollForReport(const sensorhub_t * sh,
     }
     rc = sensorhub_i2cTransferWithRetry(sh, sh->sensorhubAddress, NULL, 0, report,
                                         BNO070_MAX_INPUT_REPORT_LEN);
+    if (rc == SENSORHUB_STATUS_SUCCESS) {
+        sh->stats->inputReports++;
+        sh->stats->inputBytes += sensorhub_inputReportBusLength(report);
+    }
     return checkError(sh, rc);
 }
 
-int sensorhub_poll(const sensorhub_t * sh, sensorhub_Event_t * events,
-                   int maxEvents, int *numEvents)
+/* The report delay is an 8-bit significand scaled by 2^exponent us,
+   the exponent being bits 4:2 of the status byte */
+static uint32_t sensorhub_eventDelayUs(const sensorhub_Event_t * event)
+{
+    return (uint32_t)event->delay << ((event->status >> 2) & 0x7);
+}
+
+static void sensorhub_timestampEvent(const sensorhub_t * sh,
+                                     sensorhub_Event_t * event)
+{
+    if (sh->getHOST_INTN_Time)
+        event->timestamp = sh->getHOST_INTN_Time(sh) - sensorhub_eventDelayUs(event);
+    else
+        event->timestamp = 0;
+}
+
+/* Classify the sequence number against the last one seen for the
+   same sensor. Differences are taken mod 256; anything more than half
+   the range behind is treated as reordering rather than a huge gap. */
+static void sensorhub_trackSequence(const sensorhub_t * sh,
+                                    const sensorhub_Event_t * event)
+{
+    sensorhub_SeqStats_t *s;
+    uint8_t diff;
+
+    if (event->sensor >= SENSORHUB_MAX_SENSORS)
+        return;
+
+    s = &sh->stats->seq[event->sensor];
+    s->received++;
+
+    if (!s->valid) {
+        s->valid = 1;
+        s->lastSeq = event->sequenceNumber;
+        return;
+    }
+
+    diff = (uint8_t)(event->sequenceNumber - s->lastSeq);
+    if (diff == 0) {
+        s->duplicates++;
+        return;
+    }
+    if (diff >= 0x80) {
+        s->reordered++;
+        return;
+    }
+    if (diff > 1) {
+        s->gaps++;
+        s->lost += diff - 1;
+    }
+    s->lastSeq = event->sequenceNumber;
+}
+
+/* True unless a probe or product ID request went out recently enough
+   to explain a reset notification or product ID response */
+static bool sensorhub_unsolicited(const sensorhub_t * sh)
+{
+    return sh->getTick(sh) - sh->state->productIdRequestTick
+           > SENSORHUB_STALE_RESPONSE_MS;
+}
+
+static int sensorhub_drain(const sensorhub_t * sh, sensorhub_Event_t * events,
+                           int maxEvents, int *numEvents)
 {
     uint8_t report[BNO070_MAX_INPUT_REPORT_LEN];   //max =18
     int rc;
@@ -482,28 +654,89 @@ int sensorhub_poll(const sensorhub_t * sh, sensorhub_Event_t * events,
         else if (rc != SENSORHUB_STATUS_SUCCESS)
             return checkError(sh, rc);
 
-        /* Null length reports also indicate no more events */
-        if (report[0] == 0)                             //ͷֽڴ
-            return SENSORHUB_STATUS_SUCCESS;           
+        /* Null length reports also indicate no more events. One read
+           while HOST_INTN was asserted, outside a probe, is the HID over
+           I2C reset notification: the hub browned out or its watchdog
+           fired. */
+        if (report[0] == 0 && report[1] == 0) {         //ͷֽڴ
+            if (sh->state && sensorhub_unsolicited(sh))
+                sh->state->resetDetected = true;
+            return SENSORHUB_STATUS_SUCCESS;
+        }
+
+        /* So does a product ID response nobody asked for */
+        if (sh->state && report[2] == SENSORHUB_PRODUCT_ID_RESPONSE
+            && sensorhub_unsolicited(sh))
+            sh->state->resetDetected = true;
 
         /* Decode the event. Ignore reports that aren't events. */
         rc = sensorhub_decodeEvent(sh, report, &events[*numEvents]);  
         if (rc == SENSORHUB_STATUS_NOT_AN_EVENT)
             continue;
+        if (rc == SENSORHUB_STATUS_REPORT_UNKNOWN) {
+            sh->stats->unknownReports++;
+            continue;
+        }
         else if (rc != SENSORHUB_STATUS_SUCCESS)
             return checkError(sh, rc);
 
+        sensorhub_timestampEvent(sh, &events[*numEvents]);
+        if (sh->stats->bootFirstEvent == 0)
+            sh->stats->bootFirstEvent = sh->getTick(sh);
+        sensorhub_trackSequence(sh, &events[*numEvents]);
         (*numEvents)++;
 
-        /* Allow hub time to release host interrupt */
-       //sh->delay(sh, 10);
-        sh->delay(sh, 1);
+        /* Allow hub time to release host interrupt before checking
+           it again, so a queued burst drains in one call */
+        if (sh->delayUs)
+            sh->delayUs(sh, SENSORHUB_INTN_SETTLE_US);
+        else
+            sh->delay(sh, 1);
     } while (*numEvents < maxEvents);                               //5
 
     /* We ran out of places to store events, so return. */
     return SENSORHUB_STATUS_MORE_EVENTS_PENDING;
 }
 
+int sensorhub_poll(const sensorhub_t * sh, sensorhub_Event_t * events,
+                   int maxEvents, int *numEvents)
+{
+    int rc = sensorhub_drain(sh, events, maxEvents, numEvents);
+
+    /* A wakeup's burst can span several calls when the caller's array
+       is smaller than what the hub has queued; it ends once HOST_INTN
+       is released */
+    sh->stats->burstEvents += *numEvents;
+    if (rc != SENSORHUB_STATUS_MORE_EVENTS_PENDING) {
+        if (sh->stats->burstEvents > sh->stats->maxEventsPerWakeup)
+            sh->stats->maxEventsPerWakeup = sh->stats->burstEvents;
+        sh->stats->burstEvents = 0;
+    }
+
+    if (sh->state && sh->state->resetDetected) {
+        int recoverRc = sensorhub_recover(sh);
+        if (recoverRc != SENSORHUB_STATUS_SUCCESS)
+            return checkError(sh, recoverRc);
+    }
+
+    return rc;
+}
+
+/* Sleep until HOST_INTN is asserted if the platform supports it. Returns
+   false once the timeout measured from startTime has expired. */
+static bool sensorhub_idleUntil(const sensorhub_t * sh,
+                                uint32_t startTime, uint32_t timeout)
+{
+    uint32_t elapsed = sh->getTick(sh) - startTime;
+    if (elapsed >= timeout)
+        return false;
+
+    if (sh->waitForHOST_INTN)
+        sh->waitForHOST_INTN(sh, timeout - elapsed);
+
+    return true;
+}
+
 int sensorhub_waitForEvent(const sensorhub_t * sh,
                            sensorhub_Event_t * event, uint32_t timeout)
 {
@@ -514,7 +747,7 @@ int sensorhub_waitForEvent(const sensorhub_t * sh,
         rc = sensorhub_poll(sh, event, 1, &numEvents);
         /* Keep trying even if there are warnings */
     } while (rc >= 0 && numEvents == 0
-             && (sh->getTick(sh) - startTime < timeout));
+             && sensorhub_idleUntil(sh, startTime, timeout));
 
     return rc;
 }
@@ -527,7 +760,7 @@ static int sensorhub_waitForReport(const sensorhub_t * sh,
     do {
         rc = sensorhub_pollForReport(sh, report);
     } while (rc == SENSORHUB_STATUS_NO_REPORT_PENDING
-             && (sh->getTick(sh) - startTime < timeout));
+             && sensorhub_idleUntil(sh, startTime, timeout));
 
     return rc;
 }
@@ -566,7 +799,7 @@ static int sensorhub_sendFRSReadRequest(const sensorhub_t * sh,
     payload[0] = 0;
     write16(&payload[1], offset);
     write16(&payload[3], recordType);
-    write16(&payload[7], length);
+    write16(&payload[5], length);
     return shhid_setReport(sh,
                            HID_REPORT_TYPE_OUTPUT,
                            SENSORHUB_FRS_READ_REQUEST,
@@ -934,6 +1167,8 @@ int sensorhub_getProductID(const sensorhub_t * sh,
                            sensorhub_ProductID_t * pid)
 {
     int rc;
+    if (sh->state)
+        sh->state->productIdRequestTick = sh->getTick(sh);
     rc = sensorhub_sendProductIDRequest(sh);   //retryη
     if (rc != SENSORHUB_STATUS_SUCCESS)
         return checkError(sh, rc);
@@ -178,6 +178,25 @@ enum sensorhub_FRS_e {
 };
 typedef uint16_t sensorhub_FRS_t;
 
+/* Sensor IDs below this have their sequence numbers and feature
+   settings tracked */
+#define SENSORHUB_MAX_SENSORS (0x20)
+
+/**
+ * Per-sensor sequence number accounting. The hub increments the
+ * 8-bit sequence number of each sensor for every sample it produces,
+ * so a jump means samples were lost before reaching the host.
+ */
+typedef struct sensorhub_SeqStats_s {
+    uint32_t received;   /* events decoded for this sensor */
+    uint32_t gaps;       /* times the sequence number skipped ahead */
+    uint32_t lost;       /* samples missing across those gaps */
+    uint32_t reordered;  /* events older than the last one seen */
+    uint32_t duplicates; /* events repeating the last sequence number */
+    uint8_t lastSeq;
+    uint8_t valid;       /* lastSeq holds a real value */
+} sensorhub_SeqStats_t;
+
 /**
  * This structure holds various statistics collected by the Sensor Hub
  * host interface.
@@ -186,6 +205,22 @@ typedef struct sensorhub_stats_s {
     int i2cTransfers;
     int i2cRetries;
     int i2cErrors;
+    int inputReports;    /* input reports read while HOST_INTN was asserted */
+    int inputBytes;      /* bytes clocked on the bus for those reports */
+    int maxEventsPerWakeup; /* largest burst drained per HOST_INTN assertion */
+    int burstEvents;     /* events drained so far in the current burst */
+    int unknownReports;  /* input reports with an ID the decoder doesn't know */
+    int featureWrites;   /* set feature commands sent to the hub */
+    int featureWritesSkipped; /* set feature calls matching the cache */
+    int hubResets;       /* unexpected hub resets recovered from */
+    uint32_t lastRecoveryMs; /* time to re-probe and replay after a reset */
+
+    /* Boot trace, in getTick() milliseconds, from the last probe */
+    uint32_t bootResetReleased; /* RSTN released */
+    uint32_t bootHubReady;      /* hub signalled boot complete on HOST_INTN */
+    uint32_t bootDescriptorOk;  /* HID descriptor read and validated */
+    uint32_t bootFirstEvent;    /* first sensor event decoded */
+    sensorhub_SeqStats_t seq[SENSORHUB_MAX_SENSORS]; /* by sensor ID */
 } sensorhub_stats_t;
 
 /**
@@ -213,6 +248,12 @@ typedef struct sensorhub_s {
      */
     sensorhub_stats_t *stats;
 
+    /**
+     * Point this to a location to store the feature cache. May be
+     * NULL, in which case every setDynamicFeature() call goes to the
+     * hub and hub resets are not recovered automatically.
+     */
+    struct sensorhub_state_s *state;
 
     /**
      * Transfer bytes to or from the BNO070.
@@ -256,6 +297,30 @@ typedef struct sensorhub_s {
      */
     int (*getHOST_INTN) (const struct sensorhub_s * sh);
 
+    /**
+     * Block until HOST_INTN is asserted (low) or the timeout expires.
+     * Platforms with an interrupt on HOST_INTN should sleep here
+     * instead of spinning. Set to NULL to fall back to polling
+     * getHOST_INTN().
+     *
+     * @param sh the sensorhub
+     * @param timeout max number of milliseconds to wait
+     * @return 0 if HOST_INTN is asserted;
+     *         SENSORHUB_STATUS_NO_REPORT_PENDING on timeout
+     */
+    int (*waitForHOST_INTN) (const struct sensorhub_s * sh, uint32_t timeout);
+
+    /**
+     * Return the time of the most recent HOST_INTN assertion in
+     * microseconds, ideally captured in the interrupt handler. Used
+     * to timestamp events. May be NULL, in which case event
+     * timestamps are 0.
+     *
+     * @param sh the sensorhub
+     * @return microsecond timestamp (wraps at 2^32)
+     */
+    uint32_t (*getHOST_INTN_Time) (const struct sensorhub_s * sh);
+
     /**
      * Delay for the specified number of milliseconds
      *
@@ -264,6 +329,16 @@ typedef struct sensorhub_s {
      */
     void (*delay) (const struct sensorhub_s * sh, int milliseconds);
 
+    /**
+     * Busy-wait for the specified number of microseconds. Used to let
+     * the hub release HOST_INTN between back-to-back report reads.
+     * May be NULL, in which case delay() is used for 1 millisecond.
+     *
+     * @param sh the sensorhub
+     * @param microseconds
+     */
+    void (*delayUs) (const struct sensorhub_s * sh, uint32_t microseconds);
+
     /**
      * Return the current number of ticks. Each tick should increment
      * 1 millisecond. This is used for functions that have timeouts.
@@ -423,6 +498,12 @@ typedef struct sensorhub_Event {
      */
     uint8_t delay;
 
+    /* Host time the sample was taken, in microseconds: the HOST_INTN
+     * assertion time less the delay above. 0 if the platform does not
+     * provide getHOST_INTN_Time.
+     */
+    uint32_t timestamp;
+
     /* Event report. Use the structure based on the value of the sensor
      * field. See the SH-1 Reference Manual for reports.
      */
@@ -474,6 +555,24 @@ typedef struct sensorhub_SensorFeature {
     uint32_t batchInterval;
 } sensorhub_SensorFeature_t;
 
+/**
+ * Host-side copy of what has been configured on the hub, so redundant
+ * writes can be skipped and the configuration replayed if the hub
+ * resets behind our back.
+ */
+typedef struct sensorhub_state_s {
+    struct {
+        bool valid;
+        sensorhub_SensorFeature_t settings;
+    } features[SENSORHUB_MAX_SENSORS];   /* by sensor ID */
+
+    /* Set when a reset notification (a zero-length input report) or a
+       product ID response shows up that we didn't ask for; the hub
+       sends both after it resets */
+    bool resetDetected;
+    uint32_t productIdRequestTick; /* last probe or product ID request */
+} sensorhub_state_t;
+
 /**
  * @brief Return values for sensor hub functions
  */
@@ -623,6 +722,14 @@ int sensorhub_getDynamicFeature(const sensorhub_t * sh,
 int sensorhub_poll(const sensorhub_t * sh, sensorhub_Event_t * events,
                    int maxEvents, int *numEvents);
 
+/**
+ * @brief Get the fixed-point format of a sensor's 16-bit event fields
+ * @param sensor which sensor
+ * @return the Q-point (value = field / 2^Q); 0 for integer fields
+ *         and unknown sensors
+ */
+int sensorhub_getQPoint(sensorhub_Sensor_t sensor);
+
 /**
  * This function will wait for an event. It only returns when it either
  * has an event or has encountered an error.
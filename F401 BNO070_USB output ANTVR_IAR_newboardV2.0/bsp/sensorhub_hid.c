@@ -58,7 +58,7 @@ int shhid_setReport(const sensorhub_t * sh,
                     const uint8_t * payload, uint8_t payloadLength)
 {
     uint8_t cmd[32];
-    int ix,p;
+    int ix;
 
     cmd[0] = BNO070_REGISTER_COMMAND;
     cmd[1] = 0;
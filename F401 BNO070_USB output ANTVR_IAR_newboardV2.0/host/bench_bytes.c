@@ -0,0 +1,156 @@
+/*
+ * I2C bytes per sample for ways of reading BNO070 input reports, on the
+ * simulated hub with rotation vector and calibrated gyro at 1 kHz:
+ *
+ *   full       every read clocks BNO070_MAX_INPUT_REPORT_LEN bytes
+ *   exact      one read that stops at the length in the report header,
+ *              floored at 4 bytes (HAL_I2C_Master_Transfer, the
+ *              current path)
+ *   two-phase  a 2-byte header read, then a read of the whole report
+ *   learned    one read of the longest report seen so far, read again
+ *              in full when a longer one turns up
+ *
+ * Both two-read variants need a hub that sends a partly read report
+ * again from the start (sim_hub_t.shortReadKeeps). A hub that drops it,
+ * which is what the probe's 2-byte reads to clear HOST_INTN assume,
+ * can't be read that way at all. Counts include address bytes.
+ *
+ * usage: bench_bytes [interval_us [seconds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_hub.h"
+
+enum {
+    READ_FULL,
+    READ_EXACT,
+    READ_TWO_PHASE,
+    READ_LEARNED
+};
+
+static const char *const readName[] = { "full", "exact", "two-phase", "learned" };
+
+static int readMode;
+static int learnedLen;
+static int (*hubTransfer)(const sensorhub_t *sh, uint8_t address,
+                          const uint8_t *sendData, int sendLength,
+                          uint8_t *receiveData, int receiveLength);
+
+static int reportLen(const uint8_t *report)
+{
+    return report[0] | (report[1] << 8);
+}
+
+static int twoReadTransfer(const sensorhub_t *sh, uint8_t address,
+                           const uint8_t *sendData, int sendLength,
+                           uint8_t *receiveData, int receiveLength)
+{
+    int first, len, rc;
+
+    if (sendLength != 0 || receiveLength < BNO070_MAX_INPUT_REPORT_LEN)
+        return hubTransfer(sh, address, sendData, sendLength,
+                           receiveData, receiveLength);
+
+    first = (readMode == READ_TWO_PHASE) ? 2 : learnedLen;
+    rc = hubTransfer(sh, address, NULL, 0, receiveData, first);
+    if (rc != SENSORHUB_STATUS_SUCCESS)
+        return rc;
+
+    len = reportLen(receiveData);
+    if (len > receiveLength)
+        len = receiveLength;
+    if (len > first) {
+        rc = hubTransfer(sh, address, NULL, 0, receiveData, len);
+        if (len > learnedLen)
+            learnedLen = len;
+    }
+    return rc;
+}
+
+static int run(int mode, uint32_t intervalUs, uint32_t seconds)
+{
+    sim_hub_t hub;
+    sensorhub_t sh;
+    sensorhub_stats_t stats;
+    sensorhub_state_t state;
+    sensorhub_SensorFeature_t feature;
+    sensorhub_Event_t events[5];
+    uint64_t start, end;
+    uint32_t total = 0;
+    int numEvents;
+    int rc;
+
+    sim_hub_init(&hub);
+    memset(&stats, 0, sizeof(stats));
+    memset(&state, 0, sizeof(state));
+    sim_hub_bind(&hub, &sh, &stats, &state, 1);
+
+    rc = sensorhub_probe(&sh);
+    if (rc != SENSORHUB_STATUS_SUCCESS) {
+        printf("%s: probe failed %d\n", readName[mode], rc);
+        return 1;
+    }
+    sim_hub_idle(&hub, 5000000);
+    sensorhub_flushEvents(&sh);
+
+    memset(&feature, 0, sizeof(feature));
+    feature.reportInterval = intervalUs;
+    sensorhub_setDynamicFeature(&sh, SENSORHUB_ROTATION_VECTOR, &feature);
+    sensorhub_setDynamicFeature(&sh, SENSORHUB_GYROSCOPE_CALIBRATED, &feature);
+
+    readMode = mode;
+    hub.exactReads = (mode == READ_EXACT);
+    if (mode == READ_TWO_PHASE || mode == READ_LEARNED) {
+        hub.shortReadKeeps = 1;
+        learnedLen = 4;
+        hubTransfer = sh.i2cTransfer;
+        sh.i2cTransfer = twoReadTransfer;
+    }
+
+    memset(&hub.stats, 0, sizeof(hub.stats));
+    memset(&stats, 0, sizeof(stats));
+    start = hub.nowNs;
+    end = start + seconds * 1000000000ull;
+    while (hub.nowNs < end) {
+        if (sh.waitForHOST_INTN(&sh, 100) != SENSORHUB_STATUS_SUCCESS)
+            continue;
+        sensorhub_poll(&sh, events, 5, &numEvents);
+        total += numEvents;
+    }
+
+    printf("%-10s %7u %9u %9.2f %9.1f %8.1f%%",
+           readName[mode], (unsigned)total, hub.stats.transfers,
+           (double)hub.stats.busBytes / total,
+           hub.stats.busNs / 1e3 / total,
+           100.0 * hub.stats.busNs / (hub.nowNs - start));
+    if (total != hub.stats.reportsRead || hub.stats.reportsLost != 0)
+        printf("  (%u reports read, %u lost)", hub.stats.reportsRead,
+               hub.stats.reportsLost);
+    printf("\n");
+
+    /* The target-side count is the same bytes without the address */
+    if (mode == READ_EXACT && (uint64_t)stats.inputBytes
+        != hub.stats.busBytes - hub.stats.transfers) {
+        printf("inputBytes %d disagrees with the bus\n", stats.inputBytes);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t intervalUs = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000;
+    uint32_t seconds = argc > 2 ? strtoul(argv[2], NULL, 0) : 2;
+    int failed = 0;
+    int mode;
+
+    printf("rotation vector + gyro every %u us, %u s simulated, I2C 400 kHz\n",
+           (unsigned)intervalUs, (unsigned)seconds);
+    printf("%-10s %7s %9s %9s %9s %9s\n", "read", "samples", "transfers",
+           "bytes/smp", "us/smp", "bus busy");
+    for (mode = READ_FULL; mode <= READ_LEARNED; mode++)
+        failed |= run(mode, intervalUs, seconds);
+    return failed;
+}
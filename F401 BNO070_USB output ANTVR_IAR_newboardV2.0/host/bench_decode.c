@@ -0,0 +1,100 @@
+/*
+ * Cost per report of the table-driven decoder in bsp/sensorhub.c,
+ * built into this file to reach the static sensorhub_decodeEvent().
+ *
+ * Host figures: timestamp counter ticks on x86 (which run at a fixed
+ * rate, not the core clock) and nanoseconds everywhere. They compare
+ * report types and decoder changes with each other; they are not
+ * Cortex-M4 cycles, for which time the same loop with the DWT counter
+ * (dwt_GetCycles) on the board.
+ *
+ * usage: bench_decode [reports]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "sensorhub.c"
+
+static volatile uint32_t sink;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void bench(const char *name, uint8_t id, uint16_t length,
+                  uint32_t reports)
+{
+    uint8_t report[64][BNO070_MAX_INPUT_REPORT_LEN];
+    sensorhub_stats_t stats;
+    sensorhub_t sh;
+    sensorhub_Event_t event;
+    uint64_t ns;
+#ifdef HAVE_TSC
+    uint64_t ticks;
+#endif
+    uint32_t i, sum = 0;
+    int k;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&sh, 0, sizeof(sh));
+    sh.stats = &stats;
+
+    /* A few different reports so the loop isn't one cached value */
+    for (i = 0; i < 64; i++) {
+        for (k = 0; k < BNO070_MAX_INPUT_REPORT_LEN; k++)
+            report[i][k] = (uint8_t)(i * 31 + k * 7);
+        report[i][0] = (uint8_t)length;
+        report[i][1] = (uint8_t)(length >> 8);
+        report[i][2] = id;
+        report[i][3] = (uint8_t)i;
+    }
+
+    ns = nowNs();
+#ifdef HAVE_TSC
+    ticks = __rdtsc();
+#endif
+    for (i = 0; i < reports; i++) {
+        int rc = sensorhub_decodeEvent(&sh, report[i & 63], &event);
+
+        sum += rc + event.un.field16[0] + event.sequenceNumber;
+    }
+#ifdef HAVE_TSC
+    ticks = __rdtsc() - ticks;
+#endif
+    ns = nowNs() - ns;
+    sink = sum;
+
+#ifdef HAVE_TSC
+    printf("%-24s %8.2f %8.2f\n", name, (double)ns / reports,
+           (double)ticks / reports);
+#else
+    printf("%-24s %8.2f %8s\n", name, (double)ns / reports, "-");
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t reports = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000000;
+
+    printf("%u reports each\n", (unsigned)reports);
+    printf("%-24s %8s %8s\n", "report", "ns", "tsc");
+    bench("rotation vector", SENSORHUB_ROTATION_VECTOR, 16, reports);
+    bench("game rotation vector", SENSORHUB_GAME_ROTATION_VECTOR, 14, reports);
+    bench("gyroscope calibrated", SENSORHUB_GYROSCOPE_CALIBRATED, 12, reports);
+    bench("raw accelerometer", SENSORHUB_RAW_ACCELEROMETER, 18, reports);
+    bench("tap detector", SENSORHUB_TAP_DETECTOR, 7, reports);
+    bench("unknown ID", SENSORHUB_ACTIVITY_CLASSIFICATION, 16, reports);
+    bench("product ID response", SENSORHUB_PRODUCT_ID_RESPONSE, 18, reports);
+    bench("short rotation vector", SENSORHUB_ROTATION_VECTOR, 12, reports);
+    bench("length too long", SENSORHUB_ROTATION_VECTOR, 19, reports);
+    return 0;
+}
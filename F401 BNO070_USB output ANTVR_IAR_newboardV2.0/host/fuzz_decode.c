@@ -0,0 +1,256 @@
+/*
+ * Fuzz test for the input report decoder in bsp/sensorhub.c, built
+ * into this file so the static sensorhub_decodeEvent() and reportDesc[]
+ * can be called directly.
+ *
+ * Two passes, both from a fixed seed so a failure repeats:
+ *
+ *   decoder   random reports with lengths around every boundary go
+ *             through sensorhub_decodeEvent() with a stub sensorhub_t;
+ *             the status, the onError calls and the decoded union are
+ *             checked against reportDesc[]. Each report sits at the end
+ *             of its own allocation, so with SANITIZE=1 a read past the
+ *             18 bytes the bus can deliver is caught.
+ *   stream    malformed reports mixed with real ones are queued on the
+ *             simulated hub and drained with sensorhub_poll(), which
+ *             must keep going, return only well-formed events and
+ *             leave the hub's FIFO empty.
+ *
+ * usage: fuzz_decode [iterations [seed]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sensorhub.c"
+#include "sim_hub.h"
+
+static int failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            if (++failures > 20) \
+                exit(1); \
+        } \
+    } while (0)
+
+static uint32_t rngState;
+
+static uint32_t rng(void)
+{
+    /* xorshift32 */
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static int lastError;
+static int errorCount;
+
+static void countError(const sensorhub_t *sh, int err)
+{
+    (void)sh;
+    lastError = err;
+    errorCount++;
+}
+
+/* IDs worth hitting often: every decoded sensor and every response */
+static uint8_t pickId(void)
+{
+    static const uint8_t ids[] = {
+        SENSORHUB_ROTATION_VECTOR, SENSORHUB_GAME_ROTATION_VECTOR,
+        SENSORHUB_GYROSCOPE_CALIBRATED, SENSORHUB_ACCELEROMETER,
+        SENSORHUB_RAW_GYROSCOPE, SENSORHUB_TAP_DETECTOR,
+        SENSORHUB_STEP_COUNTER, SENSORHUB_PRESSURE, SENSORHUB_HUMIDITY,
+        SENSORHUB_ACTIVITY_CLASSIFICATION, SENSORHUB_SAR,
+        SENSORHUB_PRODUCT_ID_RESPONSE, SENSORHUB_FRS_READ_RESPONSE
+    };
+
+    if (rng() % 4 == 0)
+        return (uint8_t)rng();
+    return ids[rng() % sizeof(ids)];
+}
+
+/* Lengths cluster at the edges: 0, header, header + payload, the
+   18-byte maximum, and just past each */
+static uint16_t pickLength(uint8_t id)
+{
+    int payloadLen = reportDesc[id].payloadLen;
+
+    switch (rng() % 8) {
+    case 0:
+        return (uint16_t)rng();
+    case 1:
+        return (uint16_t)(rng() % 0x100);
+    case 2:
+        return (uint16_t)(SENSORHUB_REPORT_HEADER_LEN + rng() % 3);
+    case 3:
+        return (uint16_t)(BNO070_MAX_INPUT_REPORT_LEN - 1 + rng() % 3);
+    case 4:
+        return (uint16_t)(0x100 + rng() % 20);
+    default:
+        return (uint16_t)(SENSORHUB_REPORT_HEADER_LEN + payloadLen
+                          - 1 + rng() % 3);
+    }
+}
+
+static void fuzzDecoder(uint32_t iterations)
+{
+    sensorhub_stats_t stats;
+    sensorhub_t sh;
+    sensorhub_Event_t event;
+    uint32_t i;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&sh, 0, sizeof(sh));
+    sh.stats = &stats;
+    sh.onError = countError;
+
+    for (i = 0; i < iterations; i++) {
+        uint8_t *report = malloc(BNO070_MAX_INPUT_REPORT_LEN);
+        const sensorhub_ReportDesc_t *desc;
+        uint16_t length;
+        int expect, rc, k;
+
+        for (k = 0; k < BNO070_MAX_INPUT_REPORT_LEN; k++)
+            report[k] = (uint8_t)rng();
+        report[2] = pickId();
+        length = pickLength(report[2]);
+        report[0] = (uint8_t)length;
+        report[1] = (uint8_t)(length >> 8);
+        desc = &reportDesc[report[2]];
+
+        if (length > BNO070_MAX_INPUT_REPORT_LEN)
+            expect = SENSORHUB_STATUS_REPORT_LEN_TOO_LONG;
+        else if (desc->notAnEvent)
+            expect = SENSORHUB_STATUS_NOT_AN_EVENT;
+        else if (desc->payloadLen == 0)
+            expect = SENSORHUB_STATUS_REPORT_UNKNOWN;
+        else if (length < SENSORHUB_REPORT_HEADER_LEN + desc->payloadLen)
+            expect = SENSORHUB_STATUS_REPORT_INVALID_LEN;
+        else
+            expect = SENSORHUB_STATUS_SUCCESS;
+
+        memset(&event, 0xa5, sizeof(event));
+        errorCount = 0;
+        rc = sensorhub_decodeEvent(&sh, report, &event);
+        CHECK(rc == expect);
+
+        /* Only malformed lengths are errors worth reporting */
+        if (expect == SENSORHUB_STATUS_REPORT_LEN_TOO_LONG
+            || expect == SENSORHUB_STATUS_REPORT_INVALID_LEN)
+            CHECK(errorCount == 1 && lastError == expect);
+        else
+            CHECK(errorCount == 0);
+
+        if (rc == SENSORHUB_STATUS_SUCCESS) {
+            const uint8_t *un = (const uint8_t *)&event.un;
+
+            CHECK(event.sensor == report[2]);
+            CHECK(event.sequenceNumber == report[3]);
+            CHECK(event.status == report[4]);
+            CHECK(event.delay == report[5]);
+            CHECK(memcmp(un, &report[SENSORHUB_REPORT_HEADER_LEN],
+                         desc->payloadLen) == 0);
+            for (k = desc->payloadLen; k < (int)sizeof(event.un); k++)
+                CHECK(un[k] == 0);
+        }
+        free(report);
+    }
+}
+
+/* Spot checks of the table against the SH-1 report sizes, so a wrong
+   entry isn't just copied into the expectations above */
+static void checkTable(void)
+{
+    int id;
+
+    CHECK(reportDesc[SENSORHUB_ROTATION_VECTOR].payloadLen == 10);
+    CHECK(reportDesc[SENSORHUB_GAME_ROTATION_VECTOR].payloadLen == 8);
+    CHECK(reportDesc[SENSORHUB_GYROSCOPE_CALIBRATED].payloadLen == 6);
+    CHECK(reportDesc[SENSORHUB_RAW_ACCELEROMETER].payloadLen == 12);
+    CHECK(reportDesc[SENSORHUB_TAP_DETECTOR].payloadLen == 1);
+    CHECK(reportDesc[SENSORHUB_ACTIVITY_CLASSIFICATION].payloadLen == 0);
+
+    for (id = 0; id < 256; id++) {
+        /* Every decoded report fits the bus and the union */
+        CHECK(SENSORHUB_REPORT_HEADER_LEN + reportDesc[id].payloadLen
+              <= BNO070_MAX_INPUT_REPORT_LEN);
+        CHECK(reportDesc[id].payloadLen <= sizeof(((sensorhub_Event_t *)0)->un));
+    }
+    for (id = 1; id < SENSORHUB_MAX_SENSORS; id++) {
+        if (reportDesc[id].payloadLen != 0)
+            CHECK(sim_hub_payloadLen((uint8_t)id) == reportDesc[id].payloadLen);
+    }
+}
+
+static void fuzzStream(uint32_t iterations)
+{
+    sim_hub_t hub;
+    sensorhub_t sh;
+    sensorhub_stats_t stats;
+    sensorhub_state_t state;
+    sensorhub_SensorFeature_t feature;
+    sensorhub_Event_t events[5];
+    uint32_t i, total = 0;
+    int numEvents, rc, k;
+
+    sim_hub_init(&hub);
+    memset(&stats, 0, sizeof(stats));
+    memset(&state, 0, sizeof(state));
+    sim_hub_bind(&hub, &sh, &stats, &state, 1);
+    CHECK(sensorhub_probe(&sh) == SENSORHUB_STATUS_SUCCESS);
+
+    memset(&feature, 0, sizeof(feature));
+    feature.reportInterval = 2000;
+    sensorhub_setDynamicFeature(&sh, SENSORHUB_ROTATION_VECTOR, &feature);
+
+    for (i = 0; i < iterations; i++) {
+        uint8_t report[BNO070_MAX_INPUT_REPORT_LEN];
+        uint16_t length;
+
+        for (k = 0; k < BNO070_MAX_INPUT_REPORT_LEN; k++)
+            report[k] = (uint8_t)rng();
+        report[2] = pickId();
+        length = pickLength(report[2]);
+        report[0] = (uint8_t)length;
+        report[1] = (uint8_t)(length >> 8);
+        sim_hub_inject(&hub, report, 1 + rng() % BNO070_MAX_INPUT_REPORT_LEN);
+
+        /* Drain until the hub has nothing left */
+        for (k = 0; k < 100 && !sh.getHOST_INTN(&sh); k++) {
+            rc = sensorhub_poll(&sh, events, 5, &numEvents);
+            CHECK(numEvents >= 0 && numEvents <= 5);
+            while (numEvents-- > 0) {
+                const sensorhub_Event_t *e = &events[numEvents];
+
+                CHECK(reportDesc[e->sensor].payloadLen != 0);
+                CHECK(!reportDesc[e->sensor].notAnEvent);
+                total++;
+            }
+            (void)rc;
+        }
+        CHECK(k < 100);
+        sim_hub_idle(&hub, rng() % 3000000);
+    }
+    CHECK(hub.stats.reportsLost == 0);
+    CHECK(total > 0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+
+    rngState = argc > 2 ? strtoul(argv[2], NULL, 0) : 0x8070u;
+    if (rngState == 0)
+        rngState = 1;
+
+    checkTable();
+    fuzzDecoder(iterations);
+    fuzzStream(iterations / 20);
+
+    printf("fuzz_decode: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
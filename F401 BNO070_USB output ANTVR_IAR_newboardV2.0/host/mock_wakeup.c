@@ -0,0 +1,117 @@
+/*
+ * Wakeup-to-read latency of the ways the sensor task has waited for the
+ * BNO070, run against the simulated hub:
+ *
+ *   interrupt  waitForHOST_INTN() sleeps until the INTn edge (EXTI1 and
+ *              a semaphore on the board), then sensorhub_poll(), as
+ *              StartThread does now
+ *   spin       the old loop, sensorhub_poll() until it returns events,
+ *              with blocking I2C transfers
+ *   tick       sensorhub_poll(), then osDelay(1) when there was nothing
+ *
+ * Rotation vector and calibrated gyro are enabled at the same interval.
+ * The hub's clock is not SysTick's, so the default interval is not a
+ * whole number of ticks and its edges walk across the tick.
+ *
+ * usage: mock_wakeup [interval_us [seconds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_hub.h"
+
+enum {
+    MODE_INTERRUPT,
+    MODE_SPIN,
+    MODE_TICK
+};
+
+static const char *const modeName[] = { "interrupt", "spin", "tick" };
+
+static int run(int mode, uint32_t intervalUs, uint32_t seconds)
+{
+    sim_hub_t hub;
+    sensorhub_t sh;
+    sensorhub_stats_t stats;
+    sensorhub_state_t state;
+    sensorhub_SensorFeature_t feature;
+    sensorhub_Event_t events[5];
+    uint64_t start, busyStart, end;
+    uint32_t total = 0;
+    int numEvents;
+    int rc;
+
+    sim_hub_init(&hub);
+    hub.i2cSleeps = (mode == MODE_INTERRUPT);
+    memset(&stats, 0, sizeof(stats));
+    memset(&state, 0, sizeof(state));
+    sim_hub_bind(&hub, &sh, &stats, &state, mode == MODE_INTERRUPT);
+
+    rc = sensorhub_probe(&sh);
+    if (rc != SENSORHUB_STATUS_SUCCESS) {
+        printf("%s: probe failed %d\n", modeName[mode], rc);
+        return 1;
+    }
+    /* Let the boot product ID response go before measuring */
+    sim_hub_idle(&hub, 5000000);
+    sensorhub_flushEvents(&sh);
+
+    memset(&feature, 0, sizeof(feature));
+    feature.reportInterval = intervalUs;
+    sensorhub_setDynamicFeature(&sh, SENSORHUB_ROTATION_VECTOR, &feature);
+    sensorhub_setDynamicFeature(&sh, SENSORHUB_GYROSCOPE_CALIBRATED, &feature);
+
+    memset(&hub.stats, 0, sizeof(hub.stats));
+    start = hub.nowNs;
+    busyStart = sim_hub_busyNs(&hub);
+    end = start + seconds * 1000000000ull;
+
+    while (hub.nowNs < end) {
+        numEvents = 0;
+        switch (mode) {
+        case MODE_INTERRUPT:
+            if (sh.waitForHOST_INTN(&sh, 100) != SENSORHUB_STATUS_SUCCESS)
+                continue;
+            sensorhub_poll(&sh, events, 5, &numEvents);
+            break;
+        case MODE_SPIN:
+            while (numEvents == 0 && hub.nowNs < end)
+                sensorhub_poll(&sh, events, 5, &numEvents);
+            break;
+        case MODE_TICK:
+            sensorhub_poll(&sh, events, 5, &numEvents);
+            if (numEvents == 0)
+                sh.delay(&sh, 1);
+            break;
+        }
+        total += numEvents;
+    }
+
+    printf("%-10s %7u %9.1f %9.1f %9.1f %9.1f %8.1f%%\n", modeName[mode],
+           (unsigned)total,
+           hub.stats.wakeups ? hub.stats.wakeSumNs / 1e3 / hub.stats.wakeups : 0.0,
+           hub.stats.wakeMaxNs / 1e3,
+           hub.stats.reportsRead ? hub.stats.ageSumNs / 1e3 / hub.stats.reportsRead : 0.0,
+           hub.stats.ageMaxNs / 1e3,
+           100.0 * (sim_hub_busyNs(&hub) - busyStart) / (hub.nowNs - start));
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t intervalUs = argc > 1 ? strtoul(argv[1], NULL, 0) : 2497;
+    uint32_t seconds = argc > 2 ? strtoul(argv[2], NULL, 0) : 2;
+    int failed = 0;
+    int mode;
+
+    printf("rotation vector + gyro every %u us, %u s simulated\n",
+           (unsigned)intervalUs, (unsigned)seconds);
+    printf("%-10s %7s %19s %19s %9s\n", "", "", "INTn to read (us)",
+           "report age (us)", "");
+    printf("%-10s %7s %9s %9s %9s %9s %9s\n", "wait", "events", "mean", "max",
+           "mean", "max", "cpu busy");
+    for (mode = MODE_INTERRUPT; mode <= MODE_TICK; mode++)
+        failed |= run(mode, intervalUs, seconds);
+    return failed;
+}
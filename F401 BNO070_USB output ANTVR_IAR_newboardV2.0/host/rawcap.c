@@ -0,0 +1,210 @@
+/*
+ * Captures the raw sensor log (User/raw_log.h) of a lab build: bulk
+ * reads from endpoint 0x82 on interface 1 through libusb, split into
+ * records with raw_log_parse() and appended to a binary log.
+ *
+ * usage: rawcap [-d vid:pid] [-t seconds] log.bin
+ *        rawcap -r log.bin
+ *
+ * The log holds the well-formed records exactly as they came off the
+ * wire, so raw_log_parse() reads it back; -r does that and prints the
+ * same summary as a capture. Bytes skipped to resynchronise are left
+ * out of the log and counted. Capture stops after -t seconds or on
+ * Ctrl-C.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libusb.h>
+#define RAW_LOG_HOST
+#include "raw_log.h"
+
+#define RAWCAP_VID          0x0483      /* USBD_VID */
+#define RAWCAP_PID          0x1111      /* USBD_PID_FS */
+#define RAWCAP_INTERFACE    1
+#define RAWCAP_EP           0x82
+#define RAWCAP_TIMEOUT_MS   200
+#define RAWCAP_READ         4096        /* a multiple of the packet size */
+
+typedef struct {
+    uint64_t bytes;             /* received */
+    uint64_t records;
+    uint64_t skipped;           /* bytes dropped to find a record */
+    uint64_t dropped;           /* sum of the records' dropped counts */
+    uint64_t seqGaps;           /* hub seq jumps, per sensor */
+    uint32_t perSensor[256];
+    uint8_t lastSeq[256];
+} rawcap_stats_t;
+
+static volatile sig_atomic_t stop;
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/* Parses buf[0..size), writes whole records to out and returns the
+   number of bytes consumed; the rest starts a record still arriving */
+static int consume(rawcap_stats_t *st, const uint8_t *buf, int size, FILE *out)
+{
+    raw_log_record_t rec;
+    int used = 0, n;
+
+    while ((n = raw_log_parse(buf + used, size - used, &rec)) > 0) {
+        if (rec.payload == NULL) {
+            st->skipped += n;
+        } else {
+            if (st->perSensor[rec.sensor]
+                && rec.seq != (uint8_t)(st->lastSeq[rec.sensor] + 1))
+                st->seqGaps++;
+            st->lastSeq[rec.sensor] = rec.seq;
+            st->perSensor[rec.sensor]++;
+            st->records++;
+            st->dropped += rec.dropped;
+            if (out && fwrite(buf + used, 1, n, out) != (size_t)n) {
+                perror("write");
+                exit(1);
+            }
+        }
+        used += n;
+    }
+    return used;
+}
+
+static void summary(const rawcap_stats_t *st)
+{
+    int i;
+
+    printf("%llu bytes, %llu records, %llu bytes skipped, "
+           "%llu records dropped in the device, %llu seq gaps\n",
+           (unsigned long long)st->bytes, (unsigned long long)st->records,
+           (unsigned long long)st->skipped, (unsigned long long)st->dropped,
+           (unsigned long long)st->seqGaps);
+    for (i = 0; i < 256; i++) {
+        if (st->perSensor[i])
+            printf("  sensor 0x%02x  %u\n", i, (unsigned)st->perSensor[i]);
+    }
+}
+
+static int replay(const char *path)
+{
+    static rawcap_stats_t st;
+    uint8_t buf[RAWCAP_READ + RAW_LOG_MAX_RECORD];
+    int have = 0, used;
+    size_t n;
+    FILE *in = fopen(path, "rb");
+
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    while ((n = fread(buf + have, 1, sizeof(buf) - have, in)) > 0) {
+        st.bytes += n;
+        have += (int)n;
+        used = consume(&st, buf, have, NULL);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+    fclose(in);
+    st.skipped += have;         /* a truncated last record */
+    summary(&st);
+    return 0;
+}
+
+static int capture(uint16_t vid, uint16_t pid, int seconds, const char *path)
+{
+    static rawcap_stats_t st;
+    uint8_t buf[RAWCAP_READ + RAW_LOG_MAX_RECORD];
+    libusb_device_handle *dev;
+    FILE *out;
+    time_t end = seconds ? time(NULL) + seconds : 0;
+    int have = 0, used, got, rc;
+
+    rc = libusb_init(NULL);
+    if (rc < 0) {
+        fprintf(stderr, "libusb_init: %s\n", libusb_strerror(rc));
+        return 1;
+    }
+    dev = libusb_open_device_with_vid_pid(NULL, vid, pid);
+    if (!dev) {
+        fprintf(stderr, "no device %04x:%04x (or no permission)\n", vid, pid);
+        libusb_exit(NULL);
+        return 1;
+    }
+    libusb_set_auto_detach_kernel_driver(dev, 1);
+    rc = libusb_claim_interface(dev, RAWCAP_INTERFACE);
+    if (rc < 0) {
+        /* A build without USBD_RAW_LOG has the buttons HID interface
+           here, with no bulk endpoint */
+        fprintf(stderr, "claim interface %d: %s\n", RAWCAP_INTERFACE,
+                libusb_strerror(rc));
+        libusb_close(dev);
+        libusb_exit(NULL);
+        return 1;
+    }
+
+    out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        libusb_release_interface(dev, RAWCAP_INTERFACE);
+        libusb_close(dev);
+        libusb_exit(NULL);
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (!stop && (!end || time(NULL) < end)) {
+        rc = libusb_bulk_transfer(dev, RAWCAP_EP, buf + have, RAWCAP_READ,
+                                  &got, RAWCAP_TIMEOUT_MS);
+        if (rc < 0 && rc != LIBUSB_ERROR_TIMEOUT) {
+            fprintf(stderr, "bulk read: %s\n", libusb_strerror(rc));
+            break;
+        }
+        st.bytes += got;
+        have += got;
+        used = consume(&st, buf, have, out);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+
+    fclose(out);
+    libusb_release_interface(dev, RAWCAP_INTERFACE);
+    libusb_close(dev);
+    libusb_exit(NULL);
+    summary(&st);
+    return rc < 0 && rc != LIBUSB_ERROR_TIMEOUT;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: rawcap [-d vid:pid] [-t seconds] log.bin\n"
+                    "       rawcap -r log.bin\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned vid = RAWCAP_VID, pid = RAWCAP_PID;
+    int seconds = 0, i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-d")) {
+            if (sscanf(argv[i + 1], "%x:%x", &vid, &pid) != 2)
+                usage();
+        } else if (!strcmp(argv[i], "-t")) {
+            seconds = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-r")) {
+            return replay(argv[i + 1]);
+        } else {
+            usage();
+        }
+    }
+    if (i != argc - 1)
+        usage();
+    return capture((uint16_t)vid, (uint16_t)pid, seconds, argv[i]);
+}
@@ -0,0 +1,584 @@
+/*
+ * Simulated BNO070. See sim_hub.h.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "sim_hub.h"
+
+/* Same addresses as the board (bno070.c) */
+#define SIM_HUB_APP_ADDR        (0x48 << 1)
+#define SIM_HUB_BOOTLOADER_ADDR (0x28 << 1)
+
+#define SIM_HUB_HEADER_LEN      6
+#define SIM_HUB_PRODUCT_ID_LEN  18
+
+#define NS_PER_US   1000ull
+#define NS_PER_MS   1000000ull
+
+static sim_hub_t *sim_hub_of(const sensorhub_t *sh)
+{
+    return (sim_hub_t *)sh->cookie;
+}
+
+static void write16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void write32(uint8_t *buffer, uint32_t value)
+{
+    write16(buffer, (uint16_t)value);
+    write16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+static uint32_t read32(const uint8_t *buffer)
+{
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16)
+           | ((uint32_t)buffer[3] << 24);
+}
+
+int sim_hub_payloadLen(uint8_t sensor)
+{
+    switch (sensor) {
+    case SENSORHUB_TAP_DETECTOR:
+        return 1;
+    case SENSORHUB_HUMIDITY:
+    case SENSORHUB_PROXIMITY:
+    case SENSORHUB_TEMPERATURE:
+    case SENSORHUB_SIGNIFICANT_MOTION:
+    case SENSORHUB_SHAKE_DETECTOR:
+    case SENSORHUB_FLIP_DETECTOR:
+    case SENSORHUB_PICKUP_DETECTOR:
+    case SENSORHUB_STEP_DETECTOR:
+    case SENSORHUB_STABILITY_DETECTOR:
+        return 2;
+    case SENSORHUB_PRESSURE:
+    case SENSORHUB_AMBIENT_LIGHT:
+        return 4;
+    case SENSORHUB_GAME_ROTATION_VECTOR:
+    case SENSORHUB_STEP_COUNTER:
+        return 8;
+    case SENSORHUB_ROTATION_VECTOR:
+    case SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR:
+        return 10;
+    case SENSORHUB_RAW_ACCELEROMETER:
+    case SENSORHUB_RAW_GYROSCOPE:
+    case SENSORHUB_RAW_MAGNETOMETER:
+    case SENSORHUB_GYROSCOPE_UNCALIBRATED:
+    case SENSORHUB_MAGNETIC_FIELD_UNCALIBRATED:
+        return 12;
+    default:
+        return 6;
+    }
+}
+
+/* The hub turns about z at half a revolution per second */
+static void sim_hub_fillPayload(uint8_t sensor, uint64_t t, uint8_t *payload)
+{
+    double angle = M_PI * (double)t / 1e9;
+
+    memset(payload, 0, BNO070_MAX_INPUT_REPORT_LEN - SIM_HUB_HEADER_LEN);
+    switch (sensor) {
+    case SENSORHUB_ROTATION_VECTOR:
+    case SENSORHUB_GEOMAGNETIC_ROTATION_VECTOR:
+    case SENSORHUB_GAME_ROTATION_VECTOR:
+        /* i, j, k, real in Q14, then accuracy in Q12 */
+        write16(&payload[4], (uint16_t)(int16_t)lrint(sin(angle / 2) * 16384));
+        write16(&payload[6], (uint16_t)(int16_t)lrint(cos(angle / 2) * 16384));
+        if (sensor != SENSORHUB_GAME_ROTATION_VECTOR)
+            write16(&payload[8], (uint16_t)lrint(0.05 * 4096));
+        break;
+    case SENSORHUB_GYROSCOPE_CALIBRATED:
+        /* pi rad/s about z in Q9 */
+        write16(&payload[4], (uint16_t)lrint(M_PI * 512));
+        break;
+    case SENSORHUB_ACCELEROMETER:
+    case SENSORHUB_GRAVITY:
+        /* 1 g along z in Q8 */
+        write16(&payload[4], (uint16_t)lrint(9.80665 * 256));
+        break;
+    case SENSORHUB_RAW_ACCELEROMETER:
+    case SENSORHUB_RAW_GYROSCOPE:
+    case SENSORHUB_RAW_MAGNETOMETER:
+        write32(&payload[8], (uint32_t)(t / NS_PER_US));
+        break;
+    }
+}
+
+static void sim_hub_queue(sim_hub_t *hub, const uint8_t *data, int len,
+                          uint64_t t)
+{
+    sim_hub_report_t *r;
+
+    if (hub->count == SIM_HUB_FIFO_DEPTH) {
+        hub->head = (hub->head + 1) % SIM_HUB_FIFO_DEPTH;
+        hub->count--;
+        hub->stats.reportsLost++;
+    }
+    r = &hub->fifo[(hub->head + hub->count) % SIM_HUB_FIFO_DEPTH];
+    memset(r->data, 0, sizeof(r->data));
+    memcpy(r->data, data, len);
+    r->len = (uint8_t)len;
+    r->queuedNs = t;
+    hub->count++;
+    hub->stats.reportsQueued++;
+
+    /* A report behind one being read waits for the reassertion */
+    if (!hub->intnLow && hub->intnReassertAt == 0) {
+        hub->intnLow = 1;
+        hub->intnEdgeNs = t;
+        hub->wakePending = 1;
+    }
+}
+
+static void sim_hub_queueSample(sim_hub_t *hub, uint8_t sensor, uint64_t t)
+{
+    uint8_t report[BNO070_MAX_INPUT_REPORT_LEN];
+    int len = SIM_HUB_HEADER_LEN + sim_hub_payloadLen(sensor);
+
+    write16(report, (uint16_t)len);
+    report[2] = sensor;
+    report[3] = hub->sensor[sensor].seq++;
+    report[4] = 0x03;           /* accuracy high, delay exponent 0 */
+    report[5] = 0;              /* sampled as it was queued */
+    sim_hub_fillPayload(sensor, t, &report[SIM_HUB_HEADER_LEN]);
+    sim_hub_queue(hub, report, len, t);
+}
+
+static void sim_hub_queueProductId(sim_hub_t *hub, uint64_t t)
+{
+    uint8_t report[SIM_HUB_PRODUCT_ID_LEN];
+
+    memset(report, 0, sizeof(report));
+    write16(report, SIM_HUB_PRODUCT_ID_LEN);
+    report[2] = SENSORHUB_PRODUCT_ID_RESPONSE;
+    report[3] = hub->resetCause;
+    report[4] = 1;              /* version 1.2 */
+    report[5] = 2;
+    write32(&report[6], 10003606);
+    write32(&report[10], 123);
+    sim_hub_queue(hub, report, sizeof(report), t);
+}
+
+/* Forget everything but the model parameters, as a reset does */
+static void sim_hub_clear(sim_hub_t *hub)
+{
+    memset(hub->sensor, 0, sizeof(hub->sensor));
+    hub->head = 0;
+    hub->count = 0;
+    hub->productIdNs = 0;
+    hub->intnLow = 0;
+    hub->intnReassertAt = 0;
+    hub->wakePending = 0;
+}
+
+static uint64_t sim_hub_nextEvent(const sim_hub_t *hub)
+{
+    uint64_t next = UINT64_MAX;
+    int i;
+
+    if (!hub->rstn)
+        return next;
+    if (hub->booting)
+        return hub->readyNs;
+
+    if (hub->productIdNs != 0 && hub->productIdNs < next)
+        next = hub->productIdNs;
+    if (hub->intnReassertAt != 0 && hub->intnReassertAt < next)
+        next = hub->intnReassertAt;
+    for (i = 0; i < SENSORHUB_MAX_SENSORS; i++) {
+        if (hub->sensor[i].intervalUs != 0 && hub->sensor[i].nextNs < next)
+            next = hub->sensor[i].nextNs;
+    }
+    return next;
+}
+
+/* Everything the hub does at time t, which is sim_hub_nextEvent() */
+static void sim_hub_step(sim_hub_t *hub, uint64_t t)
+{
+    static const uint8_t resetNotification[2] = { 0, 0 };
+    int i;
+
+    if (hub->booting) {
+        hub->booting = 0;
+        sim_hub_queue(hub, resetNotification, sizeof(resetNotification), t);
+        hub->productIdNs = t + hub->productIdUs * NS_PER_US;
+        return;
+    }
+
+    if (hub->intnReassertAt == t) {
+        hub->intnReassertAt = 0;
+        if (hub->count != 0) {
+            hub->intnLow = 1;
+            hub->intnEdgeNs = t;
+        }
+    }
+    if (hub->productIdNs == t) {
+        hub->productIdNs = 0;
+        sim_hub_queueProductId(hub, t);
+    }
+    for (i = 0; i < SENSORHUB_MAX_SENSORS; i++) {
+        if (hub->sensor[i].intervalUs != 0 && hub->sensor[i].nextNs == t) {
+            hub->sensor[i].nextNs += hub->sensor[i].intervalUs * NS_PER_US;
+            sim_hub_queueSample(hub, (uint8_t)i, t);
+        }
+    }
+}
+
+static void sim_hub_runUntil(sim_hub_t *hub, uint64_t t)
+{
+    uint64_t next;
+
+    while ((next = sim_hub_nextEvent(hub)) <= t)
+        sim_hub_step(hub, next);
+}
+
+/* Move the clock on; the host is blocked if idle is set */
+static void sim_hub_pass(sim_hub_t *hub, uint64_t ns, int idle)
+{
+    hub->nowNs += ns;
+    if (idle)
+        hub->idleNs += ns;
+    sim_hub_runUntil(hub, hub->nowNs);
+}
+
+static uint64_t sim_hub_busTime(const sim_hub_t *hub, int bytes, int starts)
+{
+    /* 8 data bits and an ACK per byte, a START per address byte and
+       a STOP at the end */
+    uint64_t bits = 9ull * bytes + starts + 1;
+
+    return (bits * 1000000000ull + hub->i2cHz - 1) / hub->i2cHz;
+}
+
+/* Read of the input register: the report at the head of the FIFO, or
+   a zero length when there is none. Returns the bytes clocked. */
+static int sim_hub_readInput(sim_hub_t *hub, uint8_t *data, int size,
+                             int *pops)
+{
+    static const sim_hub_report_t empty = { { 0, 0 }, 2, 0 };
+    const sim_hub_report_t *r = hub->count ? &hub->fifo[hub->head] : &empty;
+    int len = r->data[0] | (r->data[1] << 8);
+    int n = size;
+
+    if (hub->exactReads) {
+        n = len < 4 ? 4 : len;
+        if (n > size)
+            n = size;
+    }
+    memset(data, 0, size);
+    memcpy(data, r->data, n < r->len ? n : r->len);
+
+    if (len < 2)
+        len = 2;
+    if (len > r->len)
+        len = r->len;
+    *pops = hub->count != 0 && (n >= len || !hub->shortReadKeeps);
+    if (hub->count == 0)
+        hub->stats.emptyReads++;
+    else if (hub->wakePending) {
+        uint64_t wake = hub->nowNs - hub->intnEdgeNs;
+
+        hub->wakePending = 0;
+        hub->stats.wakeups++;
+        hub->stats.wakeSumNs += wake;
+        if (wake > hub->stats.wakeMaxNs)
+            hub->stats.wakeMaxNs = wake;
+    }
+    return n;
+}
+
+static void sim_hub_pop(sim_hub_t *hub)
+{
+    uint64_t age = hub->nowNs - hub->fifo[hub->head].queuedNs;
+
+    hub->head = (hub->head + 1) % SIM_HUB_FIFO_DEPTH;
+    hub->count--;
+    hub->stats.reportsRead++;
+    hub->stats.ageSumNs += age;
+    if (age > hub->stats.ageMaxNs)
+        hub->stats.ageMaxNs = age;
+
+    hub->intnLow = 0;
+    if (hub->count != 0)
+        hub->intnReassertAt = hub->nowNs + hub->reassertNs;
+}
+
+static void sim_hub_command(sim_hub_t *hub, const uint8_t *cmd, int len,
+                            uint8_t *data, int size)
+{
+    uint8_t type, id, opcode;
+    const uint8_t *payload;
+    int ix = 4;
+    int payloadLen;
+
+    if (len < 4 || cmd[0] != BNO070_REGISTER_COMMAND)
+        return;
+    type = cmd[2] & 0xf0;
+    id = cmd[2] & 0x0f;
+    opcode = cmd[3];
+    if (id == 0xf) {
+        if (len < 5)
+            return;
+        id = cmd[4];
+        ix = 5;
+    }
+    ix += 2;                    /* data register */
+
+    if (opcode == HID_GET_REPORT_OPCODE) {
+        if (data != NULL && type == HID_REPORT_TYPE_FEATURE
+            && id < SENSORHUB_MAX_SENSORS) {
+            memset(data, 0, size);
+            memcpy(data, hub->sensor[id].feature,
+                   size < 11 ? size : 11);
+        }
+        return;
+    }
+    if (opcode != HID_SET_REPORT_OPCODE || len < ix + 2)
+        return;
+
+    payload = &cmd[ix + 2];
+    payloadLen = (cmd[ix] | (cmd[ix + 1] << 8)) - 2;
+    if (payloadLen < 0 || payloadLen > len - ix - 2)
+        return;
+
+    if (type == HID_REPORT_TYPE_FEATURE && id < SENSORHUB_MAX_SENSORS
+        && payloadLen >= 11) {
+        uint32_t interval = read32(&payload[3]);
+
+        hub->stats.featureWrites++;
+        memcpy(hub->sensor[id].feature, payload, 11);
+        if (hub->sensor[id].intervalUs != interval) {
+            hub->sensor[id].intervalUs = interval;
+            hub->sensor[id].nextNs = hub->nowNs + interval * NS_PER_US;
+        }
+    }
+    else if (type == HID_REPORT_TYPE_OUTPUT
+             && id == SENSORHUB_PRODUCT_ID_REQUEST) {
+        hub->stats.productIdRequests++;
+        hub->productIdNs = hub->nowNs + hub->productIdUs * NS_PER_US;
+    }
+}
+
+static void sim_hub_descriptor(uint8_t *data, int size)
+{
+    uint8_t desc[BNO070_DESC_V1_LEN];
+
+    memset(desc, 0, sizeof(desc));
+    write16(&desc[0], BNO070_DESC_V1_LEN);
+    write16(&desc[2], BNO070_DESC_V1_BCD);
+    write16(&desc[4], 0x0200);                          /* report descriptor length */
+    write16(&desc[6], BNO070_REGISTER_REPORT_DESCRIPTOR);
+    write16(&desc[8], BNO070_REGISTER_INPUT);
+    write16(&desc[10], BNO070_MAX_INPUT_REPORT_LEN);
+    write16(&desc[12], BNO070_REGISTER_OUTPUT);
+    write16(&desc[14], 0x0020);
+    write16(&desc[16], BNO070_REGISTER_COMMAND);
+    write16(&desc[18], BNO070_REGISTER_DATA);
+    write16(&desc[20], 0x1209);                         /* vendor */
+    write16(&desc[22], 0x0070);                         /* product */
+    write16(&desc[24], 0x0100);                         /* version */
+    memset(data, 0, size);
+    memcpy(data, desc, size < (int)sizeof(desc) ? size : (int)sizeof(desc));
+}
+
+static int sim_hub_i2cTransfer(const sensorhub_t *sh, uint8_t address,
+                               const uint8_t *sendData, int sendLength,
+                               uint8_t *receiveData, int receiveLength)
+{
+    sim_hub_t *hub = sim_hub_of(sh);
+    int bytes = 0;
+    int starts = 0;
+    int pops = 0;
+
+    sim_hub_runUntil(hub, hub->nowNs);
+    hub->stats.transfers++;
+
+    if (address != sh->sensorhubAddress || !hub->rstn || hub->booting
+        || hub->failTransfers != 0) {
+        if (hub->failTransfers != 0)
+            hub->failTransfers--;
+        hub->stats.nacks++;
+        sim_hub_pass(hub, sim_hub_busTime(hub, 1, 1), hub->i2cSleeps);
+        return SENSORHUB_STATUS_ERROR_I2C_IO;
+    }
+
+    if (sendLength > 0) {
+        bytes += 1 + sendLength;
+        starts++;
+        if (sendLength == 2 && sendData[0] == BNO070_REGISTER_HID_DESCRIPTOR) {
+            if (receiveData != NULL)
+                sim_hub_descriptor(receiveData, receiveLength);
+        }
+        else {
+            sim_hub_command(hub, sendData, sendLength, receiveData,
+                            receiveLength);
+        }
+        if (receiveData != NULL) {
+            bytes += 1 + receiveLength;
+            starts++;
+        }
+    }
+    else if (receiveData != NULL) {
+        bytes += 1 + sim_hub_readInput(hub, receiveData, receiveLength,
+                                       &pops);
+        starts++;
+    }
+
+    hub->stats.busBytes += bytes;
+    hub->stats.busNs += sim_hub_busTime(hub, bytes, starts);
+    hub->nowNs += sim_hub_busTime(hub, bytes, starts);
+    if (hub->i2cSleeps)
+        hub->idleNs += sim_hub_busTime(hub, bytes, starts);
+    if (pops)
+        sim_hub_pop(hub);
+    sim_hub_runUntil(hub, hub->nowNs);
+
+    return SENSORHUB_STATUS_SUCCESS;
+}
+
+static void sim_hub_setRSTN(const sensorhub_t *sh, int value)
+{
+    sim_hub_t *hub = sim_hub_of(sh);
+
+    sim_hub_runUntil(hub, hub->nowNs);
+    if (!value) {
+        hub->rstn = 0;
+        hub->booting = 0;
+        sim_hub_clear(hub);
+    }
+    else if (!hub->rstn) {
+        hub->rstn = 1;
+        hub->booting = 1;
+        hub->readyNs = hub->nowNs + hub->bootUs * NS_PER_US;
+        hub->stats.resets++;
+    }
+}
+
+static void sim_hub_setBOOTN(const sensorhub_t *sh, int value)
+{
+    (void)sh;
+    (void)value;
+}
+
+static int sim_hub_getHOST_INTN(const sensorhub_t *sh)
+{
+    sim_hub_t *hub = sim_hub_of(sh);
+
+    sim_hub_pass(hub, hub->pinReadNs, 0);
+    return !hub->intnLow;
+}
+
+static int sim_hub_waitForHOST_INTN(const sensorhub_t *sh, uint32_t timeout)
+{
+    sim_hub_t *hub = sim_hub_of(sh);
+    uint64_t deadline = hub->nowNs + timeout * NS_PER_MS;
+    int slept = 0;
+
+    sim_hub_runUntil(hub, hub->nowNs);
+    while (!hub->intnLow) {
+        uint64_t next = sim_hub_nextEvent(hub);
+
+        if (next > deadline) {
+            sim_hub_pass(hub, deadline - hub->nowNs, 1);
+            return SENSORHUB_STATUS_NO_REPORT_PENDING;
+        }
+        sim_hub_pass(hub, next - hub->nowNs, 1);
+        slept = 1;
+    }
+
+    /* The edge interrupt and the switch to the woken task */
+    if (slept)
+        sim_hub_pass(hub, hub->wakeNs, 0);
+    return SENSORHUB_STATUS_SUCCESS;
+}
+
+static uint32_t sim_hub_getHOST_INTN_Time(const sensorhub_t *sh)
+{
+    return (uint32_t)(sim_hub_of(sh)->intnEdgeNs / NS_PER_US);
+}
+
+/* osDelay(): the task wakes on a tick boundary */
+static void sim_hub_delay(const sensorhub_t *sh, int milliseconds)
+{
+    sim_hub_t *hub = sim_hub_of(sh);
+    uint64_t wake = (hub->nowNs / NS_PER_MS + milliseconds) * NS_PER_MS;
+
+    sim_hub_pass(hub, wake - hub->nowNs, 1);
+}
+
+static void sim_hub_delayUs(const sensorhub_t *sh, uint32_t microseconds)
+{
+    sim_hub_pass(sim_hub_of(sh), microseconds * NS_PER_US, 0);
+}
+
+static uint32_t sim_hub_getTick(const sensorhub_t *sh)
+{
+    return (uint32_t)(sim_hub_of(sh)->nowNs / NS_PER_MS);
+}
+
+void sim_hub_init(sim_hub_t *hub)
+{
+    memset(hub, 0, sizeof(*hub));
+    hub->i2cHz = 400000;
+    hub->exactReads = 1;
+    hub->i2cSleeps = 1;
+    hub->bootUs = 80000;
+    hub->productIdUs = 2000;
+    hub->reassertNs = 10000;
+    hub->wakeNs = 5000;
+    hub->pinReadNs = 200;
+    hub->resetCause = 1;
+}
+
+void sim_hub_bind(sim_hub_t *hub, sensorhub_t *sh, sensorhub_stats_t *stats,
+                  sensorhub_state_t *state, int interrupt)
+{
+    memset(sh, 0, sizeof(*sh));
+    sh->sensorhubAddress = SIM_HUB_APP_ADDR;
+    sh->bootloaderAddress = SIM_HUB_BOOTLOADER_ADDR;
+    sh->stats = stats;
+    sh->state = state;
+    sh->i2cTransfer = sim_hub_i2cTransfer;
+    sh->setRSTN = sim_hub_setRSTN;
+    sh->setBOOTN = sim_hub_setBOOTN;
+    sh->getHOST_INTN = sim_hub_getHOST_INTN;
+    sh->waitForHOST_INTN = interrupt ? sim_hub_waitForHOST_INTN : NULL;
+    sh->getHOST_INTN_Time = sim_hub_getHOST_INTN_Time;
+    sh->delay = sim_hub_delay;
+    sh->delayUs = sim_hub_delayUs;
+    sh->getTick = sim_hub_getTick;
+    sh->max_retries = 5;
+    sh->cookie = hub;
+}
+
+void sim_hub_idle(sim_hub_t *hub, uint64_t ns)
+{
+    sim_hub_pass(hub, ns, 1);
+}
+
+void sim_hub_reset(sim_hub_t *hub)
+{
+    sim_hub_runUntil(hub, hub->nowNs);
+    sim_hub_clear(hub);
+    if (hub->rstn) {
+        hub->booting = 1;
+        hub->readyNs = hub->nowNs + hub->bootUs * NS_PER_US;
+        hub->stats.resets++;
+    }
+}
+
+void sim_hub_inject(sim_hub_t *hub, const uint8_t *data, int len)
+{
+    if (len > BNO070_MAX_INPUT_REPORT_LEN)
+        len = BNO070_MAX_INPUT_REPORT_LEN;
+    sim_hub_runUntil(hub, hub->nowNs);
+    sim_hub_queue(hub, data, len, hub->nowNs);
+}
+
+uint64_t sim_hub_busyNs(const sim_hub_t *hub)
+{
+    return hub->nowNs - hub->idleNs;
+}
@@ -0,0 +1,138 @@
+/*
+ * Simulated BNO070 for host builds of the sensor hub library.
+ *
+ * sim_hub_bind() fills a sensorhub_t with callbacks that talk to a
+ * model of the hub instead of I2C1 and the BNO_xxx pins, so the
+ * unmodified bsp/sensorhub.c runs on a PC. The model answers the HID
+ * descriptor handshake, set/get feature and product ID requests,
+ * produces input reports at the configured report intervals into a
+ * FIFO behind HOST_INTN, and goes through the reset notification and
+ * product ID response after RSTN is released or it resets on its own.
+ *
+ * Time is virtual: it advances only by what the host does (bus
+ * transfers at the modelled SCL rate, delays, pin reads, waits), so
+ * results are repeatable and the figures below are exact for the model.
+ * They are only as good as the model's parameters for the real board.
+ */
+
+#ifndef SIM_HUB_H
+#define SIM_HUB_H
+
+#include <stdint.h>
+#include "sensorhub.h"
+#include "sensorhub_hid.h"
+
+/* Input reports the hub holds before it drops the oldest */
+#define SIM_HUB_FIFO_DEPTH      32
+
+typedef struct {
+    uint8_t data[BNO070_MAX_INPUT_REPORT_LEN];
+    uint8_t len;                /* 2 for a reset notification */
+    uint64_t queuedNs;          /* when the hub had it ready */
+} sim_hub_report_t;
+
+typedef struct {
+    uint32_t transfers;
+    uint32_t nacks;             /* transfers refused: in reset, booting, injected */
+    uint64_t busBytes;          /* every byte clocked, address bytes included */
+    uint64_t busNs;             /* SCL time for them */
+
+    uint32_t reportsQueued;
+    uint32_t reportsRead;       /* taken off the FIFO by a read */
+    uint32_t reportsLost;       /* dropped on FIFO overflow */
+    uint32_t emptyReads;        /* input reads with nothing queued */
+    uint32_t featureWrites;
+    uint32_t productIdRequests;
+    uint32_t resets;            /* RSTN cycles and sim_hub_reset() */
+
+    /* HOST_INTN edge caused by a new report to the start of the read
+       that services it */
+    uint32_t wakeups;
+    uint64_t wakeSumNs;
+    uint64_t wakeMaxNs;
+
+    /* Report ready to the end of the read that fetched it */
+    uint64_t ageSumNs;
+    uint64_t ageMaxNs;
+} sim_hub_stats_t;
+
+typedef struct sim_hub_s {
+    /* Model parameters; sim_hub_init() sets the defaults noted */
+    uint32_t i2cHz;             /* SCL, 400000 */
+    uint8_t exactReads;         /* the master ends a read at the length in
+                                   the report header, floored at 4 bytes,
+                                   as HAL_I2C_Master_Transfer does; 1 */
+    uint8_t shortReadKeeps;     /* a read that stops before the end of a
+                                   report leaves it queued, to be sent
+                                   again from the start; 0: any read of
+                                   the input register takes the report,
+                                   which the probe's 2-byte reads that
+                                   clear HOST_INTN rely on */
+    uint8_t i2cSleeps;          /* the host sleeps during transfers (the
+                                   interrupt-driven transfer); 1 */
+    uint32_t bootUs;            /* RSTN release to hub ready, 80000 */
+    uint32_t productIdUs;       /* ready or request to product ID response, 2000 */
+    uint32_t reassertNs;        /* INTn high after a read while more
+                                   reports are queued, 10000 */
+    uint32_t wakeNs;            /* INTn edge to the waiting task running:
+                                   EXTI handler, semaphore, switch; 5000 */
+    uint32_t pinReadNs;         /* one getHOST_INTN() round trip, 200 */
+    uint8_t resetCause;         /* in the boot product ID response, 1 */
+
+    /* Virtual clock */
+    uint64_t nowNs;
+    uint64_t idleNs;            /* host blocked in waits and delays */
+
+    /* Hub state */
+    int rstn;
+    int booting;                /* out of reset, not ready yet */
+    uint64_t readyNs;
+    uint64_t productIdNs;       /* product ID response due, 0 = none */
+    struct {
+        uint8_t feature[11];    /* as last set */
+        uint32_t intervalUs;    /* 0 = off */
+        uint64_t nextNs;
+        uint8_t seq;
+    } sensor[SENSORHUB_MAX_SENSORS];
+    sim_hub_report_t fifo[SIM_HUB_FIFO_DEPTH];
+    int head;
+    int count;
+
+    /* HOST_INTN */
+    int intnLow;
+    uint64_t intnEdgeNs;        /* last falling edge */
+    uint64_t intnReassertAt;    /* 0 = no reassertion pending */
+    int wakePending;            /* last edge was a new report, not yet read */
+
+    uint32_t failTransfers;     /* NACK this many transfers, then recover */
+
+    sim_hub_stats_t stats;
+} sim_hub_t;
+
+/* Defaults above; the hub starts held in reset with HOST_INTN high */
+void sim_hub_init(sim_hub_t *hub);
+
+/* Point sh's callbacks at hub. With interrupt set, waitForHOST_INTN
+   sleeps until the edge like the EXTI-driven firmware; otherwise it is
+   NULL and the library polls the pin. state may be NULL. */
+void sim_hub_bind(sim_hub_t *hub, sensorhub_t *sh, sensorhub_stats_t *stats,
+                  sensorhub_state_t *state, int interrupt);
+
+/* Let time pass with the host idle */
+void sim_hub_idle(sim_hub_t *hub, uint64_t ns);
+
+/* The hub resets on its own (brownout, watchdog): features are lost
+   and it boots again, announcing itself as after RSTN */
+void sim_hub_reset(sim_hub_t *hub);
+
+/* Queue an arbitrary input report now; len bytes of data go on the
+   bus, at most BNO070_MAX_INPUT_REPORT_LEN */
+void sim_hub_inject(sim_hub_t *hub, const uint8_t *data, int len);
+
+/* Payload bytes after the 6-byte header the model sends for sensor */
+int sim_hub_payloadLen(uint8_t sensor);
+
+/* Host CPU time that was not spent blocked, in nanoseconds */
+uint64_t sim_hub_busyNs(const sim_hub_t *hub);
+
+#endif /* SIM_HUB_H */
@@ -0,0 +1,206 @@
+/*
+ * Hub reset detection and feature replay (sensorhub_recover) against
+ * the simulated hub, and how long recovery takes.
+ *
+ * The sensor loop is StartThread's: wait for INTn, then sensorhub_poll.
+ * Expected resets must not count (the hub's own product ID response
+ * after a probe, a recalibration re-probe, a product ID request); an
+ * unexpected one, shown either by the reset notification or by a
+ * product ID response nobody asked for, must be recovered from once,
+ * with every cached feature sent again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim_hub.h"
+
+#define INTERVAL_US     2000
+#define MS              1000000ull
+
+static int failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    sim_hub_t hub;
+    sensorhub_t sh;
+    sensorhub_stats_t stats;
+    sensorhub_state_t state;
+    uint32_t events;
+    uint64_t markNs;            /* first event after this time is noted */
+    uint64_t firstEventNs;
+} rig_t;
+
+static void enableSensors(rig_t *r)
+{
+    sensorhub_SensorFeature_t feature;
+
+    memset(&feature, 0, sizeof(feature));
+    feature.reportInterval = INTERVAL_US;
+    CHECK(sensorhub_setDynamicFeature(&r->sh, SENSORHUB_ROTATION_VECTOR,
+                                      &feature) == SENSORHUB_STATUS_SUCCESS);
+    CHECK(sensorhub_setDynamicFeature(&r->sh, SENSORHUB_GYROSCOPE_CALIBRATED,
+                                      &feature) == SENSORHUB_STATUS_SUCCESS);
+}
+
+static void rigStart(rig_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    sim_hub_init(&r->hub);
+    sim_hub_bind(&r->hub, &r->sh, &r->stats, &r->state, 1);
+    CHECK(sensorhub_probe(&r->sh) == SENSORHUB_STATUS_SUCCESS);
+    enableSensors(r);
+}
+
+static void rigMark(rig_t *r)
+{
+    r->markNs = r->hub.nowNs;
+    r->firstEventNs = 0;
+}
+
+static void rigRun(rig_t *r, uint64_t ns)
+{
+    sensorhub_Event_t events[5];
+    uint64_t end = r->hub.nowNs + ns;
+    int numEvents;
+
+    while (r->hub.nowNs < end) {
+        if (r->sh.waitForHOST_INTN(&r->sh, 100) != SENSORHUB_STATUS_SUCCESS)
+            continue;
+        sensorhub_poll(&r->sh, events, 5, &numEvents);
+        if (numEvents > 0 && r->firstEventNs == 0)
+            r->firstEventNs = r->hub.nowNs;
+        r->events += numEvents;
+    }
+}
+
+/* Boot, the product ID response the hub sends after it, and a normal
+   stream: no resets */
+static void testQuiet(void)
+{
+    rig_t r;
+
+    rigStart(&r);
+    rigRun(&r, 2000 * MS);
+    CHECK(r.stats.hubResets == 0);
+    CHECK(r.hub.stats.resets == 1);
+    CHECK(r.hub.stats.featureWrites == 2);
+    CHECK(r.events >= 1990);
+}
+
+/* A brownout or watchdog reset mid-stream */
+static void testHubReset(void)
+{
+    rig_t r;
+    uint32_t before;
+
+    rigStart(&r);
+    rigRun(&r, 1500 * MS);
+    before = r.events;
+
+    sim_hub_reset(&r.hub);
+    rigMark(&r);
+    rigRun(&r, 1000 * MS);
+
+    CHECK(r.stats.hubResets == 1);
+    CHECK(r.hub.stats.featureWrites == 4);
+    CHECK(r.hub.sensor[SENSORHUB_ROTATION_VECTOR].intervalUs == INTERVAL_US);
+    CHECK(r.hub.sensor[SENSORHUB_GYROSCOPE_CALIBRATED].intervalUs == INTERVAL_US);
+    CHECK(r.firstEventNs != 0);
+    CHECK(r.events - before > 800);
+
+    printf("hub reset: recovery %u ms (re-probe and replay), "
+           "reset to first event %.1f ms (hub boot %.1f ms)\n",
+           (unsigned)r.stats.lastRecoveryMs,
+           (r.firstEventNs - r.markNs) / 1e6, r.hub.bootUs / 1e3);
+}
+
+/* The reset notification on its own: a zero-length report read while
+   INTn was asserted, well after any probe */
+static void testResetNotification(void)
+{
+    static const uint8_t notification[2] = { 0, 0 };
+    rig_t r;
+
+    rigStart(&r);
+    rigRun(&r, 1500 * MS);
+    sim_hub_inject(&r.hub, notification, sizeof(notification));
+    rigRun(&r, 100 * MS);
+
+    CHECK(r.stats.hubResets == 1);
+    CHECK(r.hub.stats.featureWrites == 4);
+}
+
+/* A product ID response nobody asked for */
+static void testStaleProductId(void)
+{
+    uint8_t report[18];
+    rig_t r;
+
+    memset(report, 0, sizeof(report));
+    report[0] = sizeof(report);
+    report[2] = SENSORHUB_PRODUCT_ID_RESPONSE;
+
+    rigStart(&r);
+    rigRun(&r, 1500 * MS);
+    sim_hub_inject(&r.hub, report, sizeof(report));
+    rigRun(&r, 100 * MS);
+
+    CHECK(r.stats.hubResets == 1);
+}
+
+/* Expected resets and responses: a re-probe (the recalibrate and ARVR
+   paths in StartThread) and a product ID request */
+static void testExpected(void)
+{
+    sensorhub_ProductID_t pid;
+    rig_t r;
+
+    rigStart(&r);
+    rigRun(&r, 1500 * MS);
+
+    CHECK(sensorhub_probe(&r.sh) == SENSORHUB_STATUS_SUCCESS);
+    enableSensors(&r);
+    rigRun(&r, 1500 * MS);
+    CHECK(r.hub.stats.resets == 2);
+    CHECK(r.stats.hubResets == 0);
+
+    CHECK(sensorhub_getProductID(&r.sh, &pid) == SENSORHUB_STATUS_SUCCESS);
+    CHECK(pid.swVersionMajor == 1 && pid.swVersionMinor == 2);
+    rigRun(&r, 1500 * MS);
+    CHECK(r.stats.hubResets == 0);
+}
+
+/* Recovery has to get through a hub that is not answering yet */
+static void testRecoveryRetries(void)
+{
+    rig_t r;
+
+    rigStart(&r);
+    rigRun(&r, 1500 * MS);
+    sim_hub_reset(&r.hub);
+    r.hub.failTransfers = 3;
+    rigRun(&r, 1000 * MS);
+
+    CHECK(r.stats.hubResets == 1);
+    CHECK(r.hub.sensor[SENSORHUB_ROTATION_VECTOR].intervalUs == INTERVAL_US);
+}
+
+int main(void)
+{
+    testQuiet();
+    testHubReset();
+    testResetNotification();
+    testStaleProductId();
+    testExpected();
+    testRecoveryRetries();
+
+    printf("sim_recovery: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Host stand-in for the CMSIS device header, for the portable modules
+ * built by host/Makefile. Host programs are single threaded, so masking
+ * interrupts does nothing and a barrier is a compiler/CPU fence.
+ */
+
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <stdint.h>
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+    (void)primask;
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+#define __DMB() __sync_synchronize()
+
+#endif /* STM32F4XX_H */
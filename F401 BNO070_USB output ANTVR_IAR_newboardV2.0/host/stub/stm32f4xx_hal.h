@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for the HAL: only the types that the portable modules'
+ * headers name (i2c_master_transfer.h).
+ */
+
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+#include "stm32f4xx.h"
+
+typedef enum {
+    HAL_OK = 0x00,
+    HAL_ERROR = 0x01,
+    HAL_BUSY = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef struct I2C_HandleTypeDef I2C_HandleTypeDef;
+
+#endif /* STM32F4XX_HAL_H */
@@ -0,0 +1,239 @@
+/*
+ * Unit test for User/event_ring.c, built with EVENT_RING_BARRIER() as a
+ * full host fence.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "event_ring.h"
+
+static int failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static sensorhub_Event_t makeEvent(uint8_t sensor, uint8_t seq)
+{
+    sensorhub_Event_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.sensor = sensor;
+    event.sequenceNumber = seq;
+    event.timestamp = 1000u * seq;
+    event.un.field16[0] = seq;
+    return event;
+}
+
+static void testFifoOrder(void)
+{
+    event_ring_t ring;
+    sensorhub_Event_t event = makeEvent(0, 0);
+    int i;
+
+    event_ring_init(&ring, 0);
+    CHECK(event_ring_pop(&ring, &event) == 0);
+
+    for (i = 0; i < 5; i++) {
+        event = makeEvent(SENSORHUB_GYROSCOPE_CALIBRATED, (uint8_t)i);
+        CHECK(event_ring_push(&ring, &event) == 0);
+    }
+    for (i = 0; i < 5; i++) {
+        CHECK(event_ring_pop(&ring, &event) == 1);
+        CHECK(event.sequenceNumber == i);
+        CHECK(event.un.field16[0] == i);
+    }
+    CHECK(event_ring_pop(&ring, &event) == 0);
+}
+
+static void testOverflow(void)
+{
+    event_ring_t ring;
+    sensorhub_Event_t event;
+    int i;
+
+    event_ring_init(&ring, 0);
+    for (i = 0; i < EVENT_RING_SIZE + 3; i++) {
+        event = makeEvent(SENSORHUB_GYROSCOPE_CALIBRATED, (uint8_t)i);
+        CHECK(event_ring_push(&ring, &event) == (i < EVENT_RING_SIZE ? 0 : -1));
+    }
+    CHECK(ring.stats.pushed == EVENT_RING_SIZE);
+    CHECK(ring.stats.overflows == 3);
+    CHECK(ring.stats.maxDepth == EVENT_RING_SIZE);
+
+    /* The oldest events are kept, the newest dropped */
+    CHECK(event_ring_pop(&ring, &event) == 1);
+    CHECK(event.sequenceNumber == 0);
+
+    /* One slot free again */
+    event = makeEvent(SENSORHUB_GYROSCOPE_CALIBRATED, 100);
+    CHECK(event_ring_push(&ring, &event) == 0);
+    CHECK(event_ring_push(&ring, &event) == -1);
+    CHECK(ring.stats.overflows == 4);
+}
+
+/* The indices are free-running 32-bit counters; depth and slot must
+   both survive them wrapping */
+static void testIndexWrap(void)
+{
+    event_ring_t ring;
+    sensorhub_Event_t event;
+    int i;
+
+    event_ring_init(&ring, 0);
+    ring.head = ring.tail = 0xfffffffau;
+
+    for (i = 0; i < EVENT_RING_SIZE; i++) {
+        event = makeEvent(SENSORHUB_ACCELEROMETER, (uint8_t)i);
+        CHECK(event_ring_push(&ring, &event) == 0);
+    }
+    CHECK(ring.head < ring.tail);
+    event = makeEvent(SENSORHUB_ACCELEROMETER, 99);
+    CHECK(event_ring_push(&ring, &event) == -1);
+
+    for (i = 0; i < EVENT_RING_SIZE; i++) {
+        CHECK(event_ring_pop(&ring, &event) == 1);
+        CHECK(event.sequenceNumber == i);
+    }
+    CHECK(event_ring_pop(&ring, &event) == 0);
+    CHECK(ring.stats.maxDepth == EVENT_RING_SIZE);
+}
+
+static void testLatestWins(void)
+{
+    event_ring_t ring;
+    sensorhub_Event_t event;
+    int i;
+
+    event_ring_init(&ring, 1);
+
+    /* Three orientation samples before the consumer looks: only the
+       newest is delivered, the two before it are superseded */
+    for (i = 0; i < 3; i++) {
+        event = makeEvent(SENSORHUB_ROTATION_VECTOR, (uint8_t)i);
+        CHECK(event_ring_push(&ring, &event) == 0);
+    }
+    CHECK(ring.stats.superseded == 2);
+    CHECK(ring.stats.pushed == 3);
+    CHECK(ring.head == 0);
+
+    CHECK(event_ring_pop(&ring, &event) == 1);
+    CHECK(event.sensor == SENSORHUB_ROTATION_VECTOR);
+    CHECK(event.sequenceNumber == 2);
+    CHECK(event_ring_pop(&ring, &event) == 0);
+
+    /* A sample read before the next one arrives is not superseded */
+    event = makeEvent(SENSORHUB_GAME_ROTATION_VECTOR, 3);
+    CHECK(event_ring_push(&ring, &event) == 0);
+    CHECK(ring.stats.superseded == 2);
+
+    /* Other sensors still queue, and come out ahead of the slot */
+    event = makeEvent(SENSORHUB_GYROSCOPE_CALIBRATED, 4);
+    CHECK(event_ring_push(&ring, &event) == 0);
+    CHECK(event_ring_pop(&ring, &event) == 1);
+    CHECK(event.sensor == SENSORHUB_GYROSCOPE_CALIBRATED);
+    CHECK(event_ring_pop(&ring, &event) == 1);
+    CHECK(event.sensor == SENSORHUB_GAME_ROTATION_VECTOR);
+    CHECK(event.sequenceNumber == 3);
+    CHECK(event_ring_pop(&ring, &event) == 0);
+
+    /* Without latestWins orientation queues like anything else */
+    event_ring_init(&ring, 0);
+    for (i = 0; i < 3; i++) {
+        event = makeEvent(SENSORHUB_ROTATION_VECTOR, (uint8_t)i);
+        event_ring_push(&ring, &event);
+    }
+    CHECK(ring.stats.superseded == 0);
+    CHECK(ring.head == 3);
+}
+
+static void testUsage(void)
+{
+    event_ring_t ring;
+    sensorhub_Event_t event;
+    block_pool_usage_t usage;
+    int i;
+
+    event_ring_init(&ring, 1);
+    for (i = 0; i < EVENT_RING_SIZE + 2; i++) {
+        event = makeEvent(SENSORHUB_GYROSCOPE_CALIBRATED, (uint8_t)i);
+        event_ring_push(&ring, &event);
+    }
+    event = makeEvent(SENSORHUB_ROTATION_VECTOR, 0);
+    event_ring_push(&ring, &event);
+    for (i = 0; i < 5; i++)
+        event_ring_pop(&ring, &event);
+
+    event_ring_getUsage(&ring, &usage);
+    CHECK(usage.blocks == EVENT_RING_SIZE);
+    CHECK(usage.inUse == EVENT_RING_SIZE - 5);
+    CHECK(usage.maxInUse == EVENT_RING_SIZE);
+    CHECK(usage.allocs == EVENT_RING_SIZE + 1);
+    CHECK(usage.exhausted == 2);
+}
+
+/* One producer thread that retries when the ring is full, and one
+   consumer: every event arrives once, in order, and intact */
+#define STRESS_EVENTS 100000
+
+static void *stressProducer(void *arg)
+{
+    event_ring_t *ring = arg;
+    sensorhub_Event_t event;
+    uint32_t i;
+
+    memset(&event, 0, sizeof(event));
+    event.sensor = SENSORHUB_GYROSCOPE_CALIBRATED;
+    for (i = 1; i <= STRESS_EVENTS; i++) {
+        event.timestamp = i;
+        event.un.field32[0] = ~i;
+        event.un.field32[2] = i * 2654435761u;
+        while (event_ring_push(ring, &event) != 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void testThreads(void)
+{
+    static event_ring_t ring;
+    sensorhub_Event_t event;
+    pthread_t producer;
+    uint32_t expect = 1;
+    int torn = 0;
+
+    event_ring_init(&ring, 0);
+    pthread_create(&producer, NULL, stressProducer, &ring);
+    while (expect <= STRESS_EVENTS) {
+        if (!event_ring_pop(&ring, &event)) {
+            sched_yield();
+            continue;
+        }
+        if (event.timestamp != expect || event.un.field32[0] != ~expect
+            || event.un.field32[2] != expect * 2654435761u)
+            torn++;
+        expect = event.timestamp + 1;
+    }
+    pthread_join(producer, NULL);
+    CHECK(torn == 0);
+    CHECK(ring.stats.pushed == STRESS_EVENTS);
+}
+
+int main(void)
+{
+    testFifoOrder();
+    testOverflow();
+    testIndexWrap();
+    testLatestWins();
+    testUsage();
+    testThreads();
+
+    printf("test_event_ring: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * Unit test for the host tracker report decoder (tracker_decode.c).
+ *
+ * Reports are packed here the way User/tracker_report.c packs them:
+ * the sample seq counts every sample, the report seq every report, and
+ * a full report pushes out its oldest sample and counts it in the
+ * header's dropped byte.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "tracker_decode.h"
+
+static int failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    uint8_t report[TRACKER_REPORT_SIZE];
+    uint8_t reportSeq;
+} packer_t;
+
+static void put16(uint8_t *p, int16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)((uint16_t)v >> 8);
+}
+
+static void packStart(packer_t *pk, uint8_t fields, uint8_t dropped)
+{
+    memset(pk->report, 0, sizeof(pk->report));
+    pk->report[1] = fields;
+    pk->report[2] = pk->reportSeq++;
+    pk->report[3] = dropped;
+}
+
+/* Sample n carries values derived from its seq so they can be checked */
+static void packSample(packer_t *pk, uint16_t seq, uint32_t timestamp)
+{
+    uint8_t fields = pk->report[1];
+    uint8_t *p = pk->report + TRACKER_HEADER_SIZE
+               + pk->report[0] * tracker_report_sampleSize(fields);
+    int i;
+
+    put16(p, (int16_t)seq);
+    p[2] = (uint8_t)timestamp;
+    p[3] = (uint8_t)(timestamp >> 8);
+    p[4] = (uint8_t)(timestamp >> 16);
+    p[5] = (uint8_t)(timestamp >> 24);
+    put16(p + 6, 0);
+    put16(p + 8, 0);
+    put16(p + 10, -8192);               /* -0.5 */
+    put16(p + 12, 16384);               /* 1.0 */
+    p += 14;
+    if (fields & TRACKER_FIELD_GYRO) {
+        for (i = 0; i < 3; i++)
+            put16(p + 2 * i, (int16_t)(256 * (i + 1)));     /* 0.5 rad/s */
+        p += 6;
+    }
+    if (fields & TRACKER_FIELD_ACCEL) {
+        for (i = 0; i < 3; i++)
+            put16(p + 2 * i, (int16_t)(-2514 * (i == 2)));  /* -9.82 m/s^2 */
+    }
+    pk->report[0]++;
+}
+
+static void testUnits(void)
+{
+    tracker_decoder_t dec;
+    tracker_decode_sample_t s[4];
+    packer_t pk;
+    uint8_t fields = TRACKER_FIELD_QUAT | TRACKER_FIELD_GYRO
+                   | TRACKER_FIELD_ACCEL | TRACKER_FIELD_PREDICTED;
+
+    memset(&pk, 0, sizeof(pk));
+    tracker_decode_init(&dec);
+    packStart(&pk, fields, 0);
+    packSample(&pk, 10, 1000);
+    packSample(&pk, 11, 2000);
+
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 2);
+    CHECK(s[0].seq == 10 && s[1].seq == 11);
+    CHECK(s[0].timestampUs == 1000 && s[1].timestampUs == 2000);
+    CHECK(s[1].fields == fields);
+    CHECK(s[0].quat[2] == -0.5f && s[0].quat[3] == 1.0f);
+    CHECK(s[0].gyro[0] == 0.5f && s[0].gyro[2] == 1.5f);
+    CHECK(s[0].accel[0] == 0.0f && fabsf(s[0].accel[2] + 9.82f) < 0.01f);
+    CHECK(dec.stats.reports == 1 && dec.stats.samples == 2);
+    CHECK(dec.stats.lost == 0 && dec.stats.reportsMissed == 0);
+
+    /* Quaternion only: no gyro or accel in the sample */
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 12, 3000);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 1);
+    CHECK(s[0].gyro[0] == 0.0f && s[0].accel[2] == 0.0f);
+}
+
+/* Samples lost three ways: pushed out of a full report (the header
+   says how many), in a report discarded on a header change (reportSeq
+   skips), and both show in the sample seq */
+static void testLoss(void)
+{
+    tracker_decoder_t dec;
+    tracker_decode_sample_t s[4];
+    packer_t pk;
+
+    memset(&pk, 0, sizeof(pk));
+    tracker_decode_init(&dec);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 0, 0);
+    packSample(&pk, 1, 1000);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 2);
+
+    /* Full report the host was late for: 2 and 3 pushed out */
+    packStart(&pk, TRACKER_FIELD_QUAT, 2);
+    packSample(&pk, 4, 4000);
+    packSample(&pk, 5, 5000);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 2);
+    CHECK(dec.stats.lost == 2 && dec.stats.droppedInDevice == 2);
+    CHECK(dec.stats.reportsMissed == 0);
+
+    /* A report holding 6..8 discarded in the device */
+    pk.reportSeq++;
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 9, 9000);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 1);
+    CHECK(dec.stats.lost == 5 && dec.stats.droppedInDevice == 2);
+    CHECK(dec.stats.reportsMissed == 1);
+    CHECK(dec.stats.samples == 5 && dec.stats.reports == 3);
+
+    /* The same report again (a replayed read): every sample is stale */
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 0);
+    CHECK(dec.stats.stale == 1 && dec.stats.lost == 5);
+}
+
+/* Sample seq (16 bits), report seq (8 bits) and the microsecond
+   timestamp (32 bits) all wrap */
+static void testWrap(void)
+{
+    tracker_decoder_t dec;
+    tracker_decode_sample_t s[4];
+    packer_t pk;
+
+    memset(&pk, 0, sizeof(pk));
+    pk.reportSeq = 0xff;
+    tracker_decode_init(&dec);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 0xfffe, 0xfffff000u);
+    packSample(&pk, 0xffff, 0xfffffc18u);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 2);
+    CHECK(s[1].timestampUs == 0xfffffc18u);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 0, 0x00000000u);
+    packSample(&pk, 1, 0x000003e8u);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 2);
+    CHECK(s[0].timestampUs == 0x100000000ull);
+    CHECK(s[1].timestampUs == 0x1000003e8ull);
+    CHECK(s[1].timestampUs - 0xfffffc18u == 2000);
+    CHECK(dec.stats.lost == 0 && dec.stats.reportsMissed == 0);
+    CHECK(dec.stats.stale == 0);
+}
+
+/* More samples than the caller's buffer: the rest are skipped but
+   still tracked, so the next report isn't a gap */
+static void testShortBuffer(void)
+{
+    tracker_decoder_t dec;
+    tracker_decode_sample_t s[4];
+    packer_t pk;
+    int i;
+
+    memset(&pk, 0, sizeof(pk));
+    tracker_decode_init(&dec);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    for (i = 0; i < 4; i++)
+        packSample(&pk, (uint16_t)i, 1000u * i);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 1) == 1);
+    CHECK(s[0].seq == 0);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 4, 4000);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 4) == 1);
+    CHECK(dec.stats.lost == 0 && dec.stats.samples == 5);
+}
+
+static void testMalformed(void)
+{
+    tracker_decoder_t dec;
+    tracker_decode_sample_t s[8];
+    packer_t pk;
+    int i, max;
+
+    memset(&pk, 0, sizeof(pk));
+    tracker_decode_init(&dec);
+
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    packSample(&pk, 0, 0);
+    packSample(&pk, 1, 1000);
+
+    /* Shorter than the header, shorter than its samples */
+    CHECK(tracker_decode_report(&dec, pk.report, 3, s, 8) == -1);
+    CHECK(tracker_decode_report(&dec, pk.report,
+                                TRACKER_HEADER_SIZE + 14 + 13, s, 8) == -1);
+    CHECK(tracker_decode_report(&dec, pk.report,
+                                TRACKER_HEADER_SIZE + 2 * 14, s, 8) == 2);
+
+    /* A count more than the report can hold */
+    max = tracker_report_maxSamples(TRACKER_FIELD_QUAT);
+    packStart(&pk, TRACKER_FIELD_QUAT, 0);
+    for (i = 0; i < max; i++)
+        packSample(&pk, (uint16_t)(2 + i), 2000u + 1000u * i);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 8) == max);
+    pk.report[0] = (uint8_t)(max + 1);
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 8) == -1);
+    pk.report[0] = 0xff;
+    CHECK(tracker_decode_report(&dec, pk.report, sizeof(pk.report), s, 8) == -1);
+
+    CHECK(dec.stats.malformed == 4 && dec.stats.reports == 2);
+    CHECK(dec.stats.lost == 0);
+}
+
+int main(void)
+{
+    testUnits();
+    testLoss();
+    testWrap();
+    testShortBuffer();
+    testMalformed();
+
+    printf("test_tracker_decode: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Host decoder for packed tracker reports. See tracker_decode.h.
+ */
+
+#include <string.h>
+#include "tracker_decode.h"
+
+void tracker_decode_init(tracker_decoder_t *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+/* 32-bit microseconds wrap every 71 minutes; samples are close enough
+   together that a backwards step of more than half the range is one */
+static uint64_t tracker_decode_unwrap(tracker_decoder_t *dec, uint32_t timestamp)
+{
+    if (dec->started && timestamp < dec->timestamp
+        && dec->timestamp - timestamp > 0x80000000u)
+        dec->timeHigh += 1ull << 32;
+    dec->timestamp = timestamp;
+    return dec->timeHigh | timestamp;
+}
+
+int tracker_decode_report(tracker_decoder_t *dec, const uint8_t *report,
+                          int len, tracker_decode_sample_t *samples,
+                          int maxSamples)
+{
+    tracker_sample_t raw[TRACKER_REPORT_SIZE / 14];  /* 14: smallest sample */
+    uint8_t fields;
+    int n, i, k;
+
+    if (len < TRACKER_HEADER_SIZE) {
+        dec->stats.malformed++;
+        return -1;
+    }
+    fields = report[1];
+    if (len < TRACKER_HEADER_SIZE + report[0] * tracker_report_sampleSize(fields)) {
+        dec->stats.malformed++;
+        return -1;
+    }
+    n = tracker_report_decode(report, raw, TRACKER_REPORT_SIZE / 14);
+    if (n < 0) {
+        dec->stats.malformed++;
+        return -1;
+    }
+
+    dec->stats.reports++;
+    dec->stats.droppedInDevice += report[3];
+    if (dec->started && (uint8_t)(report[2] - dec->reportSeq) > 1
+        && (uint8_t)(report[2] - dec->reportSeq) < 0x80)
+        dec->stats.reportsMissed += (uint8_t)(report[2] - dec->reportSeq) - 1;
+    dec->reportSeq = report[2];
+
+    for (i = 0, k = 0; i < n; i++) {
+        uint16_t diff = (uint16_t)(raw[i].seq - dec->seq);
+        tracker_decode_sample_t *s;
+        int j;
+
+        if (dec->started) {
+            if (diff == 0 || diff >= 0x8000) {
+                dec->stats.stale++;
+                continue;
+            }
+            dec->stats.lost += diff - 1;
+        }
+        dec->seq = raw[i].seq;
+        dec->stats.samples++;
+        if (k >= maxSamples) {
+            /* Still tracked above so the next report doesn't look like
+               a gap */
+            tracker_decode_unwrap(dec, raw[i].timestamp);
+            dec->started = 1;
+            continue;
+        }
+
+        s = &samples[k++];
+        s->seq = raw[i].seq;
+        s->fields = fields;
+        s->timestampUs = tracker_decode_unwrap(dec, raw[i].timestamp);
+        for (j = 0; j < 4; j++)
+            s->quat[j] = raw[i].quat_16Q14[j] / 16384.0f;
+        for (j = 0; j < 3; j++) {
+            s->gyro[j] = raw[i].gyro_16Q9[j] / 512.0f;
+            s->accel[j] = raw[i].accel_16Q8[j] / 256.0f;
+        }
+        dec->started = 1;
+    }
+    return k;
+}
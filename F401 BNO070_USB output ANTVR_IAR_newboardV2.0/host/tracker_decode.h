@@ -0,0 +1,59 @@
+/*
+ * Host decoder for the packed tracker reports of HID interface 0 (see
+ * User/tracker_report.h for the format).
+ *
+ * tracker_report_decode() in that header turns one report into raw
+ * samples. This keeps the state across reports a host application
+ * needs on top: samples in floating point units, timestamps unwrapped
+ * to 64 bits, and accounting for every sample that did not arrive,
+ * told apart by where it was lost.
+ */
+
+#ifndef TRACKER_DECODE_H
+#define TRACKER_DECODE_H
+
+#include <stdint.h>
+#define TRACKER_REPORT_HOST
+#include "tracker_report.h"
+
+typedef struct {
+    uint16_t seq;
+    uint8_t fields;             /* TRACKER_FIELD_xxx of its report */
+    uint64_t timestampUs;       /* device microseconds, unwrapped */
+    float quat[4];              /* i, j, k, real */
+    float gyro[3];              /* rad/s, 0 unless TRACKER_FIELD_GYRO */
+    float accel[3];             /* m/s^2, 0 unless TRACKER_FIELD_ACCEL */
+} tracker_decode_sample_t;
+
+typedef struct {
+    uint32_t reports;           /* well-formed reports decoded */
+    uint32_t malformed;         /* reports rejected: short, bad count */
+    uint32_t reportsMissed;     /* gaps in reportSeq: reports the device
+                                   discarded before sending */
+    uint32_t samples;           /* samples delivered */
+    uint32_t lost;              /* gaps in the sample seq, all causes */
+    uint32_t droppedInDevice;   /* of those, discarded from a full report
+                                   the host had not read (header count) */
+    uint32_t stale;             /* samples older than one already seen */
+} tracker_decode_stats_t;
+
+typedef struct {
+    int started;
+    uint8_t reportSeq;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint64_t timeHigh;          /* wraps of the 32-bit timestamp, << 32 */
+    tracker_decode_stats_t stats;
+} tracker_decoder_t;
+
+void tracker_decode_init(tracker_decoder_t *dec);
+
+/* Decodes one report of len bytes as read from the tracker interface.
+   Returns the number of samples written to samples[] (up to
+   maxSamples; the rest of the report is skipped), or -1 if the report
+   is malformed. */
+int tracker_decode_report(tracker_decoder_t *dec, const uint8_t *report,
+                          int len, tracker_decode_sample_t *samples,
+                          int maxSamples);
+
+#endif /* TRACKER_DECODE_H */
@@ -0,0 +1,340 @@
+/*
+ * Reads and writes the tracker's feature reports (User/tracker_config.h)
+ * through Linux hidraw, on the config interface (HID interface 2).
+ *
+ * usage: trackerctl /dev/hidrawN command [values]
+ *
+ *   sensors [fields interval]      fields: TRACKER_FIELD_xxx bits
+ *   arvr [scaling maxRotation maxError stability]
+ *   prediction [horizonUs]
+ *   timing [sync everyFrame]
+ *   stats
+ *   cpu
+ *   memory
+ *   clear-crash
+ *   pools
+ *
+ * Without values a command reads and prints the report; with them it
+ * writes the report and reads it back. Values take C prefixes (0x...).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/hidraw.h>
+#define TRACKER_CONFIG_HOST
+#include "tracker_config.h"
+#define TRACKER_REPORT_HOST
+#include "tracker_report.h"
+
+static int fd;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+/* Reads feature report id of len bytes (without the ID) into report[],
+   which keeps the ID in byte 0 as hidraw returns it */
+static void getFeature(uint8_t id, uint8_t *report, int len)
+{
+    int rc;
+
+    memset(report, 0, len + 1);
+    report[0] = id;
+    rc = ioctl(fd, HIDIOCGFEATURE(len + 1), report);
+    if (rc < 0) {
+        fprintf(stderr, "get feature 0x%02x: %s\n", id, strerror(errno));
+        exit(1);
+    }
+    if (rc != len + 1) {
+        fprintf(stderr, "get feature 0x%02x: %d bytes, expected %d\n",
+                id, rc, len + 1);
+        exit(1);
+    }
+}
+
+/* The firmware stalls a write to a read only report, of the wrong
+   length or with a value out of range, which fails the ioctl */
+static void setFeature(uint8_t *report, int len)
+{
+    if (ioctl(fd, HIDIOCSFEATURE(len + 1), report) < 0) {
+        fprintf(stderr, "set feature 0x%02x: %s\n", report[0], strerror(errno));
+        exit(1);
+    }
+}
+
+static uint32_t value(const char *s)
+{
+    char *end;
+    unsigned long v;
+
+    errno = 0;
+    v = strtoul(s, &end, 0);
+    if (errno || *end || end == s || v > 0xffffffffu) {
+        fprintf(stderr, "bad value: %s\n", s);
+        exit(2);
+    }
+    return (uint32_t)v;
+}
+
+static void doSensors(int argc, char **argv)
+{
+    uint8_t r[TRACKER_FEATURE_SENSORS_SIZE + 1];
+
+    if (argc == 2) {
+        r[0] = TRACKER_FEATURE_SENSORS;
+        r[1] = (uint8_t)value(argv[0]);
+        put32(&r[2], value(argv[1]));
+        setFeature(r, TRACKER_FEATURE_SENSORS_SIZE);
+    }
+    getFeature(TRACKER_FEATURE_SENSORS, r, TRACKER_FEATURE_SENSORS_SIZE);
+    printf("fields    0x%02x%s%s%s\n", r[1],
+           r[1] & TRACKER_FIELD_QUAT ? " quat" : "",
+           r[1] & TRACKER_FIELD_GYRO ? " gyro" : "",
+           r[1] & TRACKER_FIELD_ACCEL ? " accel" : "");
+    printf("interval  %u us\n", (unsigned)get32(&r[2]));
+}
+
+static void doArvr(int argc, char **argv)
+{
+    static const char *const names[4] = {
+        "scaling", "maxRotation", "maxError", "stability"
+    };
+    static const int q[4] = { 30, 29, 29, 29 };
+    uint8_t r[TRACKER_FEATURE_ARVR_SIZE + 1];
+    int i;
+
+    if (argc == 4) {
+        r[0] = TRACKER_FEATURE_ARVR;
+        for (i = 0; i < 4; i++)
+            put32(&r[1 + 4 * i], value(argv[i]));
+        setFeature(r, TRACKER_FEATURE_ARVR_SIZE);
+    }
+    getFeature(TRACKER_FEATURE_ARVR, r, TRACKER_FEATURE_ARVR_SIZE);
+    for (i = 0; i < 4; i++) {
+        uint32_t v = get32(&r[1 + 4 * i]);
+
+        printf("%-12s 0x%08x  %.6f%s\n", names[i], (unsigned)v,
+               v / (double)(1u << q[i]), i ? " rad" : "");
+    }
+}
+
+static void doPrediction(int argc, char **argv)
+{
+    uint8_t r[TRACKER_FEATURE_PREDICTION_SIZE + 1];
+
+    if (argc == 1) {
+        r[0] = TRACKER_FEATURE_PREDICTION;
+        put16(&r[1], (uint16_t)value(argv[0]));
+        setFeature(r, TRACKER_FEATURE_PREDICTION_SIZE);
+    }
+    getFeature(TRACKER_FEATURE_PREDICTION, r, TRACKER_FEATURE_PREDICTION_SIZE);
+    printf("horizon   %u us%s\n", get16(&r[1]), get16(&r[1]) ? "" : " (off)");
+}
+
+static void doTiming(int argc, char **argv)
+{
+    uint8_t r[TRACKER_FEATURE_TIMING_SIZE + 1];
+    const uint8_t *p = r + 1;
+
+    if (argc == 2) {
+        memset(r, 0, sizeof(r));
+        r[0] = TRACKER_FEATURE_TIMING;
+        r[1] = (uint8_t)value(argv[0]);
+        r[2] = (uint8_t)value(argv[1]);
+        setFeature(r, TRACKER_FEATURE_TIMING_SIZE);
+    }
+    getFeature(TRACKER_FEATURE_TIMING, r, TRACKER_FEATURE_TIMING_SIZE);
+    printf("sync        %u\n", p[0]);
+    printf("everyFrame  %u\n", p[1]);
+    printf("reports     %u\n", (unsigned)get32(p + 4));
+    printf("phase       %u us\n", (unsigned)get32(p + 8));
+    printf("meanAge     %u us\n", (unsigned)get32(p + 12));
+    printf("maxAge      %u us\n", (unsigned)get32(p + 16));
+}
+
+static void doStats(void)
+{
+    static const char *const names[TRACKER_STAT_NUM] = {
+        "tracker sent", "tracker reclaimed", "tracker dropped",
+        "buttons sent", "buttons dropped", "commands", "commands dropped",
+        "samples", "samples dropped", "IN reports", "IN max interval us",
+        "IN late", "I2C errors", "hub resets", "uptime ms"
+    };
+    uint8_t r[TRACKER_FEATURE_STATS_SIZE + 1];
+    int i;
+
+    getFeature(TRACKER_FEATURE_STATS, r, TRACKER_FEATURE_STATS_SIZE);
+    for (i = 0; i < TRACKER_STAT_NUM; i++)
+        printf("%-20s %u\n", names[i], (unsigned)get32(&r[1 + 4 * i]));
+}
+
+/* Shares are in 0.1 % of the window */
+static void doCpu(void)
+{
+    static const char *const isrNames[TRACKER_CPU_ISR_NUM] = {
+        "USB", "I2C", "INTn", "keys"
+    };
+    uint8_t r[TRACKER_FEATURE_CPU_SIZE + 1];
+    const uint8_t *p = r + 1;
+    int i, tasks;
+
+    getFeature(TRACKER_FEATURE_CPU, r, TRACKER_FEATURE_CPU_SIZE);
+    printf("window      %u us\n", (unsigned)get32(p));
+    printf("idle        %5.1f %%\n", get16(p + 4) / 10.0);
+    for (i = 0; i < TRACKER_CPU_ISR_NUM; i++)
+        printf("isr %-7s %5.1f %%\n", isrNames[i], get16(p + 6 + 2 * i) / 10.0);
+
+    tasks = p[14] < TRACKER_CPU_MAX_TASKS ? p[14] : TRACKER_CPU_MAX_TASKS;
+    printf("%-10s %7s %8s\n", "task", "share", "priority");
+    for (i = 0; i < tasks; i++) {
+        const uint8_t *t = p + 16 + TRACKER_CPU_TASK_SIZE * i;
+
+        printf("%-10.*s %5.1f %% %8u\n", TRACKER_CPU_NAME_LEN, (const char *)t,
+               get16(t + 8) / 10.0, t[10]);
+    }
+}
+
+static void doMemory(void)
+{
+    static const char *const causes[] = {
+        "none", "stack overflow", "malloc failed"
+    };
+    uint8_t r[TRACKER_FEATURE_MEMORY_SIZE + 1];
+    const uint8_t *p = r + 1;
+    const uint8_t *c = p + TRACKER_MEM_CRASH_OFFSET;
+    int i, tasks;
+
+    getFeature(TRACKER_FEATURE_MEMORY, r, TRACKER_FEATURE_MEMORY_SIZE);
+    printf("heap        %u bytes, %u free, %u lowest free\n",
+           (unsigned)get32(p), (unsigned)get32(p + 4), (unsigned)get32(p + 8));
+    printf("largest     %u bytes in %u free blocks\n",
+           (unsigned)get32(p + 12), get16(p + 16));
+    printf("warnings    0x%02x%s%s\n", p[18],
+           p[18] & TRACKER_MEM_WARN_STACK ? " stack" : "",
+           p[18] & TRACKER_MEM_WARN_HEAP ? " heap" : "");
+
+    tasks = p[19] < TRACKER_MEM_MAX_TASKS ? p[19] : TRACKER_MEM_MAX_TASKS;
+    printf("%-10s %s\n", "task", "stack free (words)");
+    for (i = 0; i < tasks; i++) {
+        const uint8_t *t = p + 20 + TRACKER_MEM_TASK_SIZE * i;
+
+        printf("%-10.*s %u\n", TRACKER_MEM_NAME_LEN, (const char *)t,
+               get16(t + 8));
+    }
+
+    if (c[0] == TRACKER_CRASH_NONE) {
+        printf("crash       none\n");
+        return;
+    }
+    printf("crash       %s in %.*s at %u ms, %u bytes heap free (%u since clear)\n",
+           c[0] < sizeof(causes) / sizeof(causes[0]) ? causes[c[0]] : "unknown",
+           TRACKER_MEM_NAME_LEN, (const char *)c + 12, (unsigned)get32(c + 4),
+           (unsigned)get32(c + 8), c[1]);
+}
+
+static void doClearCrash(void)
+{
+    uint8_t r[TRACKER_FEATURE_MEMORY_SIZE + 1];
+
+    memset(r, 0, sizeof(r));
+    r[0] = TRACKER_FEATURE_MEMORY;
+    setFeature(r, TRACKER_FEATURE_MEMORY_SIZE);
+}
+
+static void doPools(void)
+{
+    static const char *const names[TRACKER_POOL_NUM] = {
+        "commands", "events", "buttons"
+    };
+    uint8_t r[TRACKER_FEATURE_POOLS_SIZE + 1];
+    int i;
+
+    getFeature(TRACKER_FEATURE_POOLS, r, TRACKER_FEATURE_POOLS_SIZE);
+    printf("%-10s %6s %6s %6s %10s %10s\n",
+           "pool", "blocks", "inUse", "max", "allocs", "exhausted");
+    for (i = 0; i < TRACKER_POOL_NUM; i++) {
+        const uint8_t *e = r + 1 + TRACKER_POOL_ENTRY_SIZE * i;
+
+        printf("%-10s %6u %6u %6u %10u %10u\n", names[i], get16(e),
+               get16(e + 2), get16(e + 4), (unsigned)get32(e + 8),
+               (unsigned)get32(e + 12));
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: trackerctl /dev/hidrawN command [values]\n"
+            "  sensors [fields interval]\n"
+            "  arvr [scaling maxRotation maxError stability]\n"
+            "  prediction [horizonUs]\n"
+            "  timing [sync everyFrame]\n"
+            "  stats | cpu | memory | clear-crash | pools\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *device, *cmd;
+    int n;
+
+    if (argc < 3)
+        usage();
+    device = argv[1];
+    cmd = argv[2];
+    n = argc - 3;
+    argv += 3;
+
+    fd = open(device, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", device, strerror(errno));
+        return 1;
+    }
+
+    if (!strcmp(cmd, "sensors") && (n == 0 || n == 2))
+        doSensors(n, argv);
+    else if (!strcmp(cmd, "arvr") && (n == 0 || n == 4))
+        doArvr(n, argv);
+    else if (!strcmp(cmd, "prediction") && n <= 1)
+        doPrediction(n, argv);
+    else if (!strcmp(cmd, "timing") && (n == 0 || n == 2))
+        doTiming(n, argv);
+    else if (!strcmp(cmd, "stats") && n == 0)
+        doStats();
+    else if (!strcmp(cmd, "cpu") && n == 0)
+        doCpu();
+    else if (!strcmp(cmd, "memory") && n == 0)
+        doMemory();
+    else if (!strcmp(cmd, "clear-crash") && n == 0)
+        doClearCrash();
+    else if (!strcmp(cmd, "pools") && n == 0)
+        doPools();
+    else
+        usage();
+
+    close(fd);
+    return 0;
+}
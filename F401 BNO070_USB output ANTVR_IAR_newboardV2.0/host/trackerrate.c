@@ -0,0 +1,173 @@
+/*
+ * Host side view of the tracker report stream: reads the tracker
+ * interface (HID interface 0) through Linux hidraw, timestamps each
+ * read() with CLOCK_MONOTONIC and reports the achieved rate and the
+ * inter-arrival jitter as the application sees it, USB scheduling and
+ * hidraw delivery included. The reports go through tracker_decode so
+ * samples lost or dropped in the device show next to the timing.
+ *
+ * The device's own view of the same stream (the IN completion times in
+ * USBD_HidInRate) is in trackerctl stats; the two together tell the
+ * device from the host side.
+ *
+ * usage: trackerrate [-i intervalUs] [-t seconds] /dev/hidrawN
+ *
+ * -i is the polling interval the reports should arrive at (default
+ * 1000, HID_FS_BINTERVAL); a gap over 1.5 of them counts as late, as on
+ * the device. Runs until -t seconds have passed or Ctrl-C.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tracker_decode.h"
+
+typedef struct {
+    uint64_t firstNs;
+    uint64_t lastNs;
+    uint32_t reports;
+    uint32_t late;
+    uint64_t minNs;
+    uint64_t maxNs;
+    double mean;                /* inter-arrival, ns (Welford) */
+    double m2;
+} rate_t;
+
+static volatile sig_atomic_t stop;
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void rate_add(rate_t *r, uint64_t ns, uint64_t lateNs)
+{
+    uint64_t gap = ns - r->lastNs;
+    uint32_t n = r->reports;            /* intervals once this is added */
+    double delta = gap - r->mean;
+
+    if (r->reports++ == 0) {
+        r->firstNs = r->lastNs = ns;
+        r->minNs = UINT64_MAX;
+        return;
+    }
+    r->lastNs = ns;
+    if (gap < r->minNs)
+        r->minNs = gap;
+    if (gap > r->maxNs)
+        r->maxNs = gap;
+    if (gap > lateNs)
+        r->late++;
+    r->mean += delta / n;
+    r->m2 += delta * (gap - r->mean);
+}
+
+static void summary(const rate_t *r, const tracker_decoder_t *dec)
+{
+    const tracker_decode_stats_t *st = &dec->stats;
+    double seconds = (r->lastNs - r->firstNs) / 1e9;
+
+    if (r->reports < 2) {
+        printf("%u reports, too few to time\n", (unsigned)r->reports);
+        return;
+    }
+    printf("reports     %u in %.3f s, %.1f/s\n", (unsigned)r->reports,
+           seconds, (r->reports - 1) / seconds);
+    printf("interval    min %.1f  mean %.1f  max %.1f  stddev %.1f us\n",
+           r->minNs / 1e3, r->mean / 1e3, r->maxNs / 1e3,
+           sqrt(r->m2 / (r->reports - 1)) / 1e3);
+    printf("late        %u (%.2f %%)\n", (unsigned)r->late,
+           100.0 * r->late / (r->reports - 1));
+    printf("samples     %u, %.1f/s\n", (unsigned)st->samples,
+           st->samples / seconds);
+    printf("lost        %u samples (%u dropped in the device), "
+           "%u reports missed\n", (unsigned)st->lost,
+           (unsigned)st->droppedInDevice, (unsigned)st->reportsMissed);
+    printf("malformed   %u reports, %u stale samples\n",
+           (unsigned)st->malformed, (unsigned)st->stale);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: trackerrate [-i intervalUs] [-t seconds] /dev/hidrawN\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static tracker_decode_sample_t samples[TRACKER_REPORT_SIZE / 14];
+    uint8_t report[TRACKER_REPORT_SIZE];
+    tracker_decoder_t dec;
+    rate_t rate;
+    uint64_t lateNs;
+    long intervalUs = 1000, seconds = 0;
+    int fd, i, n;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-i"))
+            intervalUs = strtol(argv[i + 1], NULL, 0);
+        else if (!strcmp(argv[i], "-t"))
+            seconds = strtol(argv[i + 1], NULL, 0);
+        else
+            usage();
+    }
+    if (i != argc - 1 || intervalUs <= 0 || seconds < 0)
+        usage();
+    lateNs = intervalUs * 1500u;
+
+    fd = open(argv[i], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+        return 1;
+    }
+
+    memset(&rate, 0, sizeof(rate));
+    tracker_decode_init(&dec);
+    /* No SA_RESTART, so Ctrl-C or the -t alarm also ends a read that
+       is waiting on a stalled stream */
+    {
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = onSignal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGALRM, &sa, NULL);
+    }
+    if (seconds)
+        alarm((unsigned)seconds);
+
+    while (!stop) {
+        n = read(fd, report, sizeof(report));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "read: %s\n", strerror(errno));
+            break;
+        }
+        if (n == 0)
+            break;
+        rate_add(&rate, nowNs(), lateNs);
+        tracker_decode_report(&dec, report, n, samples,
+                              sizeof(samples) / sizeof(samples[0]));
+    }
+
+    close(fd);
+    summary(&rate, &dec);
+    return 0;
+}